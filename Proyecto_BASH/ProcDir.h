@@ -0,0 +1,79 @@
+#ifndef PROCDIR_H
+#define PROCDIR_H
+
+#include <string_view>
+#include <vector>
+#include <cerrno>
+#include <charconv>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+// Entrada tal y como la devuelve getdents64 (glibc no exporta esta estructura)
+struct linux_dirent64_raw {
+  ino64_t d_ino;
+  off64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+/// @brief Recorre un directorio abierto con getdents64, sin pasar por readdir()
+/// @param dir_fd Descriptor del directorio (O_RDONLY | O_DIRECTORY)
+/// @param buffer Buffer reutilizable para las lecturas
+/// @param callback Función llamada con (nombre, d_type) por cada entrada
+/// @return 0 si todo fue bien o el errno de getdents64
+template <typename Callback>
+int for_each_dirent(int dir_fd, std::vector<char>& buffer, Callback&& callback) {
+  while (true) {
+    long bytes = syscall(SYS_getdents64, dir_fd, buffer.data(), buffer.size());
+    if (bytes < 0) {
+      return errno;
+    }
+    if (bytes == 0) {
+      return 0;
+    }
+    for (long offset = 0; offset < bytes;) {
+      auto* entry = reinterpret_cast<linux_dirent64_raw*>(buffer.data() + offset);
+      std::string_view name{entry->d_name};
+      if (name != "." && name != "..") {
+        callback(name, entry->d_type);
+      }
+      offset += entry->d_reclen;
+    }
+  }
+}
+
+/// @brief Convierte el nombre de una entrada de /proc en PID
+/// @param name Nombre de la entrada
+/// @return PID o -1 si la entrada no es un proceso
+inline pid_t parse_pid(std::string_view name) {
+  pid_t pid = -1;
+  auto [ptr, ec] = std::from_chars(name.data(), name.data() + name.size(), pid);
+  if (ec != std::errc{} || ptr != name.data() + name.size()) {
+    return -1;
+  }
+  return pid;
+}
+
+/// @brief Lista los PIDs presentes en /proc
+/// @param buffer Buffer reutilizable para getdents64
+/// @return Vector con los PIDs (vacío si /proc no se puede abrir)
+inline std::vector<pid_t> list_pids(std::vector<char>& buffer) {
+  std::vector<pid_t> pids;
+  int proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (proc_fd < 0) {
+    return pids;
+  }
+  for_each_dirent(proc_fd, buffer, [&](std::string_view name, unsigned char) {
+    pid_t pid = parse_pid(name);
+    if (pid > 0) {
+      pids.push_back(pid);
+    }
+  });
+  close(proc_fd);
+  return pids;
+}
+
+#endif
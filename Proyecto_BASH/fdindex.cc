@@ -0,0 +1,322 @@
+/**
+ * 2º Grado en Ingeniería Informática
+ * Proyecto BASH - Sistemas Operativos
+ * @file fdindex.cc
+ * @brief fdindex [-h] [-R] [-j hilos] [-s segundos] dir1 [dir2 ...]
+ *
+ * Índice de archivos abiertos construido a partir de los enlaces de /proc/<pid>/fd
+ * (más cwd, root y exe). Sustituye a "lsof +d" en la opción -d de infosession.sh:
+ * imprime un PID por línea de los procesos que tienen abierto algún archivo dentro
+ * de los directorios indicados.
+ *
+ *  -R           Búsqueda recursiva (como lsof +D); por defecto solo el primer nivel (lsof +d)
+ *  -j hilos     Número de hilos del pool (por defecto, los núcleos disponibles)
+ *  -s segundos  Modo muestreo: reconstruye el índice cada intervalo y repite las consultas
+ *
+ * Compilar con: g++ -std=c++23 -O2 -pthread fdindex.cc -o fdindex
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ProcDir.h"
+
+// Pool de hilos persistente: en modo muestreo se reutiliza entre reconstrucciones
+class ThreadPool {
+  public:
+    explicit ThreadPool(unsigned size) {
+      for (unsigned id = 0; id < size; ++id) {
+        workers_.emplace_back([this, id] { worker_loop(id); });
+      }
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool() {
+      {
+        std::lock_guard lock{mutex_};
+        stop_ = true;
+      }
+      wake_.notify_all();
+      for (auto& worker : workers_) {
+        worker.join();
+      }
+    }
+
+    [[nodiscard]] unsigned size() const noexcept {
+      return static_cast<unsigned>(workers_.size());
+    }
+
+    /// @brief Ejecuta job(id) en todos los hilos y espera a que terminen
+    void run(const std::function<void(unsigned)>& job) {
+      std::unique_lock lock{mutex_};
+      job_ = &job;
+      pending_ = size();
+      ++generation_;
+      wake_.notify_all();
+      done_.wait(lock, [this] { return pending_ == 0; });
+      job_ = nullptr;
+    }
+
+  private:
+    void worker_loop(unsigned id) {
+      unsigned long seen = 0;
+      while (true) {
+        const std::function<void(unsigned)>* job;
+        {
+          std::unique_lock lock{mutex_};
+          wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+          if (stop_) {
+            return;
+          }
+          seen = generation_;
+          job = job_;
+        }
+        (*job)(id);
+        std::lock_guard lock{mutex_};
+        if (--pending_ == 0) {
+          done_.notify_one();
+        }
+      }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(unsigned)>* job_ = nullptr;
+    unsigned pending_ = 0;
+    unsigned long generation_ = 0;
+    bool stop_ = false;
+};
+
+// Índice ordenado de (ruta, pid). Las rutas se guardan en un único pool de caracteres
+// para que el índice ocupe poco y se pueda buscar por prefijo con lower_bound.
+class OpenFileIndex {
+  public:
+    explicit OpenFileIndex(unsigned threads) : pool_{threads}, shards_(threads) {}
+
+    /// @brief Reconstruye el índice recorriendo /proc con el pool de hilos
+    void rebuild() {
+      pids_ = list_pids(proc_buffer_);
+      std::atomic<size_t> next{0};
+      pool_.run([&](unsigned id) {
+        Shard& shard = shards_[id];
+        shard.clear();
+        // Reparto dinámico en bloques pequeños: unos pocos procesos tienen miles de fds
+        constexpr size_t chunk = 16;
+        for (size_t begin = next.fetch_add(chunk); begin < pids_.size(); begin = next.fetch_add(chunk)) {
+          size_t end = std::min(begin + chunk, pids_.size());
+          for (size_t i = begin; i < end; ++i) {
+            scan_process(shard, pids_[i]);
+          }
+        }
+      });
+      merge();
+    }
+
+    /// @brief Devuelve los PIDs con archivos abiertos bajo el directorio
+    /// @param dir Directorio a consultar
+    /// @param recursive true para incluir subdirectorios
+    /// @param out Vector donde se añaden los PIDs (sin duplicados tras sort/unique)
+    void query(std::string_view dir, bool recursive, std::vector<pid_t>& out) const {
+      while (dir.size() > 1 && dir.back() == '/') {
+        dir.remove_suffix(1);
+      }
+      std::string prefix{dir};
+      if (prefix != "/") {
+        prefix += '/';
+      }
+      auto it = std::lower_bound(entries_.begin(), entries_.end(), std::string_view{prefix},
+                                 [this](const Entry& entry, std::string_view key) { return path(entry) < key; });
+      for (; it != entries_.end(); ++it) {
+        std::string_view target = path(*it);
+        if (!target.starts_with(prefix)) {
+          break;
+        }
+        if (recursive || target.find('/', prefix.size()) == std::string_view::npos) {
+          out.push_back(it->pid);
+        }
+      }
+      // El propio directorio abierto (p. ej. como cwd) también cuenta, igual que en lsof
+      auto self = std::lower_bound(entries_.begin(), entries_.end(), dir,
+                                   [this](const Entry& entry, std::string_view key) { return path(entry) < key; });
+      for (; self != entries_.end() && path(*self) == dir; ++self) {
+        out.push_back(self->pid);
+      }
+      std::sort(out.begin(), out.end());
+      out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+
+  private:
+    struct Entry {
+      uint32_t offset;
+      uint32_t length;
+      pid_t pid;
+    };
+
+    struct Shard {
+      std::string paths;
+      std::vector<Entry> entries;
+      std::vector<char> buffer = std::vector<char>(32 * 1024);
+      void clear() {
+        paths.clear();
+        entries.clear();
+      }
+    };
+
+    static void add_link(Shard& shard, int dir_fd, const char* name, pid_t pid) {
+      char target[PATH_MAX];
+      ssize_t length = readlinkat(dir_fd, name, target, sizeof(target));
+      // Solo interesan rutas reales: se descartan "socket:[...]", "pipe:[...]", "anon_inode:..."
+      if (length <= 0 || target[0] != '/') {
+        return;
+      }
+      std::string_view view{target, static_cast<size_t>(length)};
+      if (view.ends_with(" (deleted)")) {
+        view.remove_suffix(10);
+      }
+      shard.entries.push_back({static_cast<uint32_t>(shard.paths.size()), static_cast<uint32_t>(view.size()), pid});
+      shard.paths.append(view);
+    }
+
+    static void scan_process(Shard& shard, pid_t pid) {
+      char path[64];
+      snprintf(path, sizeof(path), "/proc/%d", pid);
+      int pid_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (pid_fd < 0) {
+        return; // El proceso ya terminó o no tenemos permisos
+      }
+      add_link(shard, pid_fd, "cwd", pid);
+      add_link(shard, pid_fd, "root", pid);
+      add_link(shard, pid_fd, "exe", pid);
+      int fd_dir = openat(pid_fd, "fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (fd_dir >= 0) {
+        for_each_dirent(fd_dir, shard.buffer, [&](std::string_view name, unsigned char) {
+          add_link(shard, fd_dir, name.data(), pid);
+        });
+        close(fd_dir);
+      }
+      close(pid_fd);
+    }
+
+    std::string_view path(const Entry& entry) const {
+      return std::string_view{paths_}.substr(entry.offset, entry.length);
+    }
+
+    void merge() {
+      paths_.clear();
+      entries_.clear();
+      for (const Shard& shard : shards_) {
+        uint32_t base = static_cast<uint32_t>(paths_.size());
+        paths_.append(shard.paths);
+        for (Entry entry : shard.entries) {
+          entry.offset += base;
+          entries_.push_back(entry);
+        }
+      }
+      std::sort(entries_.begin(), entries_.end(), [this](const Entry& a, const Entry& b) {
+        std::string_view pa = path(a), pb = path(b);
+        return pa < pb || (pa == pb && a.pid < b.pid);
+      });
+    }
+
+    ThreadPool pool_;
+    std::vector<Shard> shards_;
+    std::vector<char> proc_buffer_ = std::vector<char>(64 * 1024);
+    std::vector<pid_t> pids_;
+    std::string paths_;
+    std::vector<Entry> entries_;
+};
+
+static void show_help() {
+  std::cout << "Uso: fdindex [-h] [-R] [-j hilos] [-s segundos] dir1 [dir2 ...]\n";
+}
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string_view> args(argv + 1, argv + argc);
+  std::vector<std::string> directories;
+  bool recursive = false;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  int interval = 0;
+  for (auto it = args.begin(), end = args.end(); it != end; ++it) {
+    if (*it == "-h" || *it == "--help") {
+      show_help();
+      return EXIT_SUCCESS;
+    } else if (*it == "-R") {
+      recursive = true;
+    } else if (*it == "-j" || *it == "-s") {
+      bool is_threads = *it == "-j";
+      if (++it == end || it->starts_with("-")) {
+        std::cerr << "Error: falta un argumento\n";
+        return EXIT_FAILURE;
+      }
+      int value = std::atoi(it->data());
+      if (value <= 0) {
+        std::cerr << "Error: valor inválido " << *it << "\n";
+        return EXIT_FAILURE;
+      }
+      if (is_threads) {
+        threads = static_cast<unsigned>(value);
+      } else {
+        interval = value;
+      }
+    } else if (!it->starts_with("-")) {
+      directories.emplace_back(*it);
+    } else {
+      std::cerr << "Opción inválida: " << *it << "\n";
+      show_help();
+      return EXIT_FAILURE;
+    }
+  }
+  if (directories.empty()) {
+    std::cerr << "Se esperaba al menos un directorio\n";
+    show_help();
+    return EXIT_FAILURE;
+  }
+  // Las rutas de /proc/<pid>/fd son absolutas y canónicas, así que la consulta también
+  for (auto& directory : directories) {
+    char resolved[PATH_MAX];
+    if (realpath(directory.c_str(), resolved) == nullptr) {
+      std::cerr << "Error: el directorio " << directory << " no existe\n";
+      return EXIT_FAILURE;
+    }
+    directory = resolved;
+  }
+
+  OpenFileIndex index{threads};
+  std::vector<pid_t> pids;
+  for (unsigned long sample = 0;; ++sample) {
+    index.rebuild();
+    pids.clear();
+    for (const auto& directory : directories) {
+      index.query(directory, recursive, pids);
+    }
+    std::string output;
+    if (interval > 0) {
+      output += "# muestra " + std::to_string(sample) + "\n";
+    }
+    for (pid_t pid : pids) {
+      output += std::to_string(pid);
+      output += '\n';
+    }
+    std::cout << output << std::flush;
+    if (interval == 0) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(interval));
+  }
+  return EXIT_SUCCESS;
+}
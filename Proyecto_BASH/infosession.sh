@@ -8,7 +8,7 @@
 
 # Función para mostrar la ayuda
 function show_help() {
-    echo "Uso: $0 [-h] [-z] [-u user1 user2 ... ] [-d dir] [-t] [-e] [-sm] [-sg] [-r]"
+    echo "Uso: $0 [-h] [-z] [-u user1 user2 ... ] [-d dir] [-t] [-e] [-sm] [-sg] [-r] [-w segundos]"
     echo "  -h       Muestra esta ayuda y termina"
     echo "  -z       Incluye procesos con sesión 0"
     echo "  -u user  Muestra procesos cuyo usuario efectivo sea el especificado (acepta múltiples usuarios)"
@@ -18,6 +18,7 @@ function show_help() {
     echo "  -sm      Ordena la salida por memoria"
     echo "  -sg      Ordena la salida por grupos"
     echo "  -r       Ordena la salida de forma inversa"
+    echo "  -w seg   Modo monitor: refresca las tablas cada 'seg' segundos (requiere procmon compilado)"
     exit 2
 }
 
@@ -31,6 +32,7 @@ NORMAL_MODE=0
 SORT_MEM=0
 SORT_GROUPS=0
 REVERSE=0
+WATCH_INTERVAL=""
 
 # Procesar opciones de la línea de comandos
 while [ -n "$1" ]; do
@@ -64,6 +66,8 @@ while [ -n "$1" ]; do
         -sg) SORT_GROUPS=1; shift ;;
         # ORDENAR INVERSO
         -r) REVERSE=1; shift ;;
+        # MODO MONITOR
+        -w) WATCH_INTERVAL="$2"; shift 2 ;;
         *) echo "Opción inválida: -$1" >&2
            show_help ;;
     esac
@@ -90,6 +94,28 @@ if [ $SHOW_HELP -eq 1 ]; then
     show_help
 fi
 
+# MODO MONITOR: se delega en procmon (procmon.cc), que mantiene las muestras entre intervalos
+if [ -n "$WATCH_INTERVAL" ]; then
+    PROCMON="$(dirname "$0")/procmon"
+    if [ ! -x "$PROCMON" ]; then
+        echo "El modo monitor requiere compilar procmon.cc junto al script" >&2
+        exit 1
+    fi
+    if [ -n "$DIRECTORY" ]; then
+        echo "No se puede filtrar por directorio en el modo monitor" >&2
+        exit 1
+    fi
+    monitor_args=(-n "$WATCH_INTERVAL")
+    [ $INCLUDE_SID_0 -eq 1 ] && monitor_args+=(-z)
+    [ ${#USERS[@]} -gt 0 ] && monitor_args+=(-u "${USERS[@]}")
+    [ $FILTER_TTY -eq 1 ] && monitor_args+=(-t)
+    [ $NORMAL_MODE -eq 1 ] && monitor_args+=(-e)
+    [ $SORT_MEM -eq 1 ] && monitor_args+=(-sm)
+    [ $SORT_GROUPS -eq 1 ] && monitor_args+=(-sg)
+    [ $REVERSE -eq 1 ] && monitor_args+=(-r)
+    exec "$PROCMON" "${monitor_args[@]}"
+fi
+
 # Comando base de ps para obtener procesos
 ps_command="ps -eo sid,pgid,pid,euser,tty,%mem,cmd"
 
@@ -110,8 +136,15 @@ processes=$(eval "$ps_command")
 
 # APARTADO 2 b)
 if [ -n "$DIRECTORY" ]; then
-    dir_processes=$(lsof +d "$DIRECTORY" | awk '{print $2}') # Cogemos la columna de los PIDs
-    processes=$(echo "$processes" | grep -w -f <(echo "$dir_processes")) # Filtramos los procesos
+    # Si está compilado, usamos el índice nativo de /proc (fdindex.cc); si no, lsof
+    FDINDEX="$(dirname "$0")/fdindex"
+    if [ -x "$FDINDEX" ]; then
+        dir_processes=$("$FDINDEX" "$DIRECTORY")
+    else
+        dir_processes=$(lsof +d "$DIRECTORY" 2>/dev/null | awk 'NR > 1 {print $2}') # Cogemos la columna de los PIDs
+    fi
+    # Filtramos comparando solo la columna PID ($3), no cualquier número de la línea
+    processes=$(echo "$processes" | awk -v pids="$dir_processes" 'BEGIN { n = split(pids, list); for (i = 1; i <= n; i++) wanted[list[i]] = 1 } $3 in wanted')
 fi
 
 # APARTADO 2 c)
@@ -0,0 +1,599 @@
+/**
+ * 2º Grado en Ingeniería Informática
+ * Proyecto BASH - Sistemas Operativos
+ * @file procmon.cc
+ * @brief procmon [-h] [-z] [-u user1 user2 ...] [-t] [-e] [-sm] [-sg] [-r] [-n segundos] [-i iteraciones]
+ *
+ * Modo monitor de infosession.sh (opción -w): en lugar de relanzar ps/awk en cada intervalo,
+ * mantiene las muestras anteriores en tablas estructura-de-arrays y calcula los incrementos de
+ * memoria y CPU por sesión de forma incremental.
+ *
+ * En cada intervalo:
+ *  - Se listan los PIDs de /proc con getdents64 y se comparan con la muestra anterior:
+ *    solo los procesos nuevos se leen completos (stat, status y cmdline).
+ *  - Los procesos existentes se releen con un único pread() sobre su /proc/<pid>/stat, que se
+ *    mantiene abierto. Los que no cambian se comprueban cada vez con menos frecuencia (hasta
+ *    cada 4 intervalos) y vuelven a cada intervalo en cuanto cambian.
+ *  - Los totales de cada sesión se actualizan sumando la diferencia entre la muestra nueva y la
+ *    anterior, nunca recorriendo todos los procesos de la sesión.
+ *
+ * Compilar con: g++ -std=c++23 -O2 procmon.cc -o procmon
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <sys/sysmacros.h>
+#include "ProcDir.h"
+
+// Opciones, con el mismo significado que en infosession.sh
+struct monitor_options {
+  bool include_sid_0 = false;
+  bool filter_tty = false;
+  bool normal_mode = false;
+  bool sort_mem = false;
+  bool sort_groups = false;
+  bool reverse = false;
+  int interval = 2;
+  long iterations = -1;
+  std::vector<std::string> users;
+};
+
+// Campos de /proc/<pid>/stat que usa el monitor
+struct stat_sample {
+  pid_t pgid = 0;
+  pid_t sid = 0;
+  int tty = 0;
+  uint64_t cpu_ticks = 0;
+  uint64_t start_time = 0;
+  uint64_t rss_pages = 0;
+};
+
+constexpr uint32_t no_slot = UINT32_MAX;
+constexpr unsigned max_backoff = 4;   // Intervalos como mucho entre dos lecturas de un proceso inactivo
+constexpr unsigned schedule_size = max_backoff + 1;
+
+/// @brief Lee y analiza /proc/<pid>/stat a partir de un descriptor ya abierto
+/// @return true si se pudo leer (false si el proceso ya no existe)
+static bool read_stat(int fd, stat_sample& sample) {
+  char buffer[1024];
+  ssize_t length = pread(fd, buffer, sizeof(buffer) - 1, 0);
+  if (length <= 0) {
+    return false;
+  }
+  buffer[length] = '\0';
+  // El nombre del comando puede contener espacios y paréntesis: se parte del último ')'
+  char* cursor = strrchr(buffer, ')');
+  if (cursor == nullptr) {
+    return false;
+  }
+  cursor += 2;
+  uint64_t fields[22] = {};
+  for (int field = 0; field < 22 && *cursor != '\0'; ++field) {
+    if (field == 0) {
+      cursor += 2; // Estado (un carácter)
+      continue;
+    }
+    fields[field] = strtoull(cursor, &cursor, 10);
+    ++cursor;
+  }
+  sample.pgid = static_cast<pid_t>(fields[2]);
+  sample.sid = static_cast<pid_t>(fields[3]);
+  sample.tty = static_cast<int>(fields[4]);
+  sample.cpu_ticks = fields[11] + fields[12];
+  sample.start_time = fields[19];
+  sample.rss_pages = fields[21];
+  return true;
+}
+
+/// @brief Nombre de terminal al estilo de ps a partir de tty_nr
+static std::string tty_name(int tty) {
+  unsigned major_number = major(tty), minor_number = minor(tty);
+  if (tty == 0) {
+    return "?";
+  }
+  if (major_number >= 136 && major_number <= 143) {
+    return "pts/" + std::to_string((major_number - 136) * 256 + minor_number);
+  }
+  if (major_number == 4) {
+    return minor_number < 64 ? "tty" + std::to_string(minor_number) : "ttyS" + std::to_string(minor_number - 64);
+  }
+  return "?";
+}
+
+// Tabla de procesos en formato estructura-de-arrays: cada columna es un vector indexado por
+// el hueco (slot) del proceso. Los huecos libres se reutilizan para no mover datos.
+struct process_table {
+  std::vector<pid_t> pid, sid, pgid;
+  std::vector<uid_t> uid;
+  std::vector<int> tty;
+  std::vector<int> stat_fd;
+  std::vector<uint64_t> rss_pages, cpu_ticks, start_time;
+  std::vector<uint32_t> cpu_permille; // %CPU * 10 en el último intervalo observado
+  std::vector<uint64_t> last_check;
+  std::vector<uint8_t> backoff, included;
+  std::vector<std::string> command;
+  std::vector<uint32_t> free_slots;
+  std::unordered_map<pid_t, uint32_t> slot_of;
+
+  uint32_t allocate() {
+    if (!free_slots.empty()) {
+      uint32_t slot = free_slots.back();
+      free_slots.pop_back();
+      return slot;
+    }
+    uint32_t slot = static_cast<uint32_t>(pid.size());
+    for (auto* column : {&pid, &sid, &pgid}) column->push_back(0);
+    uid.push_back(0);
+    tty.push_back(0);
+    stat_fd.push_back(-1);
+    for (auto* column : {&rss_pages, &cpu_ticks, &start_time, &last_check}) column->push_back(0);
+    cpu_permille.push_back(0);
+    backoff.push_back(1);
+    included.push_back(0);
+    command.emplace_back();
+    return slot;
+  }
+};
+
+// Tabla de sesiones, también estructura-de-arrays, con los totales que se muestran
+struct session_table {
+  std::vector<pid_t> sid;
+  std::vector<uint32_t> processes, groups, cpu_permille, leader;
+  std::vector<uint64_t> rss_pages;
+  std::unordered_map<pid_t, uint32_t> slot_of;
+  std::unordered_map<uint64_t, uint32_t> group_members; // (sid, pgid) -> procesos
+
+  uint32_t find_or_add(pid_t session) {
+    auto [it, inserted] = slot_of.try_emplace(session, static_cast<uint32_t>(sid.size()));
+    if (inserted) {
+      sid.push_back(session);
+      processes.push_back(0);
+      groups.push_back(0);
+      cpu_permille.push_back(0);
+      leader.push_back(no_slot);
+      rss_pages.push_back(0);
+    }
+    return it->second;
+  }
+};
+
+class ProcessMonitor {
+  public:
+    explicit ProcessMonitor(const monitor_options& options) : options_{options} {
+      ticks_per_second_ = sysconf(_SC_CLK_TCK);
+      page_size_ = sysconf(_SC_PAGESIZE);
+      FILE* meminfo = fopen("/proc/meminfo", "r");
+      if (meminfo != nullptr) {
+        fscanf(meminfo, "MemTotal: %lu kB", &mem_total_kb_);
+        fclose(meminfo);
+      }
+      for (const auto& user : options_.users) {
+        passwd* entry = getpwnam(user.c_str());
+        if (entry != nullptr) {
+          wanted_uids_.push_back(entry->pw_uid);
+        }
+      }
+    }
+
+    ~ProcessMonitor() {
+      for (int fd : procs_.stat_fd) {
+        if (fd >= 0) {
+          close(fd);
+        }
+      }
+    }
+
+    /// @brief Toma una muestra: altas y bajas de procesos y relectura de los que tocan
+    void sample() {
+      ++tick_;
+      now_ = std::chrono::steady_clock::now();
+      std::vector<pid_t> current = list_pids(proc_buffer_);
+      std::sort(current.begin(), current.end());
+      // Diferencia entre la lista anterior y la actual (ambas ordenadas)
+      auto old_it = previous_pids_.begin();
+      auto new_it = current.begin();
+      while (old_it != previous_pids_.end() || new_it != current.end()) {
+        if (new_it == current.end() || (old_it != previous_pids_.end() && *old_it < *new_it)) {
+          remove_process(*old_it++);
+        } else if (old_it == previous_pids_.end() || *new_it < *old_it) {
+          add_process(*new_it++);
+        } else {
+          ++old_it;
+          ++new_it;
+        }
+      }
+      previous_pids_ = std::move(current);
+      // Releer solo los procesos cuyo turno ha llegado en la rueda de comprobaciones
+      auto& due = schedule_[tick_ % schedule_size];
+      std::vector<std::pair<uint32_t, pid_t>> pending;
+      pending.swap(due);
+      for (auto [slot, pid] : pending) {
+        if (slot < procs_.pid.size() && procs_.pid[slot] == pid) {
+          refresh(slot);
+        }
+      }
+      last_sample_ = now_;
+    }
+
+    /// @brief Dibuja las tablas de la muestra actual
+    std::string render() const {
+      std::string out = "\033[H\033[2J";
+      char line[512];
+      std::time_t wall = std::time(nullptr);
+      std::strftime(line, sizeof(line), "%H:%M:%S", std::localtime(&wall));
+      out += std::string("procmon - ") + line + " - " + std::to_string(previous_pids_.size()) + " procesos\n";
+      if (options_.normal_mode) {
+        render_processes(out);
+      } else {
+        render_sessions(out);
+      }
+      return out;
+    }
+
+  private:
+    bool wanted(uint32_t slot) const {
+      if (!options_.include_sid_0 && procs_.sid[slot] == 0) {
+        return false;
+      }
+      if (options_.filter_tty && procs_.tty[slot] == 0) {
+        return false;
+      }
+      if (!options_.users.empty() &&
+          std::find(wanted_uids_.begin(), wanted_uids_.end(), procs_.uid[slot]) == wanted_uids_.end()) {
+        return false;
+      }
+      return true;
+    }
+
+    void add_process(pid_t pid) {
+      char path[64];
+      snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+      int fd = open(path, O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return;
+      }
+      stat_sample sample;
+      if (!read_stat(fd, sample)) {
+        close(fd);
+        return;
+      }
+      uint32_t slot = procs_.allocate();
+      procs_.slot_of[pid] = slot;
+      procs_.pid[slot] = pid;
+      procs_.stat_fd[slot] = fd;
+      procs_.sid[slot] = sample.sid;
+      procs_.pgid[slot] = sample.pgid;
+      procs_.tty[slot] = sample.tty;
+      procs_.rss_pages[slot] = sample.rss_pages;
+      procs_.cpu_ticks[slot] = sample.cpu_ticks;
+      procs_.start_time[slot] = sample.start_time;
+      procs_.cpu_permille[slot] = 0;
+      procs_.last_check[slot] = tick_;
+      procs_.backoff[slot] = 1;
+      procs_.uid[slot] = read_uid(pid);
+      procs_.command[slot] = read_command(pid);
+      procs_.included[slot] = wanted(slot);
+      if (procs_.included[slot]) {
+        attach(slot);
+      }
+      schedule_[(tick_ + 1) % schedule_size].emplace_back(slot, pid);
+    }
+
+    void remove_process(pid_t pid) {
+      auto it = procs_.slot_of.find(pid);
+      if (it == procs_.slot_of.end()) {
+        return;
+      }
+      uint32_t slot = it->second;
+      if (procs_.included[slot]) {
+        detach(slot);
+      }
+      close(procs_.stat_fd[slot]);
+      procs_.stat_fd[slot] = -1;
+      procs_.pid[slot] = 0;
+      procs_.command[slot].clear();
+      procs_.free_slots.push_back(slot);
+      procs_.slot_of.erase(it);
+    }
+
+    void refresh(uint32_t slot) {
+      pid_t pid = procs_.pid[slot];
+      stat_sample sample;
+      if (!read_stat(procs_.stat_fd[slot], sample) || sample.start_time != procs_.start_time[slot]) {
+        // El proceso terminó (o el PID se reutilizó): se trata como baja y, si sigue, alta
+        remove_process(pid);
+        add_process(pid);
+        return;
+      }
+      uint64_t elapsed_ticks = tick_ - procs_.last_check[slot];
+      double seconds = std::chrono::duration<double>(now_ - last_sample_).count() +
+                       static_cast<double>(elapsed_ticks - 1) * options_.interval;
+      uint64_t cpu_delta = sample.cpu_ticks - procs_.cpu_ticks[slot];
+      uint32_t permille = seconds > 0 ? static_cast<uint32_t>(1000.0 * cpu_delta / ticks_per_second_ / seconds) : 0;
+      bool moved = sample.sid != procs_.sid[slot] || sample.pgid != procs_.pgid[slot] || sample.tty != procs_.tty[slot];
+      bool changed = moved || cpu_delta != 0 || sample.rss_pages != procs_.rss_pages[slot];
+      if (moved) {
+        // Cambio de sesión, de grupo o de terminal (setsid/setpgid): se recoloca el proceso y se
+        // vuelve a decidir si entra en el filtro, que depende de la sesión y del terminal
+        if (procs_.included[slot]) {
+          detach(slot);
+        }
+        procs_.sid[slot] = sample.sid;
+        procs_.pgid[slot] = sample.pgid;
+        procs_.tty[slot] = sample.tty;
+        procs_.rss_pages[slot] = sample.rss_pages;
+        procs_.cpu_permille[slot] = permille;
+        procs_.included[slot] = wanted(slot);
+        if (procs_.included[slot]) {
+          attach(slot);
+        }
+      } else if (procs_.included[slot]) {
+        uint32_t session = sessions_.slot_of.at(procs_.sid[slot]);
+        sessions_.rss_pages[session] += sample.rss_pages - procs_.rss_pages[slot];
+        sessions_.cpu_permille[session] += permille - procs_.cpu_permille[slot];
+      }
+      procs_.rss_pages[slot] = sample.rss_pages;
+      procs_.cpu_ticks[slot] = sample.cpu_ticks;
+      procs_.cpu_permille[slot] = permille;
+      procs_.last_check[slot] = tick_;
+      // Los procesos inactivos se comprueban cada vez con menos frecuencia
+      procs_.backoff[slot] = changed ? 1 : std::min<unsigned>(procs_.backoff[slot] * 2, max_backoff);
+      schedule_[(tick_ + procs_.backoff[slot]) % schedule_size].emplace_back(slot, pid);
+    }
+
+    void attach(uint32_t slot) {
+      uint32_t session = sessions_.find_or_add(procs_.sid[slot]);
+      ++sessions_.processes[session];
+      sessions_.rss_pages[session] += procs_.rss_pages[slot];
+      sessions_.cpu_permille[session] += procs_.cpu_permille[slot];
+      uint64_t group_key = (static_cast<uint64_t>(procs_.sid[slot]) << 32) | static_cast<uint32_t>(procs_.pgid[slot]);
+      if (sessions_.group_members[group_key]++ == 0) {
+        ++sessions_.groups[session];
+      }
+      if (procs_.pid[slot] == procs_.sid[slot]) {
+        sessions_.leader[session] = slot;
+      }
+    }
+
+    void detach(uint32_t slot) {
+      uint32_t session = sessions_.slot_of.at(procs_.sid[slot]);
+      --sessions_.processes[session];
+      sessions_.rss_pages[session] -= procs_.rss_pages[slot];
+      sessions_.cpu_permille[session] -= procs_.cpu_permille[slot];
+      uint64_t group_key = (static_cast<uint64_t>(procs_.sid[slot]) << 32) | static_cast<uint32_t>(procs_.pgid[slot]);
+      auto group = sessions_.group_members.find(group_key);
+      if (--group->second == 0) {
+        sessions_.group_members.erase(group);
+        --sessions_.groups[session];
+      }
+      if (sessions_.leader[session] == slot) {
+        sessions_.leader[session] = no_slot;
+      }
+    }
+
+    static uid_t read_uid(pid_t pid) {
+      char path[64];
+      snprintf(path, sizeof(path), "/proc/%d/status", pid);
+      FILE* status = fopen(path, "r");
+      uid_t euid = 0;
+      if (status == nullptr) {
+        return euid;
+      }
+      char line[256];
+      while (fgets(line, sizeof(line), status) != nullptr) {
+        unsigned real, effective;
+        if (sscanf(line, "Uid: %u %u", &real, &effective) == 2) {
+          euid = effective;
+          break;
+        }
+      }
+      fclose(status);
+      return euid;
+    }
+
+    static std::string read_command(pid_t pid) {
+      char path[64];
+      snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+      int fd = open(path, O_RDONLY | O_CLOEXEC);
+      char buffer[256];
+      ssize_t length = fd >= 0 ? read(fd, buffer, sizeof(buffer) - 1) : -1;
+      if (fd >= 0) {
+        close(fd);
+      }
+      if (length > 0) {
+        buffer[length] = '\0';
+        return buffer; // Primer argumento, como la columna $7 de infosession.sh
+      }
+      snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+      fd = open(path, O_RDONLY | O_CLOEXEC);
+      length = fd >= 0 ? read(fd, buffer, sizeof(buffer) - 1) : -1;
+      if (fd >= 0) {
+        close(fd);
+      }
+      if (length <= 0) {
+        return "?";
+      }
+      buffer[length - 1] = '\0'; // Quitar el salto de línea
+      return "[" + std::string(buffer) + "]";
+    }
+
+    const std::string& user_name(uid_t uid) const {
+      auto it = user_names_.find(uid);
+      if (it == user_names_.end()) {
+        passwd* entry = getpwuid(uid);
+        it = user_names_.emplace(uid, entry != nullptr ? entry->pw_name : std::to_string(uid)).first;
+      }
+      return it->second;
+    }
+
+    double mem_percent(uint64_t pages) const {
+      if (mem_total_kb_ == 0) {
+        return 0.0;
+      }
+      return 100.0 * static_cast<double>(pages * page_size_ / 1024) / static_cast<double>(mem_total_kb_);
+    }
+
+    template <typename Key>
+    void sort_rows(std::vector<uint32_t>& rows, Key&& key) const {
+      std::stable_sort(rows.begin(), rows.end(), [&](uint32_t a, uint32_t b) {
+        return options_.reverse ? key(b) < key(a) : key(a) < key(b);
+      });
+    }
+
+    void render_processes(std::string& out) const {
+      char line[512];
+      snprintf(line, sizeof(line), "%-7s | %-7s | %-7s | %-10s | %-7s | %-6s | %-6s | %s\n",
+               "SID", "PGID", "PID", "Usuario", "TTY", "% Mem", "% CPU", "Comando");
+      out += line;
+      std::vector<uint32_t> rows;
+      for (auto [pid, slot] : procs_.slot_of) {
+        if (procs_.included[slot]) {
+          rows.push_back(slot);
+        }
+      }
+      if (options_.sort_mem) {
+        sort_rows(rows, [&](uint32_t slot) { return procs_.rss_pages[slot]; });
+      } else {
+        sort_rows(rows, [&](uint32_t slot) { return std::make_pair(user_name(procs_.uid[slot]), procs_.pid[slot]); });
+      }
+      for (uint32_t slot : rows) {
+        snprintf(line, sizeof(line), "%-7d | %-7d | %-7d | %-10s | %-7s | %-6.1f | %-6.1f | %s\n",
+                 procs_.sid[slot], procs_.pgid[slot], procs_.pid[slot], user_name(procs_.uid[slot]).c_str(),
+                 tty_name(procs_.tty[slot]).c_str(), mem_percent(procs_.rss_pages[slot]),
+                 procs_.cpu_permille[slot] / 10.0, procs_.command[slot].c_str());
+        out += line;
+      }
+    }
+
+    void render_sessions(std::string& out) const {
+      char line[512];
+      snprintf(line, sizeof(line), "%-7s | %-12s | %-10s | %-10s | %-15s | %-10s | %-7s | %s\n",
+               "SID", "Total Grupos", "%MEM Total", "%CPU Total", "PID Lider", "USER Lider", "TTY", "Comando");
+      out += line;
+      std::vector<uint32_t> rows;
+      for (uint32_t session = 0; session < sessions_.sid.size(); ++session) {
+        if (sessions_.processes[session] > 0) {
+          rows.push_back(session);
+        }
+      }
+      auto leader_user = [&](uint32_t session) {
+        uint32_t leader = sessions_.leader[session];
+        return leader == no_slot ? std::string{"?"} : user_name(procs_.uid[leader]);
+      };
+      if (options_.sort_mem) {
+        sort_rows(rows, [&](uint32_t session) { return sessions_.rss_pages[session]; });
+      } else if (options_.sort_groups) {
+        sort_rows(rows, [&](uint32_t session) { return sessions_.groups[session]; });
+      } else {
+        sort_rows(rows, [&](uint32_t session) { return std::make_pair(leader_user(session), sessions_.sid[session]); });
+      }
+      for (uint32_t session : rows) {
+        uint32_t leader = sessions_.leader[session];
+        bool known = leader != no_slot;
+        snprintf(line, sizeof(line), "%-7d | %-12u | %-10.1f | %-10.1f | %-15s | %-10s | %-7s | %s\n",
+                 sessions_.sid[session], sessions_.groups[session], mem_percent(sessions_.rss_pages[session]),
+                 sessions_.cpu_permille[session] / 10.0, known ? std::to_string(procs_.pid[leader]).c_str() : "?",
+                 leader_user(session).c_str(), known ? tty_name(procs_.tty[leader]).c_str() : "?",
+                 known ? procs_.command[leader].c_str() : "?");
+        out += line;
+      }
+    }
+
+    monitor_options options_;
+    long ticks_per_second_ = 100;
+    long page_size_ = 4096;
+    unsigned long mem_total_kb_ = 0;
+    std::vector<uid_t> wanted_uids_;
+    mutable std::unordered_map<uid_t, std::string> user_names_;
+    std::vector<char> proc_buffer_ = std::vector<char>(64 * 1024);
+    std::vector<pid_t> previous_pids_;
+    process_table procs_;
+    session_table sessions_;
+    // Rueda de comprobaciones: schedule_[t % schedule_size] guarda (slot, pid) a releer en el intervalo t
+    std::vector<std::pair<uint32_t, pid_t>> schedule_[schedule_size];
+    uint64_t tick_ = 0;
+    std::chrono::steady_clock::time_point now_, last_sample_;
+};
+
+static void show_help() {
+  std::cout << "Uso: procmon [-h] [-z] [-u user1 user2 ...] [-t] [-e] [-sm] [-sg] [-r] [-n segundos] [-i iteraciones]\n";
+}
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string_view> args(argv + 1, argv + argc);
+  monitor_options options;
+  for (auto it = args.begin(), end = args.end(); it != end; ++it) {
+    if (*it == "-h" || *it == "--help") {
+      show_help();
+      return EXIT_SUCCESS;
+    } else if (*it == "-z") {
+      options.include_sid_0 = true;
+    } else if (*it == "-t") {
+      options.filter_tty = true;
+    } else if (*it == "-e") {
+      options.normal_mode = true;
+    } else if (*it == "-sm") {
+      options.sort_mem = true;
+    } else if (*it == "-sg") {
+      options.sort_groups = true;
+    } else if (*it == "-r") {
+      options.reverse = true;
+    } else if (*it == "-u") {
+      while (it + 1 != end && !(it + 1)->starts_with("-")) {
+        options.users.emplace_back(*++it);
+      }
+      if (options.users.empty()) {
+        std::cerr << "Se esperaba al menos un usuario\n";
+        return EXIT_FAILURE;
+      }
+    } else if (*it == "-n" || *it == "-i") {
+      bool is_interval = *it == "-n";
+      if (++it == end || std::atol(it->data()) <= 0) {
+        std::cerr << "Error: falta un argumento o no es válido\n";
+        return EXIT_FAILURE;
+      }
+      if (is_interval) {
+        options.interval = std::atoi(it->data());
+      } else {
+        options.iterations = std::atol(it->data());
+      }
+    } else {
+      std::cerr << "Opción inválida: " << *it << "\n";
+      show_help();
+      return EXIT_FAILURE;
+    }
+  }
+  if (options.sort_mem && options.sort_groups) {
+    std::cerr << "No se puede ordenar por memoria y por grupos simultáneamente\n";
+    return EXIT_FAILURE;
+  }
+  if (options.sort_groups && options.normal_mode) {
+    std::cerr << "No se puede ordenar por grupos si no es en el modo resumen\n";
+    return EXIT_FAILURE;
+  }
+
+  ProcessMonitor monitor{options};
+  monitor.sample();
+  for (long iteration = 0; options.iterations < 0 || iteration < options.iterations; ++iteration) {
+    std::this_thread::sleep_for(std::chrono::seconds(options.interval));
+    monitor.sample();
+    std::string frame = monitor.render();
+    if (write(STDOUT_FILENO, frame.data(), frame.size()) < 0) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
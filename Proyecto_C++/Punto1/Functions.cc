@@ -1,4 +1,5 @@
 #include "Functions.h"
+#include <sys/sendfile.h>
 
 /// @brief Pasa los argumentos de la línea de comandos
 /// @param argc 
@@ -16,7 +17,7 @@ std::expected<program_options, parse_args_errors> parse_args(int argc, char* arg
         } else if (*it == "-v" || *it == "--verbose") {
             options.verbose = true;
         } else if (!it->starts_with("-")) {
-            options.output_filename = std::string(*it);
+            options.filenames.emplace_back(*it);
         } else {
             return std::unexpected(parse_args_errors::unknown_option);
         }
@@ -24,44 +25,107 @@ std::expected<program_options, parse_args_errors> parse_args(int argc, char* arg
     return options;
 }
 
-/// @brief Lee el contenido de un archivo
+/// @brief Abre un documento para volcarlo y obtiene su tamaño
 /// @param path
-/// @return std::string
-std::expected<SafeMap, int> read_all(const std::string& path) {
-  int fd; // File descriptor
-  SafeFD safe_fd{fd = open(path.c_str(), O_RDONLY)}; // Safe file descriptor
-
-  // Comprobar si se ha abierto correctamente el archivo
-  if (!safe_fd.is_valid()) { 
+/// @return document o errno
+std::expected<document, int> open_document(const std::string& path) {
+  SafeFD fd{open(path.c_str(), O_RDONLY)};
+  if (!fd.is_valid()) {
+    return std::unexpected(errno);
+  }
+  struct stat info;
+  if (fstat(fd.get(), &info) < 0) {
     return std::unexpected(errno);
-  } 
+  }
+  if (S_ISDIR(info.st_mode)) {
+    return std::unexpected(EISDIR);
+  }
+  // El archivo se lee una única vez de principio a fin: lectura anticipada agresiva
+  posix_fadvise(fd.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+  return document{std::move(fd), static_cast<uint64_t>(info.st_size)};
+}
 
-  // Para mapear una archivo completo es necesario conocer su tamaño.
-  // Una forma es usar fstat() y otra es usar lseek().
-  // La función lseek() sirve para mover el puntero de lectura/escritura de un archivo y retorna la posición
-  // a la que se ha movido. Por tanto, si se mueve al final del archivo, se obtiene el tamaño de este.
-  int length = lseek(fd, 0, SEEK_END);
+/// @brief Escribe todos los bytes en un descriptor, reintentando las escrituras parciales
+/// @param fd
+/// @param data
+/// @return 0 o -1 (con errno)
+int write_all(int fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t written = write(fd, data.data(), data.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    data.remove_prefix(static_cast<size_t>(written));
+  }
+  return 0;
+}
 
-  // Se mapea el archivo completo en memoria para solo lectura y de forma privada
-  void* mem = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
-  // Comprobar si se ha mapeado correctamente el archivo
-  if (mem == MAP_FAILED) {
+/// @brief Vuelca el contenido de un documento en un descriptor sin pasar por iostream
+/// Si la salida es una tubería se usa splice() y si es un socket o un archivo, sendfile():
+/// los datos van de la caché de páginas a la salida sin copiarse al proceso. Si el kernel no
+/// lo admite (terminal, archivo en modo O_APPEND...) se continúa con read()/write() y un
+/// búfer grande.
+/// @param doc Documento abierto con open_document
+/// @param out_fd Descriptor de salida
+/// @return Bytes escritos o errno
+std::expected<uint64_t, int> stream_document(const document& doc, int out_fd) {
+  constexpr size_t chunk_size = 1 << 20; // Bloques de 1 MiB (y nunca más de lo que cabe en ssize_t)
+  struct stat out_info;
+  if (fstat(out_fd, &out_info) < 0) {
     return std::unexpected(errno);
   }
+  off_t offset = 0;
+  uint64_t remaining = doc.size;
 
-  // Opcionalmente, se puede cerrar el archivo después de mapearlo (aunque el destructor de la clase lo hace automáticamente)
-  close(safe_fd.get());
-
-  // Copiar los datos mapeados en un std::string_view
-  std::string_view sv{static_cast<char*>(mem), static_cast<size_t>(length)};
-  SafeMap safe_map{sv}; // Lo guardamos en un SafeMap
+  // Camino sin copias
+  bool zero_copy = true;
+  while (remaining > 0 && zero_copy) {
+    size_t chunk = static_cast<size_t>(std::min<uint64_t>(remaining, 16 * chunk_size));
+    ssize_t sent;
+    if (S_ISFIFO(out_info.st_mode)) {
+      sent = splice(doc.fd.get(), &offset, out_fd, nullptr, chunk, SPLICE_F_MORE);
+    } else {
+      sent = sendfile(out_fd, doc.fd.get(), &offset, chunk);
+    }
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EINVAL && errno != ENOSYS) {
+        return std::unexpected(errno);
+      }
+      zero_copy = false; // La salida no lo admite y no se ha movido nada en esta llamada
+    } else if (sent == 0) {
+      return std::unexpected(EIO); // El archivo se ha acortado mientras se volcaba
+    } else {
+      remaining -= static_cast<uint64_t>(sent);
+    }
+  }
 
-  return safe_map;
+  // Camino de respaldo con búfer
+  if (remaining > 0) {
+    std::vector<char> buffer(chunk_size);
+    while (remaining > 0) {
+      size_t chunk = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+      ssize_t count = pread(doc.fd.get(), buffer.data(), chunk, offset);
+      if (count < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return std::unexpected(errno);
+      }
+      if (count == 0) {
+        return std::unexpected(EIO);
+      }
+      if (write_all(out_fd, {buffer.data(), static_cast<size_t>(count)}) < 0) {
+        return std::unexpected(errno);
+      }
+      offset += count;
+      remaining -= static_cast<uint64_t>(count);
+    }
+  }
+  return doc.size;
 }
-
-/// @brief Muestra el contenido de un archivo
-/// @param header
-/// @param body
-void send_response(std::string_view header, std::string_view body) {
-  std::cout << header << body << std::endl;
-}
\ No newline at end of file
@@ -13,7 +13,6 @@
 #include <unistd.h>
 
 #include "SafeFD.h"
-#include "SafeMap.h"
 
 // Enumerado para los errores de parse_args
 enum class parse_args_errors
@@ -29,13 +28,22 @@ struct program_options
   bool show_help = false;
   bool verbose = false;
   bool no_size = false;
-  std::string output_filename;
+  std::vector<std::string> filenames; // Archivos a volcar, en orden
   // ...
   std::vector<std::string> additional_args; 
 };
 
 std::expected<program_options, parse_args_errors> parse_args(int argc, char* argv[]);
-std::expected<SafeMap, int> read_all(const std::string& path);
-void send_response(std::string_view header, std::string_view body = {});
+
+// Documento abierto para volcarlo sin mapearlo en memoria
+struct document
+{
+  SafeFD fd;
+  uint64_t size;
+};
+
+std::expected<document, int> open_document(const std::string& path);
+int write_all(int fd, std::string_view data);
+std::expected<uint64_t, int> stream_document(const document& doc, int out_fd);
 
 #endif
\ No newline at end of file
@@ -6,11 +6,15 @@
  * Proyecto C++: Servidor de Documentos
  * @author 
  * @file docserver.cc
- * @brief docserver [-v | --verbose] [-h | --help] ARCHIVO
+ * @brief docserver [-v | --verbose] [-h | --help] [-n] ARCHIVO...
  * @bug No hay bugs conocidos
  * MODIFICACIÓN: Nuevo parámetro -n que si ponemos ese parámetro no sale el tamaño del archivo en pantalla
  *     
  * Compilar con: g++ -std=c++23 docserver.cc Functions.cc
+ * Ejecutar: ./a.out file.txt otro.txt | consumidor
+ * Cada archivo se vuelca como "Content-Length: N\n", contenido y "\n". Si la salida es una
+ * tubería o un socket el contenido pasa de la caché de páginas a la salida sin copias
+ * (splice/sendfile); tamaños de 64 bits.
 */
 
 #include <iostream>
@@ -46,36 +50,43 @@ int main(int argc, char* argv[]) {
   }
   // MENSAJE DE AYUDA
   if (options->show_help) {
-    std::cout << "Usage: docserver [-v | --verbose] [-h | --help] ARCHIVO\n";
+    std::cout << "Usage: docserver [-v | --verbose] [-h | --help] [-n] ARCHIVO...\n";
     return EXIT_SUCCESS;
   }
-  // LEER ARCHIVO
-  auto file = read_all(options->output_filename);
-  // Si el archivo no se puede abrir porque no existe
-  if (!file) {
-    std::cerr << "404 Not Found\n";
+  if (options->filenames.empty()) {
+    std::cerr << "Error: missing argument\n";
     return EXIT_FAILURE;
   }
-  // Si el archivo no se puede abrir porque no tiene permisos
-  if (file.error() == EACCES) {
-    std::cerr << "403 Forbidden\n";
-    return EXIT_FAILURE;
-  }
-  else {
+  // VOLCAR ARCHIVOS
+  // La salida se escribe directamente en el descriptor 1 (sin iostream), así que lo que quede
+  // en el búfer de std::cout se vacía antes de cada escritura directa
+  int exit_code = EXIT_SUCCESS;
+  for (const std::string& filename : options->filenames) {
+    auto doc = open_document(filename);
+    if (!doc) {
+      // Si el archivo no se puede abrir porque no tiene permisos o porque no existe
+      std::cerr << filename << ": " << (doc.error() == EACCES ? "403 Forbidden\n" : "404 Not Found\n");
+      exit_code = EXIT_FAILURE;
+      continue;
+    }
     // OPCIÓN -v | --verbose
     if (options->verbose) {
-      std::cout << "open: abre el archivo " << options->output_filename << std::endl;
-      std::cout << "read: lee " << file->get().size() << " bytes del archivo " << options->output_filename << std::endl;
+      std::cout << "open: abre el archivo " << filename << std::endl;
+      std::cout << "read: lee " << doc->size << " bytes del archivo " << filename << std::endl;
     }
-    std::string_view body = file->get();
     std::string header = "No size option\n";
     if (!options->no_size) {
-      int size = body.size();
       std::ostringstream oss;
-      oss << "Content-Length: " << size << "\n";
+      oss << "Content-Length: " << doc->size << "\n";
       header = oss.str();
     }
-    send_response(header, body);
+    std::cout.flush();
+    auto written = write_all(STDOUT_FILENO, header) < 0 ? std::unexpected(errno) : stream_document(doc.value(), STDOUT_FILENO);
+    if (!written || write_all(STDOUT_FILENO, "\n") < 0) {
+      // Si la salida se cierra (p. ej. "| head") no tiene sentido seguir con el resto
+      std::cerr << filename << ": error al escribir: " << strerror(written ? errno : written.error()) << '\n';
+      return EXIT_FAILURE;
+    }
   }
-  return 0;
-}
\ No newline at end of file
+  return exit_code;
+}
@@ -13,6 +13,8 @@ std::expected<program_options, parse_args_errors> parse_args(int argc, char* arg
             options.show_help = true;
         } else if (*it == "-v" || *it == "--verbose") {
             options.verbose = true;
+        } else if (*it == "-m" || *it == "--pin") {
+            options.pinned = true;
         } else if (*it == "-p" || *it == "--port") {
             // Verificar que hay un valor después de -p
             if (++it == end) {
@@ -129,4 +131,22 @@ int send_response(const SafeFD& socket, std::string_view header, std::string_vie
     return errno;
   }
   return bytes_sent;
-}
\ No newline at end of file
+}
+
+/// @brief Envía todos los bytes, reintentando los envíos parciales
+/// @param socket
+/// @param data
+/// @return 0 o -1 (con errno)
+int send_all(const SafeFD& socket, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t sent = send(socket.get(), data.data(), data.size(), MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    data.remove_prefix(static_cast<size_t>(sent));
+  }
+  return 0;
+}
@@ -33,6 +33,7 @@ struct program_options
   bool verbose = false;
   bool port = false;
   uint16_t port_value = 0;
+  bool pinned = false;           // Servir el documento desde memoria y recargarlo al cambiar
   std::string output_filename;
   // ...
   std::vector<std::string> additional_args; 
@@ -44,6 +45,7 @@ std::expected<SafeFD, int> make_socket(uint16_t port);
 int listen_connection(const SafeFD& socket);
 std::expected<SafeFD, int> accept_connection(const SafeFD& socket, sockaddr_in& client_addr);
 int send_response(const SafeFD& socket, std::string_view header, std::string_view body = {});
+int send_all(const SafeFD& socket, std::string_view data);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,186 @@
+#ifndef PINNEDDOCUMENT_H
+#define PINNEDDOCUMENT_H
+
+#include <atomic>
+#include <cerrno>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SafeFD.h"
+#include "SafeMap.h"
+
+// Una versión del documento: la respuesta completa (cabecera, contenido y '\n' final, o la
+// respuesta de error) ya construida en una zona de memoria anónima bloqueada en RAM
+struct document_version
+{
+  SafeMap response;
+  int error = 0;      // 0, ENOENT, EACCES u otro errno al cargar
+  uint64_t size = 0;  // Tamaño del contenido
+};
+
+// Documento servido desde memoria. Se carga una vez y se sustituye de forma atómica cuando
+// inotify avisa de un cambio; quien esté enviando la versión anterior la mantiene viva con
+// su shared_ptr hasta terminar.
+class PinnedDocument
+{
+  public:
+    explicit PinnedDocument(std::string path) : path_{std::move(path)}
+    {
+      current_.store(load(path_));
+      // Se vigila el directorio y no el archivo: así se detectan también los editores que
+      // guardan escribiendo un archivo nuevo y renombrándolo encima del anterior. Se recarga
+      // al cerrar tras escribir, nunca a mitad de una escritura.
+      size_t slash = path_.rfind('/');
+      std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path_.substr(0, slash);
+      name_ = slash == std::string::npos ? path_ : path_.substr(slash + 1);
+      inotify_ = SafeFD{inotify_init1(IN_CLOEXEC)};
+      stop_ = SafeFD{eventfd(0, EFD_CLOEXEC)};
+      if (inotify_.is_valid() && stop_.is_valid() &&
+          inotify_add_watch(inotify_.get(), directory.c_str(),
+                            IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | IN_ATTRIB) >= 0) {
+        watcher_ = std::thread{&PinnedDocument::watch, this};
+      }
+    }
+    PinnedDocument(const PinnedDocument&) = delete;
+    PinnedDocument& operator=(const PinnedDocument&) = delete;
+
+    ~PinnedDocument()
+    {
+      if (watcher_.joinable()) {
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t written = write(stop_.get(), &one, sizeof(one));
+        watcher_.join();
+      }
+    }
+
+    /// @brief Indica si se están vigilando los cambios (si no, se sirve siempre la primera versión)
+    [[nodiscard]] bool is_watching() const noexcept
+    {
+      return watcher_.joinable();
+    }
+
+    /// @brief Versión actual; sigue siendo válida aunque se recargue mientras se usa
+    [[nodiscard]] std::shared_ptr<const document_version> current() const noexcept
+    {
+      return current_.load(std::memory_order_acquire);
+    }
+
+    /// @brief Número de veces que se ha recargado el documento
+    [[nodiscard]] uint64_t reloads() const noexcept
+    {
+      return reloads_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Construye una versión a partir del archivo (o la respuesta de error correspondiente)
+    static std::shared_ptr<const document_version> load(const std::string& path)
+    {
+      auto version = std::make_shared<document_version>();
+      SafeFD fd{open(path.c_str(), O_RDONLY)};
+      struct stat info;
+      if (!fd.is_valid() || fstat(fd.get(), &info) < 0) {
+        version->error = errno;
+      } else if (S_ISDIR(info.st_mode)) {
+        version->error = EISDIR;
+      } else {
+        version->size = static_cast<uint64_t>(info.st_size);
+        if (pin(*version, "Content-Length: " + std::to_string(version->size) + "\n", fd)) {
+          return version;
+        }
+        version->error = errno;
+        version->size = 0;
+      }
+      if (version->error == ENOENT) {
+        pin(*version, "Error: 404 Not Found\n", fd);
+      } else if (version->error == EACCES) {
+        pin(*version, "Error: 403 Forbidden\n", fd);
+      } else {
+        pin(*version, "Error: 500 Internal Server Error\n", fd);
+      }
+      return version;
+    }
+
+  private:
+    // Copia cabecera, contenido y '\n' en una zona anónima: cada conexión es un único envío
+    static bool pin(document_version& version, const std::string& header, const SafeFD& fd)
+    {
+      size_t length = header.size() + version.size + 1;
+      void* memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+      if (memory == MAP_FAILED) {
+        return false;
+      }
+      char* data = static_cast<char*>(memory);
+      header.copy(data, header.size());
+      size_t done = 0;
+      while (done < version.size) {
+        ssize_t count = pread(fd.get(), data + header.size() + done, version.size - done, static_cast<off_t>(done));
+        if (count < 0 && errno == EINTR) {
+          continue;
+        }
+        if (count <= 0) {
+          // El archivo se ha acortado mientras se leía: llegará otro aviso de inotify
+          munmap(memory, length);
+          errno = count < 0 ? errno : EIO;
+          return false;
+        }
+        done += static_cast<size_t>(count);
+      }
+      data[length - 1] = '\n';
+      // Solo lectura y bloqueada en RAM: servirla nunca provoca un fallo de página
+      mprotect(memory, length, PROT_READ);
+      mlock(memory, length); // Puede fallar por RLIMIT_MEMLOCK; MAP_POPULATE ya la ha cargado
+      version.response = SafeMap{std::string_view{data, length}};
+      return true;
+    }
+
+    // Hilo vigilante: recarga el documento cuando cambia algo con su nombre en el directorio
+    void watch()
+    {
+      alignas(inotify_event) char buffer[4096];
+      pollfd fds[2] = {{inotify_.get(), POLLIN, 0}, {stop_.get(), POLLIN, 0}};
+      while (true) {
+        if (poll(fds, 2, -1) < 0) {
+          continue; // EINTR
+        }
+        if (fds[1].revents & POLLIN) {
+          return;
+        }
+        ssize_t count = read(inotify_.get(), buffer, sizeof(buffer));
+        if (count <= 0) {
+          continue;
+        }
+        bool changed = false;
+        for (ssize_t offset = 0; offset < count;) {
+          auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+          if (event->len > 0 && name_ == event->name) {
+            changed = true;
+          }
+          offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+        }
+        if (changed) {
+          auto version = load(path_);
+          // Un archivo a medio escribir no sustituye a una versión buena
+          if (version->error != EIO) {
+            current_.store(std::move(version), std::memory_order_release);
+            reloads_.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      }
+    }
+
+    std::string path_;
+    std::string name_;
+    std::atomic<std::shared_ptr<const document_version>> current_;
+    std::atomic<uint64_t> reloads_{0};
+    SafeFD inotify_;
+    SafeFD stop_;
+    std::thread watcher_;
+};
+
+#endif
@@ -6,11 +6,15 @@
  * Proyecto C++: Servidor de Documentos
  * @author 
  * @file docserver.cc
- * @brief docserver [-v | --verbose] [-h | --help] ARCHIVO
+ * @brief docserver [-v | --verbose] [-h | --help] [-p | --port] [-m | --pin] ARCHIVO
  * @bug No hay bugs conocidos
  *     
- * Compilar con: g++ -std=c++23 docserver.cc Functions.cc
+ * Compilar con: g++ -std=c++23 -pthread docserver.cc Functions.cc
  * socat STDIO TCP:127.0.0.1:8080
+ *
+ * Con -m | --pin la respuesta se construye una vez en memoria bloqueada y cada conexión es
+ * accept() + send(). Al modificar, sustituir o borrar el archivo (inotify) se construye la
+ * nueva versión y se cambia de forma atómica.
 */
 
 #include <iostream>
@@ -26,7 +30,10 @@
 #include <sstream>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <cstring>
+#include <optional>
 #include "Functions.h"
+#include "PinnedDocument.h"
 
 int main(int argc, char* argv[]) {
     // Procesar los argumentos de la línea de comandos
@@ -42,7 +49,7 @@ int main(int argc, char* argv[]) {
 
     // Mostrar ayuda si es necesario
     if (options->show_help) {
-        std::cout << "Uso: docserver [-v | --verbose] [-h | --help] [-p | --port] ARCHIVO\n";
+        std::cout << "Uso: docserver [-v | --verbose] [-h | --help] [-p | --port] [-m | --pin] ARCHIVO\n";
         return EXIT_SUCCESS;
     }
 
@@ -52,6 +59,15 @@ int main(int argc, char* argv[]) {
         return EXIT_FAILURE;
     }
 
+    // Modo -m | --pin: el documento se carga una sola vez y se recarga cuando cambia
+    std::optional<PinnedDocument> pinned;
+    if (options->pinned) {
+        pinned.emplace(options->output_filename);
+        if (options->verbose) {
+            std::cout << "Documento cargado en memoria" << (pinned->is_watching() ? ", vigilando cambios" : "") << '\n';
+        }
+    }
+
     // Crear un socket y asignarle el puerto indicado
     uint16_t port = options->port ? 8080 : 8080; // Puerto por defecto o el indicado
     auto sock_fd = make_socket(port);
@@ -93,30 +109,38 @@ int main(int argc, char* argv[]) {
         if (options->verbose) {
             std::cout << "Conexión aceptada\n";
         }
+        // Modo -m | --pin: la respuesta ya está construida en memoria, solo queda enviarla
+        if (pinned) {
+            auto version = pinned->current(); // Se mantiene viva hasta terminar el envío
+            if (send_all(new_fd.value(), version->response.get()) < 0) {
+                std::cerr << "Error al enviar la respuesta: " << strerror(errno) << '\n';
+            } else if (options->verbose) {
+                std::cout << "send: envía " << version->response.get().size() << " bytes al cliente\n";
+            }
+            continue; // La conexión se cierra al destruirse el SafeFD
+        }
         // Leer archivo en memoria
         auto file = read_all(options->output_filename);
         if (!file) {
+            // Un error con el archivo se comunica al cliente, pero el servidor sigue aceptando
             if (file.error() == ENOENT) {
                 // Error: archivo no encontrado
                 std::cerr << "404 Not Found\n";
                 send_response(new_fd.value(), "Error: ", "404 Not Found\n");
-                return EXIT_FAILURE;
             } else if (file.error() == EACCES) {
                 // Error: permisos
                 std::cerr << "403 Forbidden\n";
                 send_response(new_fd.value(), "Error", "403 Forbidden\n");
-                return EXIT_FAILURE;
             } else {
                 // Otro error
                 std::cerr << "Error fatal al leer el archivo\n";
-                return EXIT_FAILURE; // Terminar el servidor en caso de otro error grave
             }
+        } else {
             // OPCIÓN -v | --verbose
             if (options->verbose) {
                 std::cout << "open: abre el archivo " << options->output_filename << '\n';
                 std::cout << "read: lee " << file->get().size() << " bytes del archivo " << options->output_filename << '\n';
             }
-        } else {
             // Enviar el contenido del archivo
             std::string_view body = file->get();
             int size = body.size();
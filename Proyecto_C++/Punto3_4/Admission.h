@@ -0,0 +1,103 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+// Límite de concurrencia: cuenta cuántas conexiones (o peticiones de un tipo) hay en curso
+// y rechaza las que superan el máximo sin bloquear a nadie.
+class AdmissionLimiter
+{
+  public:
+    explicit AdmissionLimiter(size_t limit) noexcept : limit_{limit} {}
+    AdmissionLimiter(const AdmissionLimiter&) = delete;
+    AdmissionLimiter& operator=(const AdmissionLimiter&) = delete;
+
+    /// @brief Intenta reservar una plaza
+    /// @return true si se ha reservado, false si ya se ha alcanzado el límite
+    [[nodiscard]] bool try_acquire() noexcept
+    {
+      size_t current = active_.load(std::memory_order_relaxed);
+      do {
+        if (current >= limit_) {
+          rejected_.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        }
+      } while (!active_.compare_exchange_weak(current, current + 1, std::memory_order_acquire));
+      return true;
+    }
+    void release() noexcept
+    {
+      active_.fetch_sub(1, std::memory_order_release);
+    }
+    [[nodiscard]] size_t active() const noexcept
+    {
+      return active_.load(std::memory_order_acquire);
+    }
+    [[nodiscard]] size_t rejected() const noexcept
+    {
+      return rejected_.load(std::memory_order_relaxed);
+    }
+    [[nodiscard]] size_t limit() const noexcept
+    {
+      return limit_;
+    }
+  private:
+    size_t limit_;
+    std::atomic<size_t> active_{0};
+    std::atomic<size_t> rejected_{0};
+};
+
+// Plaza reservada en un AdmissionLimiter; se libera sola al destruirse (igual que SafeFD)
+class AdmissionTicket
+{
+  public:
+    explicit AdmissionTicket() noexcept : limiter_{nullptr} {}
+    explicit AdmissionTicket(AdmissionLimiter& limiter) noexcept
+      : limiter_{limiter.try_acquire() ? &limiter : nullptr} {}
+    AdmissionTicket(const AdmissionTicket&) = delete;
+    AdmissionTicket& operator=(const AdmissionTicket&) = delete;
+    AdmissionTicket(AdmissionTicket&& other) noexcept : limiter_{other.limiter_} {
+      other.limiter_ = nullptr;
+    }
+    AdmissionTicket& operator=(AdmissionTicket&& other) noexcept
+    {
+      if (this != &other)
+      {
+        if (limiter_ != nullptr) {
+          limiter_->release();
+        }
+        limiter_ = other.limiter_;
+        other.limiter_ = nullptr;
+      }
+      return *this;
+    }
+    ~AdmissionTicket() noexcept
+    {
+      if (limiter_ != nullptr)
+      {
+        limiter_->release();
+      }
+    }
+    [[nodiscard]] bool is_valid() const noexcept
+    {
+      return limiter_ != nullptr;
+    }
+  private:
+    AdmissionLimiter* limiter_;
+};
+
+// Límites del servidor: conexiones totales y carriles separados para CGI y archivos estáticos
+struct admission_control
+{
+  AdmissionLimiter connections;
+  AdmissionLimiter cgi;
+  AdmissionLimiter statics;
+  // Respuesta 503 precalculada: rechazar debe costar menos que atender
+  std::string overload_response;
+  // Respuesta 429 precalculada para los clientes por encima de su límite (RateLimit.h)
+  std::string rate_limited_response;
+};
+
+#endif
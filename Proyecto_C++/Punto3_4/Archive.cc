@@ -0,0 +1,285 @@
+#include "Archive.h"
+#include "Functions.h"
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+#include <sys/sendfile.h>
+
+/// @brief Hash de una ruta con semilla
+/// @param key Ruta
+/// @param seed Semilla (0 para elegir el bucket, el desplazamiento para elegir la entrada)
+/// @return Hash de 64 bits
+uint64_t archive_hash(std::string_view key, uint64_t seed) {
+  uint64_t hash = 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull);
+  for (unsigned char c : key) {
+    hash = (hash ^ c) * 1099511628211ull;
+  }
+  // Mezcla final (splitmix64) para repartir bien los bits bajos que usa el módulo
+  hash ^= hash >> 30;
+  hash *= 0xBF58476D1CE4E5B9ull;
+  hash ^= hash >> 27;
+  hash *= 0x94D049BB133111EBull;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+/// @brief Redondea un desplazamiento al siguiente múltiplo de página
+static uint64_t page_align(uint64_t offset) {
+  uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  return (offset + page - 1) / page * page;
+}
+
+/// @brief Escribe todo el buffer en la posición indicada
+static int write_at(int fd, std::string_view data, uint64_t offset) {
+  while (!data.empty()) {
+    ssize_t written = pwrite(fd, data.data(), data.size(), static_cast<off_t>(offset));
+    if (written < 0) {
+      return errno;
+    }
+    data.remove_prefix(static_cast<size_t>(written));
+    offset += static_cast<uint64_t>(written);
+  }
+  return 0;
+}
+
+/// @brief Calcula el hash perfecto mínimo (hash and displace) de las rutas
+/// @param paths Rutas a indexar
+/// @param displacements Desplazamiento elegido para cada bucket
+/// @param slot_of Entrada asignada a cada ruta
+/// @return false si no se encontró un desplazamiento válido para algún bucket
+static bool build_perfect_hash(const std::vector<std::string>& paths, std::vector<uint32_t>& displacements,
+                               std::vector<uint32_t>& slot_of) {
+  const size_t n = paths.size();
+  const size_t bucket_count = displacements.size();
+  std::vector<std::vector<uint32_t>> buckets(bucket_count);
+  for (uint32_t i = 0; i < n; ++i) {
+    buckets[archive_hash(paths[i], 0) % bucket_count].push_back(i);
+  }
+  // Los buckets grandes primero: son los que más cuesta colocar
+  std::vector<uint32_t> order(bucket_count);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+  std::vector<bool> taken(n, false);
+  std::vector<uint32_t> candidate;
+  for (uint32_t bucket : order) {
+    if (buckets[bucket].empty()) {
+      break;
+    }
+    bool placed = false;
+    for (uint32_t displacement = 1; displacement < (1u << 24) && !placed; ++displacement) {
+      candidate.clear();
+      placed = true;
+      for (uint32_t key : buckets[bucket]) {
+        uint32_t slot = static_cast<uint32_t>(archive_hash(paths[key], displacement) % n);
+        if (taken[slot] || std::find(candidate.begin(), candidate.end(), slot) != candidate.end()) {
+          placed = false;
+          break;
+        }
+        candidate.push_back(slot);
+      }
+      if (placed) {
+        displacements[bucket] = displacement;
+        for (size_t k = 0; k < candidate.size(); ++k) {
+          taken[candidate[k]] = true;
+          slot_of[buckets[bucket][k]] = candidate[k];
+        }
+      }
+    }
+    if (!placed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// @brief Empaqueta un directorio en un archivo
+/// @param base_dir Directorio raíz
+/// @param output Archivo a generar
+/// @return Número de documentos empaquetados o errno
+std::expected<size_t, int> build_archive(const std::string& base_dir, const std::string& output) {
+  namespace fs = std::filesystem;
+  std::error_code error;
+  std::vector<std::string> paths;
+  std::vector<uint64_t> sizes;
+  for (auto it = fs::recursive_directory_iterator(base_dir, error); !error && it != fs::recursive_directory_iterator();
+       it.increment(error)) {
+    if (it->is_regular_file(error)) {
+      paths.push_back("/" + fs::relative(it->path(), base_dir, error).generic_string());
+      sizes.push_back(it->file_size(error));
+    }
+  }
+  if (error) {
+    return std::unexpected(error.value());
+  }
+  const size_t n = paths.size();
+  if (n > UINT32_MAX) {
+    return std::unexpected(EFBIG);
+  }
+
+  // Índice: unas 4 rutas por bucket de media
+  std::vector<uint32_t> displacements(std::max<size_t>(1, (n + 3) / 4), 0);
+  std::vector<uint32_t> slot_of(n, 0);
+  if (!build_perfect_hash(paths, displacements, slot_of)) {
+    return std::unexpected(EOVERFLOW);
+  }
+
+  // Cadenas (rutas y cabeceras) y disposición de los contenidos
+  std::string strings;
+  std::vector<archive_entry> entries(n);
+  archive_header header{};
+  std::copy(std::begin(archive_magic), std::end(archive_magic), header.magic);
+  header.entry_count = static_cast<uint32_t>(n);
+  header.bucket_count = static_cast<uint32_t>(displacements.size());
+  header.displacements_offset = sizeof(archive_header);
+  header.entries_offset = header.displacements_offset + displacements.size() * sizeof(uint32_t);
+  header.entries_offset = (header.entries_offset + alignof(archive_entry) - 1) / alignof(archive_entry) * alignof(archive_entry);
+  header.strings_offset = header.entries_offset + n * sizeof(archive_entry);
+  for (size_t i = 0; i < n; ++i) {
+    archive_entry& entry = entries[slot_of[i]];
+    entry.path_offset = strings.size();
+    entry.path_length = static_cast<uint32_t>(paths[i].size());
+    strings += paths[i];
+    std::string response_header = "Content-Length: " + std::to_string(sizes[i]) + "\n\n";
+    entry.header_offset = strings.size();
+    entry.header_length = static_cast<uint32_t>(response_header.size());
+    strings += response_header;
+    entry.body_size = sizes[i];
+  }
+  header.strings_size = strings.size();
+  uint64_t offset = page_align(header.strings_offset + strings.size());
+  for (size_t i = 0; i < n; ++i) {
+    archive_entry& entry = entries[slot_of[i]];
+    entry.body_offset = offset;
+    offset = page_align(offset + entry.body_size + 1);
+  }
+
+  // Escribir a un temporal y renombrar: un servidor nunca ve un archivo a medio escribir
+  std::string temporary = output + ".tmp";
+  SafeFD out{open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)};
+  if (!out.is_valid()) {
+    return std::unexpected(errno);
+  }
+  int result = write_at(out.get(), {reinterpret_cast<const char*>(&header), sizeof(header)}, 0);
+  if (result == 0) {
+    result = write_at(out.get(), {reinterpret_cast<const char*>(displacements.data()), displacements.size() * sizeof(uint32_t)},
+                      header.displacements_offset);
+  }
+  if (result == 0) {
+    result = write_at(out.get(), {reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(archive_entry)},
+                      header.entries_offset);
+  }
+  if (result == 0) {
+    result = write_at(out.get(), strings, header.strings_offset);
+  }
+  for (size_t i = 0; i < n && result == 0; ++i) {
+    const archive_entry& entry = entries[slot_of[i]];
+    if (entry.body_size > 0) {
+      auto file = read_all((base_dir + paths[i]).c_str());
+      if (!file) {
+        result = file.error();
+        break;
+      }
+      result = write_at(out.get(), file->get().substr(0, entry.body_size), entry.body_offset);
+    }
+    if (result == 0) {
+      result = write_at(out.get(), "\n", entry.body_offset + entry.body_size);
+    }
+  }
+  if (result == 0 && ftruncate(out.get(), static_cast<off_t>(offset)) < 0) {
+    result = errno;
+  }
+  if (result == 0 && rename(temporary.c_str(), output.c_str()) < 0) {
+    result = errno;
+  }
+  if (result != 0) {
+    unlink(temporary.c_str());
+    return std::unexpected(result);
+  }
+  return n;
+}
+
+/// @brief Abre y mapea un archivo generado con build_archive
+/// @param path Ruta del archivo
+/// @return ContentArchive o errno
+std::expected<ContentArchive, int> ContentArchive::open(const std::string& path) {
+  ContentArchive archive;
+  auto map = read_all(path.c_str());
+  if (!map) {
+    return std::unexpected(map.error());
+  }
+  archive.map_ = std::move(map.value());
+  archive.fd_ = SafeFD{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (!archive.fd_.is_valid()) {
+    return std::unexpected(errno);
+  }
+  std::string_view data = archive.map_.get();
+  if (data.size() < sizeof(archive_header)) {
+    return std::unexpected(EINVAL);
+  }
+  archive.header_ = reinterpret_cast<const archive_header*>(data.data());
+  const archive_header& header = *archive.header_;
+  if (!std::equal(std::begin(archive_magic), std::end(archive_magic), header.magic) ||
+      header.strings_offset + header.strings_size > data.size() ||
+      header.entries_offset + uint64_t{header.entry_count} * sizeof(archive_entry) > header.strings_offset ||
+      header.displacements_offset + uint64_t{header.bucket_count} * sizeof(uint32_t) > header.entries_offset ||
+      (header.entry_count > 0 && header.bucket_count == 0)) {
+    return std::unexpected(EINVAL);
+  }
+  archive.displacements_ = reinterpret_cast<const uint32_t*>(data.data() + header.displacements_offset);
+  archive.entries_ = reinterpret_cast<const archive_entry*>(data.data() + header.entries_offset);
+  archive.strings_ = data.substr(header.strings_offset, header.strings_size);
+  for (uint32_t i = 0; i < header.entry_count; ++i) {
+    const archive_entry& entry = archive.entries_[i];
+    if (entry.path_offset + entry.path_length > header.strings_size ||
+        entry.header_offset + entry.header_length > header.strings_size ||
+        entry.body_offset + entry.body_size + 1 > data.size()) {
+      return std::unexpected(EINVAL);
+    }
+  }
+  // El índice y las cabeceras se consultan en cada petición: que no provoquen fallos de página
+  madvise(const_cast<char*>(data.data()), header.strings_offset + header.strings_size, MADV_WILLNEED);
+  return archive;
+}
+
+/// @brief Busca una ruta con un único sondeo del hash perfecto
+/// @param path Ruta pedida (empieza por '/')
+/// @return Entrada o nullptr si la ruta no está en el archivo
+const archive_entry* ContentArchive::find(std::string_view path) const noexcept {
+  if (size() == 0) {
+    return nullptr;
+  }
+  uint32_t bucket = static_cast<uint32_t>(archive_hash(path, 0) % header_->bucket_count);
+  uint32_t slot = static_cast<uint32_t>(archive_hash(path, displacements_[bucket]) % header_->entry_count);
+  const archive_entry& entry = entries_[slot];
+  if (strings_.substr(entry.path_offset, entry.path_length) != path) {
+    return nullptr;
+  }
+  return &entry;
+}
+
+/// @brief Envía la respuesta de una entrada: cabecera precalculada y contenido con sendfile()
+/// @param socket Socket del cliente
+/// @param archive Archivo empaquetado
+/// @param entry Entrada encontrada con find()
+/// @return Bytes de contenido enviados o errno
+std::expected<uint64_t, int> send_archive_entry(const SafeFD& socket, const ContentArchive& archive, const archive_entry& entry) {
+  std::string_view header = archive.header(entry);
+  // MSG_MORE: la cabecera sale en el mismo segmento que el principio del contenido
+  if (send(socket.get(), header.data(), header.size(), MSG_MORE | MSG_NOSIGNAL) < 0) {
+    return std::unexpected(errno);
+  }
+  // Contenido y '\n' final, que el archivo guarda justo detrás de cada documento
+  off_t offset = static_cast<off_t>(entry.body_offset);
+  uint64_t remaining = entry.body_size + 1;
+  while (remaining > 0) {
+    ssize_t sent = sendfile(socket.get(), archive.descriptor().get(), &offset, remaining);
+    if (sent < 0) {
+      return std::unexpected(errno);
+    }
+    if (sent == 0) {
+      return std::unexpected(EIO); // El archivo se truncó después de abrirlo
+    }
+    remaining -= static_cast<uint64_t>(sent);
+  }
+  return entry.body_size;
+}
@@ -0,0 +1,109 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <cstdint>
+#include <expected>
+#include <string>
+#include <string_view>
+#include "SafeFD.h"
+#include "SafeMap.h"
+
+// Formato del archivo empaquetado (docpack):
+//
+//   archive_header
+//   uint32_t displacements[bucket_count]   (índice de hash perfecto mínimo)
+//   archive_entry entries[entry_count]     (en el orden que dicta el hash)
+//   cadenas: rutas y cabeceras precalculadas
+//   contenidos: cada uno alineado a página y seguido de '\n'
+//
+// Una ruta se busca con un único sondeo: bucket = hash(ruta, 0) % bucket_count,
+// d = displacements[bucket], entrada = hash(ruta, d) % entry_count.
+
+constexpr char archive_magic[8] = {'D', 'O', 'C', 'P', 'A', 'C', 'K', '1'};
+
+struct archive_header {
+  char magic[8];
+  uint32_t entry_count;
+  uint32_t bucket_count;
+  uint64_t displacements_offset;
+  uint64_t entries_offset;
+  uint64_t strings_offset;
+  uint64_t strings_size;
+};
+
+struct archive_entry {
+  uint64_t path_offset;    // Relativo al bloque de cadenas
+  uint64_t header_offset;  // Relativo al bloque de cadenas
+  uint32_t path_length;
+  uint32_t header_length;
+  uint64_t body_offset;    // Absoluto dentro del archivo
+  uint64_t body_size;      // Sin contar el '\n' final
+};
+
+/// @brief Hash de una ruta con semilla (FNV-1a seguido de una mezcla de bits)
+uint64_t archive_hash(std::string_view key, uint64_t seed);
+
+/// @brief Empaqueta un directorio en un archivo
+/// @param base_dir Directorio raíz (las rutas se guardan relativas a él, empezando por '/')
+/// @param output Archivo a generar
+/// @return Número de documentos empaquetados o errno
+std::expected<size_t, int> build_archive(const std::string& base_dir, const std::string& output);
+
+// Archivo empaquetado abierto y mapeado en memoria para servir desde él
+class ContentArchive
+{
+  public:
+    ContentArchive(const ContentArchive&) = delete;
+    ContentArchive& operator=(const ContentArchive&) = delete;
+    ContentArchive(ContentArchive&&) noexcept = default;
+    ContentArchive& operator=(ContentArchive&&) noexcept = default;
+
+    /// @brief Abre y mapea un archivo generado con build_archive
+    static std::expected<ContentArchive, int> open(const std::string& path);
+
+    /// @brief Busca una ruta con un único sondeo del hash perfecto
+    /// @return Entrada o nullptr si la ruta no está en el archivo
+    [[nodiscard]] const archive_entry* find(std::string_view path) const noexcept;
+
+    /// @brief Cabecera de respuesta precalculada de una entrada
+    [[nodiscard]] std::string_view header(const archive_entry& entry) const noexcept
+    {
+      return strings_.substr(entry.header_offset, entry.header_length);
+    }
+
+    /// @brief Contenido de una entrada en el archivo mapeado (sin el '\n' final)
+    [[nodiscard]] std::string_view body(const archive_entry& entry) const noexcept
+    {
+      return map_.get().substr(entry.body_offset, entry.body_size);
+    }
+
+    /// @brief Descriptor del archivo, para enviar los contenidos con sendfile()
+    [[nodiscard]] const SafeFD& descriptor() const noexcept
+    {
+      return fd_;
+    }
+
+    [[nodiscard]] uint32_t size() const noexcept
+    {
+      return header_ != nullptr ? header_->entry_count : 0;
+    }
+
+  private:
+    explicit ContentArchive() noexcept = default;
+
+    SafeFD fd_;
+    SafeMap map_;
+    const archive_header* header_ = nullptr;
+    const uint32_t* displacements_ = nullptr;
+    const archive_entry* entries_ = nullptr;
+    std::string_view strings_;
+};
+
+/// @brief Envía la respuesta de una entrada: cabecera precalculada y contenido con sendfile()
+/// @param socket Socket del cliente
+/// @param archive Archivo empaquetado
+/// @param entry Entrada encontrada con find()
+/// @return Bytes de contenido enviados o errno
+std::expected<uint64_t, int> send_archive_entry(const SafeFD& socket, const ContentArchive& archive, const archive_entry& entry);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+
+// Arena de una petición: un búfer en la pila del hilo que la atiende con un asignador
+// monótono encima. Las cadenas de la petición (búfer de recepción, rutas, entorno del CGI,
+// salida del programa) se reservan aquí y se liberan todas a la vez al terminar; malloc solo
+// interviene si la petición no cabe en el búfer.
+template <size_t Size>
+class RequestArena
+{
+  public:
+    explicit RequestArena() noexcept = default;
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    [[nodiscard]] std::pmr::memory_resource* resource() noexcept
+    {
+      return &resource_;
+    }
+
+  private:
+    alignas(std::max_align_t) std::byte buffer_[Size];
+    std::pmr::monotonic_buffer_resource resource_{buffer_, Size};
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "Async.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+Task<std::expected<SafeFD, int>> async_accept(EventLoop& loop, const SafeFD& listener, sockaddr_storage& client_addr) {
+  while (true) {
+    socklen_t length = sizeof(client_addr);
+    int fd = accept4(listener.get(), reinterpret_cast<sockaddr*>(&client_addr), &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd >= 0) {
+      co_return SafeFD{fd};
+    }
+    if (errno != EAGAIN && errno != EINTR) {
+      co_return std::unexpected(errno);
+    }
+    if (errno == EAGAIN) {
+      if (int error = co_await loop.wait(listener.get(), EPOLLIN); error != 0) {
+        co_return std::unexpected(error);
+      }
+    }
+  }
+}
+
+Task<std::expected<size_t, int>> async_recv(EventLoop& loop, const SafeFD& socket, char* buffer, size_t size) {
+  while (true) {
+    ssize_t received = recv(socket.get(), buffer, size, 0);
+    if (received >= 0) {
+      co_return static_cast<size_t>(received);
+    }
+    if (errno != EAGAIN && errno != EINTR) {
+      co_return std::unexpected(errno);
+    }
+    if (errno == EAGAIN) {
+      if (int error = co_await loop.wait(socket.get(), EPOLLIN | EPOLLRDHUP); error != 0) {
+        co_return std::unexpected(error);
+      }
+    }
+  }
+}
+
+Task<std::expected<size_t, int>> async_read(EventLoop& loop, const SafeFD& fd, char* buffer, size_t size) {
+  while (true) {
+    ssize_t bytes_read = read(fd.get(), buffer, size);
+    if (bytes_read >= 0) {
+      co_return static_cast<size_t>(bytes_read);
+    }
+    if (errno != EAGAIN && errno != EINTR) {
+      co_return std::unexpected(errno);
+    }
+    if (errno == EAGAIN) {
+      if (int error = co_await loop.wait(fd.get(), EPOLLIN); error != 0) {
+        co_return std::unexpected(error);
+      }
+    }
+  }
+}
+
+Task<std::expected<uint64_t, int>> async_send(EventLoop& loop, const SafeFD& socket, std::span<const std::string_view> parts) {
+  // Como send_parts: sendmsg con todas las partes (por tandas), saltando lo ya enviado tras un
+  // envío parcial
+  constexpr size_t max_parts = 64;
+  iovec iov[max_parts];
+  uint64_t total = 0;
+  while (!parts.empty()) {
+    size_t count = std::min(parts.size(), max_parts);
+    for (size_t i = 0; i < count; ++i) {
+      iov[i] = {const_cast<char*>(parts[i].data()), parts[i].size()};
+    }
+    parts = parts.subspan(count);
+    msghdr message{};
+    message.msg_iov = iov;
+    message.msg_iovlen = count;
+    int flags = MSG_NOSIGNAL | (parts.empty() ? 0 : MSG_MORE);
+    while (message.msg_iovlen > 0) {
+      ssize_t sent = sendmsg(socket.get(), &message, flags);
+      if (sent < 0) {
+        if (errno == EAGAIN) {
+          if (int error = co_await loop.wait(socket.get(), EPOLLOUT); error != 0) {
+            co_return std::unexpected(error);
+          }
+          continue;
+        }
+        if (errno == EINTR) {
+          continue;
+        }
+        co_return std::unexpected(errno);
+      }
+      total += static_cast<uint64_t>(sent);
+      while (message.msg_iovlen > 0 && static_cast<size_t>(sent) >= message.msg_iov->iov_len) {
+        sent -= static_cast<ssize_t>(message.msg_iov->iov_len);
+        ++message.msg_iov;
+        --message.msg_iovlen;
+      }
+      if (message.msg_iovlen > 0) {
+        message.msg_iov->iov_base = static_cast<char*>(message.msg_iov->iov_base) + sent;
+        message.msg_iov->iov_len -= static_cast<size_t>(sent);
+      }
+    }
+  }
+  co_return total;
+}
+
+Task<std::expected<uint64_t, int>> async_sendfile(EventLoop& loop, const SafeFD& socket, const SafeFD& file, off_t offset,
+                                                  uint64_t count) {
+  uint64_t total = 0;
+  while (total < count) {
+    ssize_t sent = sendfile(socket.get(), file.get(), &offset, count - total);
+    if (sent < 0) {
+      if (errno == EAGAIN) {
+        if (int error = co_await loop.wait(socket.get(), EPOLLOUT); error != 0) {
+          co_return std::unexpected(error);
+        }
+        continue;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      co_return std::unexpected(errno);
+    }
+    if (sent == 0) {
+      co_return std::unexpected(EIO); // El archivo es más corto de lo esperado
+    }
+    total += static_cast<uint64_t>(sent);
+  }
+  co_return total;
+}
+
+Task<std::expected<int, int>> async_wait_child(EventLoop& loop, const child_process& child) {
+  // El pidfd se vuelve legible cuando el hijo termina
+  while (true) {
+    siginfo_t info{};
+    if (waitid(P_PIDFD, static_cast<id_t>(child.pidfd.get()), &info, WEXITED | WNOHANG) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      co_return std::unexpected(errno);
+    }
+    if (info.si_pid != 0) {
+      // Mismo formato que el estado de waitpid(), para WIFEXITED/WEXITSTATUS
+      co_return info.si_code == CLD_EXITED ? (info.si_status & 0xff) << 8 : (info.si_status & 0x7f);
+    }
+    if (int error = co_await loop.wait(child.pidfd.get(), EPOLLIN); error != 0) {
+      co_return std::unexpected(error);
+    }
+  }
+}
@@ -0,0 +1,359 @@
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <expected>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include "SafeFD.h"
+#include "Functions.h"
+#include "WorkPool.h"
+
+// Capa de corrutinas (docserver --async): las peticiones se escriben de forma secuencial con
+// co_await y se ejecutan sin bloquear sobre un bucle epoll, sin un hilo por conexión.
+//
+// Cada operación async_* intenta primero la llamada no bloqueante; solo si devuelve EAGAIN
+// la corrutina se suspende hasta que epoll avise de que el descriptor está listo. Los
+// descriptores que se usan aquí deben ser no bloqueantes (async_accept ya los crea así).
+
+// Corrutina perezosa: empieza al esperarla con co_await (o al lanzarla con EventLoop::spawn)
+// y al terminar reanuda directamente a quien la esperaba.
+namespace detail {
+
+template <typename T>
+struct task_result {
+  std::optional<T> value;
+  void return_value(T result)
+  {
+    value.emplace(std::move(result));
+  }
+  T take()
+  {
+    return std::move(*value);
+  }
+};
+
+template <>
+struct task_result<void> {
+  void return_void() noexcept {}
+  void take() noexcept {}
+};
+
+}  // namespace detail
+
+template <typename T = void>
+class Task
+{
+  public:
+    struct promise_type : detail::task_result<T> {
+      std::coroutine_handle<> continuation = std::noop_coroutine();
+      bool detached = false;
+
+      Task get_return_object() noexcept
+      {
+        return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+      }
+      std::suspend_always initial_suspend() noexcept
+      {
+        return {};
+      }
+      auto final_suspend() noexcept
+      {
+        struct final_awaiter {
+          bool await_ready() noexcept
+          {
+            return false;
+          }
+          std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> self) noexcept
+          {
+            std::coroutine_handle<> next = self.promise().continuation;
+            if (self.promise().detached) {
+              self.destroy();
+            }
+            return next;
+          }
+          void await_resume() noexcept {}
+        };
+        return final_awaiter{};
+      }
+      void unhandled_exception() noexcept
+      {
+        std::terminate();
+      }
+    };
+
+    Task(Task&& other) noexcept : handle_{std::exchange(other.handle_, nullptr)} {}
+    Task& operator=(Task&&) = delete;
+    Task(const Task&) = delete;
+    ~Task()
+    {
+      if (handle_) {
+        handle_.destroy();
+      }
+    }
+
+    bool await_ready() const noexcept
+    {
+      return false;
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> waiting) noexcept
+    {
+      handle_.promise().continuation = waiting;
+      return handle_;
+    }
+    T await_resume()
+    {
+      return handle_.promise().take();
+    }
+
+    /// @brief Suelta la corrutina para que se destruya sola al terminar
+    std::coroutine_handle<promise_type> release() noexcept
+    {
+      handle_.promise().detached = true;
+      return std::exchange(handle_, nullptr);
+    }
+
+  private:
+    explicit Task(std::coroutine_handle<promise_type> handle) noexcept : handle_{handle} {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// Bucle de eventos de un hilo. Una corrutina que espera un descriptor lo registra en epoll
+// (EPOLLONESHOT) con su handle y lo desregistra al despertar: ningún descriptor queda
+// apuntado tras cerrarse ni puede despertar a una corrutina que ya no existe.
+// Las corrutinas que esperan una tarea de un WorkPool (offload) vuelven por otro camino: el
+// hilo de trabajo deja su handle en una lista y escribe en un eventfd que está siempre en
+// epoll, y el bucle las reanuda en su propio hilo.
+class EventLoop
+{
+  public:
+    explicit EventLoop() : epoll_fd_{epoll_create1(EPOLL_CLOEXEC)}, posted_fd_{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)}
+    {
+      if (epoll_fd_.is_valid() && posted_fd_.is_valid()) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr; // Ningún handle de corrutina es nulo
+        epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, posted_fd_.get(), &event);
+      }
+    }
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    [[nodiscard]] bool is_valid() const noexcept
+    {
+      return epoll_fd_.is_valid() && posted_fd_.is_valid();
+    }
+
+    /// @brief Espera a que un descriptor esté listo
+    /// @param fd Descriptor
+    /// @param events EPOLLIN, EPOLLOUT...
+    /// @return co_await devuelve 0 o errno si no se pudo registrar
+    auto wait(int fd, uint32_t events) noexcept
+    {
+      struct awaiter {
+        EventLoop& loop;
+        int fd;
+        uint32_t events;
+        int error = 0;
+
+        bool await_ready() const noexcept
+        {
+          return false;
+        }
+        bool await_suspend(std::coroutine_handle<> waiting) noexcept
+        {
+          epoll_event event{};
+          event.events = events | EPOLLONESHOT;
+          event.data.ptr = waiting.address();
+          if (epoll_ctl(loop.epoll_fd_.get(), EPOLL_CTL_ADD, fd, &event) < 0) {
+            error = errno;
+            return false;
+          }
+          ++loop.waiting_;
+          return true;
+        }
+        int await_resume() noexcept
+        {
+          if (error == 0) {
+            epoll_ctl(loop.epoll_fd_.get(), EPOLL_CTL_DEL, fd, nullptr);
+            --loop.waiting_;
+          }
+          return error;
+        }
+      };
+      return awaiter{*this, fd, events};
+    }
+
+    /// @brief Ejecuta work en un hilo del WorkPool y suspende la corrutina hasta que termine;
+    /// la corrutina sigue después en este bucle, no en el hilo de trabajo
+    /// @param pool
+    /// @param kind Clase de trabajo (cola y hilos que lo atienden)
+    /// @param work Función sin argumentos; sus referencias deben seguir vivas hasta el final
+    /// @return co_await devuelve lo que devuelva work
+    template <typename Work>
+    auto offload(WorkPool& pool, WorkPool::work_class kind, Work work)
+    {
+      using result_type = std::invoke_result_t<Work&>;
+      struct awaiter {
+        EventLoop& loop;
+        WorkPool& pool;
+        WorkPool::work_class kind;
+        Work work;
+        std::optional<result_type> result = {};
+
+        bool await_ready() const noexcept
+        {
+          return false;
+        }
+        void await_suspend(std::coroutine_handle<> waiting)
+        {
+          ++loop.waiting_;
+          // Tras post() la corrutina puede reanudarse y destruir este awaiter: la tarea solo
+          // usa lo capturado por valor
+          pool.submit(kind, [this, target = &loop, waiting] {
+            result.emplace(work());
+            target->post(waiting);
+          });
+        }
+        result_type await_resume()
+        {
+          --loop.waiting_;
+          return std::move(*result);
+        }
+      };
+      return awaiter{*this, pool, kind, std::move(work)};
+    }
+
+    /// @brief Pide que una corrutina se reanude en este bucle (desde cualquier hilo)
+    void post(std::coroutine_handle<> handle)
+    {
+      {
+        std::lock_guard lock{posted_mutex_};
+        posted_.push_back(handle);
+      }
+      uint64_t one = 1;
+      [[maybe_unused]] ssize_t written = write(posted_fd_.get(), &one, sizeof(one));
+    }
+
+    /// @brief Lanza una corrutina en este bucle; se ejecuta hasta su primera espera. Tras stop(),
+    /// run() no vuelve hasta que terminen todas las lanzadas así.
+    void spawn(Task<void> task)
+    {
+      ++tasks_;
+      track(std::move(task)).release().resume();
+    }
+
+    /// @brief Lanza una corrutina de servicio (aceptar, esperar la parada...) que no retiene el
+    /// bucle: si sigue esperando cuando run() vuelve, se abandona
+    void spawn_service(Task<void> task)
+    {
+      task.release().resume();
+    }
+
+    /// @brief Atiende eventos hasta que se haya llamado a stop() y no queden corrutinas lanzadas
+    void run()
+    {
+      epoll_event events[64];
+      while (!stopped_ || tasks_ > 0) {
+        int ready = epoll_wait(epoll_fd_.get(), events, 64, -1);
+        if (ready < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return;
+        }
+        for (int i = 0; i < ready; ++i) {
+          if (events[i].data.ptr == nullptr) {
+            resume_posted();
+          } else {
+            std::coroutine_handle<>::from_address(events[i].data.ptr).resume();
+          }
+        }
+      }
+    }
+
+    /// @brief Pide a run() que vuelva en cuanto terminen las corrutinas lanzadas (desde el propio bucle)
+    void stop() noexcept
+    {
+      stopped_ = true;
+    }
+
+    [[nodiscard]] bool stopping() const noexcept
+    {
+      return stopped_;
+    }
+
+    /// @brief Corrutinas suspendidas en este bucle
+    [[nodiscard]] size_t waiting() const noexcept
+    {
+      return waiting_;
+    }
+
+  private:
+    Task<void> track(Task<void> task)
+    {
+      co_await task;
+      --tasks_;
+    }
+
+    /// @brief Reanuda las corrutinas cuyas tareas del WorkPool han terminado
+    void resume_posted()
+    {
+      uint64_t count;
+      [[maybe_unused]] ssize_t bytes_read = read(posted_fd_.get(), &count, sizeof(count));
+      {
+        std::lock_guard lock{posted_mutex_};
+        resuming_.swap(posted_);
+      }
+      for (std::coroutine_handle<> handle : resuming_) {
+        handle.resume();
+      }
+      resuming_.clear();
+    }
+
+    SafeFD epoll_fd_;
+    SafeFD posted_fd_;                            // eventfd: hay corrutinas en posted_
+    std::mutex posted_mutex_;
+    std::vector<std::coroutine_handle<>> posted_;
+    std::vector<std::coroutine_handle<>> resuming_;
+    size_t waiting_ = 0;
+    size_t tasks_ = 0;
+    bool stopped_ = false;
+};
+
+/// @brief Acepta una conexión (el socket devuelto es no bloqueante)
+Task<std::expected<SafeFD, int>> async_accept(EventLoop& loop, const SafeFD& listener, sockaddr_storage& client_addr);
+
+/// @brief Recibe lo que haya disponible (0 si el otro extremo cerró)
+Task<std::expected<size_t, int>> async_recv(EventLoop& loop, const SafeFD& socket, char* buffer, size_t size);
+
+/// @brief Lee lo que haya disponible de una tubería o archivo no bloqueante (0 al final)
+Task<std::expected<size_t, int>> async_read(EventLoop& loop, const SafeFD& fd, char* buffer, size_t size);
+
+/// @brief Envía todas las partes seguidas, con sendmsg y sin concatenarlas
+/// @return Bytes enviados o errno
+Task<std::expected<uint64_t, int>> async_send(EventLoop& loop, const SafeFD& socket, std::span<const std::string_view> parts);
+
+/// @brief Envía count bytes de un archivo desde offset con sendfile()
+/// @return Bytes enviados o errno
+Task<std::expected<uint64_t, int>> async_sendfile(EventLoop& loop, const SafeFD& socket, const SafeFD& file, off_t offset,
+                                                  uint64_t count);
+
+/// @brief Espera a que termine un hijo y lo recoge
+/// @return Estado de waitpid() o errno
+Task<std::expected<int, int>> async_wait_child(EventLoop& loop, const child_process& child);
+
+#endif
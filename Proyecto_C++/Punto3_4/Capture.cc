@@ -0,0 +1,145 @@
+#include "Capture.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t clock_ns(clockid_t clock) noexcept {
+  timespec now;
+  clock_gettime(clock, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000 + static_cast<uint64_t>(now.tv_nsec);
+}
+
+/// @brief Escribe un bloque completo
+/// @return 0 o errno
+static int write_all(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno;
+    }
+    data += written;
+    size -= static_cast<size_t>(written);
+  }
+  return 0;
+}
+
+std::expected<capture_contents, int> parse_capture(std::string_view data) {
+  capture_header header;
+  if (data.size() < sizeof(header)) {
+    return std::unexpected(EINVAL);
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (std::memcmp(header.magic, capture_magic, sizeof(capture_magic)) != 0) {
+    return std::unexpected(EINVAL);
+  }
+  capture_contents contents{header.start_realtime_ns, {}};
+  size_t offset = sizeof(header);
+  while (data.size() - offset >= sizeof(capture_record)) {
+    captured_request entry;
+    std::memcpy(&entry.record, data.data() + offset, sizeof(capture_record));
+    offset += sizeof(capture_record);
+    if (data.size() - offset < entry.record.request_size) {
+      break; // Registro cortado: el servidor terminó a mitad de la escritura
+    }
+    entry.request = data.substr(offset, entry.record.request_size);
+    offset += entry.record.request_size;
+    contents.requests.push_back(entry);
+  }
+  std::stable_sort(contents.requests.begin(), contents.requests.end(),
+                   [](const captured_request& a, const captured_request& b) { return a.record.arrival_ns < b.record.arrival_ns; });
+  return contents;
+}
+
+CaptureWriter::CaptureWriter(const std::string& path)
+    : fd_{open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)}, start_ns_{clock_ns(CLOCK_MONOTONIC)}
+{
+  if (!fd_.is_valid()) {
+    return;
+  }
+  capture_header header{};
+  std::memcpy(header.magic, capture_magic, sizeof(capture_magic));
+  header.start_realtime_ns = clock_ns(CLOCK_REALTIME);
+  if (write_all(fd_.get(), reinterpret_cast<const char*>(&header), sizeof(header)) != 0) {
+    fd_ = SafeFD{};
+    return;
+  }
+  pending_.reserve(buffer_capacity);
+  writing_.reserve(buffer_capacity);
+  thread_ = std::thread{&CaptureWriter::run, this};
+}
+
+CaptureWriter::~CaptureWriter() {
+  close();
+}
+
+void CaptureWriter::record(uint64_t arrival_ns, std::string_view request, bool truncated, const sockaddr_storage& client,
+                           uint16_t status, uint64_t response_bytes) noexcept {
+  capture_record entry{};
+  entry.arrival_ns = arrival_ns > start_ns_ ? arrival_ns - start_ns_ : 0;
+  entry.response_bytes = response_bytes;
+  if (client.ss_family == AF_INET) {
+    const auto& address = reinterpret_cast<const sockaddr_in&>(client);
+    entry.client_addr = address.sin_addr.s_addr;
+    entry.client_port = address.sin_port;
+  }
+  entry.status = status;
+  entry.request_size = static_cast<uint32_t>(request.size());
+  entry.flags = truncated ? capture_truncated : 0;
+  size_t size = sizeof(entry) + request.size();
+
+  bool wake_writer = false;
+  {
+    std::lock_guard lock{mutex_};
+    // El búfer nunca crece: lo que no cabe se descarta
+    if (stop_ || pending_.size() + size > pending_.capacity()) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    const char* bytes = reinterpret_cast<const char*>(&entry);
+    pending_.insert(pending_.end(), bytes, bytes + sizeof(entry));
+    pending_.insert(pending_.end(), request.begin(), request.end());
+    wake_writer = pending_.size() >= buffer_capacity / 2;
+  }
+  recorded_.fetch_add(1, std::memory_order_relaxed);
+  if (wake_writer) {
+    wake_.notify_one();
+  }
+}
+
+int CaptureWriter::close() {
+  {
+    std::lock_guard lock{mutex_};
+    stop_ = true;
+  }
+  wake_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  return error_;
+}
+
+void CaptureWriter::run() {
+  std::unique_lock lock{mutex_};
+  while (true) {
+    // Volcado periódico aunque haya poco tráfico: lo capturado llega pronto al disco
+    wake_.wait_for(lock, std::chrono::milliseconds(100),
+                   [this] { return stop_ || pending_.size() >= buffer_capacity / 2; });
+    bool stopping = stop_;
+    pending_.swap(writing_);
+    lock.unlock();
+    if (!writing_.empty() && error_ == 0) {
+      error_ = write_all(fd_.get(), writing_.data(), writing_.size());
+    }
+    writing_.clear();
+    if (stopping) {
+      return;
+    }
+    lock.lock();
+  }
+}
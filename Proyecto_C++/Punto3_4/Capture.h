@@ -0,0 +1,126 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <expected>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "SafeFD.h"
+
+// Formato de una captura de tráfico (docserver --capture, docreplay):
+//
+//   capture_header
+//   por cada petición: capture_record seguido de request_size bytes de la petición
+//
+// Los registros se escriben en orden de finalización, no de llegada: quien reproduzca la
+// captura debe ordenarlos por arrival_ns. Si el servidor muere a mitad de una escritura, el
+// último registro puede quedar cortado y se descarta al leer.
+//
+// Solo se guarda lo que receive_request devolvió (cabeceras y, si llegó con ellas, el cuerpo). Si
+// parte del cuerpo se envió después directamente al programa, el registro lleva
+// capture_truncated: reenviarlo tal cual dejaría al servidor esperando el resto del cuerpo.
+
+constexpr char capture_magic[8] = {'D', 'O', 'C', 'C', 'A', 'P', 'T', '1'};
+
+// Bits de capture_record::flags
+constexpr uint32_t capture_truncated = 1;  // La petición guardada no incluye todo su cuerpo
+
+struct capture_header {
+  char magic[8];
+  uint64_t start_realtime_ns;  // Hora (CLOCK_REALTIME) del inicio de la captura
+};
+
+struct capture_record {
+  uint64_t arrival_ns;         // Desde el inicio de la captura
+  uint64_t response_bytes;     // Bytes enviados al cliente
+  uint32_t client_addr;        // IPv4 en orden de red (0 si llegó por un socket Unix)
+  uint16_t client_port;        // En orden de red (0 si llegó por un socket Unix)
+  uint16_t status;             // Código de la respuesta (0: ninguna)
+  uint32_t request_size;       // Bytes de la petición que siguen al registro
+  uint32_t flags;              // capture_truncated o 0 (también alinea el registro a 8 bytes)
+};
+
+// Petición leída de una captura; request apunta dentro de los datos de la captura
+struct captured_request {
+  capture_record record;
+  std::string_view request;
+};
+
+struct capture_contents {
+  uint64_t start_realtime_ns;
+  std::vector<captured_request> requests;  // Ordenadas por llegada
+};
+
+/// @brief Interpreta una captura completa ya leída en memoria
+/// @param data Contenido del archivo, que debe sobrevivir al resultado
+/// @return Peticiones ordenadas por llegada o EINVAL si no es una captura
+std::expected<capture_contents, int> parse_capture(std::string_view data);
+
+// Escritor de capturas: las conexiones copian su registro en un búfer reservado al arrancar
+// (sin llamadas al sistema ni memoria nueva en la petición) y un hilo propio lo vuelca al
+// archivo en bloques. Si el disco no da abasto y el búfer se llena, el registro se descarta
+// y se cuenta en dropped() antes que frenar al servidor.
+class CaptureWriter
+{
+  public:
+    static constexpr size_t buffer_capacity = 1 << 20;
+
+    /// @brief Crea (o trunca) el archivo de captura y arranca el hilo escritor
+    explicit CaptureWriter(const std::string& path);
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+    ~CaptureWriter();
+
+    [[nodiscard]] bool is_valid() const noexcept
+    {
+      return fd_.is_valid();
+    }
+
+    /// @brief Apunta una petición atendida
+    /// @param arrival_ns Llegada de la petición (CLOCK_MONOTONIC, como trace_now())
+    /// @param request Bytes recibidos tal y como los devolvió receive_request
+    /// @param truncated Parte del cuerpo no está en request (se leyó después)
+    /// @param client Dirección del cliente (de accept())
+    /// @param status Código de la respuesta (0 si no se respondió)
+    /// @param response_bytes Bytes enviados al cliente
+    void record(uint64_t arrival_ns, std::string_view request, bool truncated, const sockaddr_storage& client,
+                uint16_t status, uint64_t response_bytes) noexcept;
+
+    /// @brief Vuelca lo pendiente y detiene el hilo escritor
+    /// @return 0 o errno del primer error de escritura
+    int close();
+
+    [[nodiscard]] uint64_t recorded() const noexcept
+    {
+      return recorded_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t dropped() const noexcept
+    {
+      return dropped_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    void run();
+
+    SafeFD fd_;
+    uint64_t start_ns_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<char> pending_;  // Lo rellenan las conexiones
+    std::vector<char> writing_;  // Lo vuelca el hilo escritor
+    bool stop_ = false;
+    int error_ = 0;
+    std::atomic<uint64_t> recorded_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "ContentCache.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include <sys/mman.h>
+
+/// @brief Clase de tamaño de un documento: 0 para 64 bytes, 1 para 128...
+static size_t size_class(size_t size) {
+  return static_cast<size_t>(std::bit_width(std::max(size, ContentCache::min_slot) - 1)) -
+         static_cast<size_t>(std::bit_width(ContentCache::min_slot - 1));
+}
+
+ContentCache::ContentCache(size_t capacity, size_t max_file)
+    : max_file_{std::min(max_file, slab_size)}
+{
+  capacity = (std::max(capacity, slab_size) + slab_size - 1) / slab_size * slab_size;
+  classes_.resize(size_class(max_file_) + 1);
+
+  // Páginas enormes reservadas por el administrador (vm.nr_hugepages). Sin MAP_NORESERVE: si no
+  // hay bastantes, mmap falla ahora en lugar de dar SIGBUS al escribir
+  void* region = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (region != MAP_FAILED) {
+    base_ = static_cast<char*>(region);
+    capacity_ = capacity;
+    backing_ = backing::hugetlb;
+    return;
+  }
+
+  // Si no, páginas normales alineadas a 2 MiB para que el kernel pueda juntarlas en enormes
+  region = mmap(nullptr, capacity + slab_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (region == MAP_FAILED) {
+    return;
+  }
+  char* start = static_cast<char*>(region);
+  char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(start) + slab_size - 1) & ~(slab_size - 1));
+  if (aligned != start) {
+    munmap(start, static_cast<size_t>(aligned - start));
+  }
+  size_t tail = slab_size - static_cast<size_t>(aligned - start);
+  if (tail != 0) {
+    munmap(aligned + capacity, tail);
+  }
+  base_ = aligned;
+  capacity_ = capacity;
+  backing_ = madvise(base_, capacity_, MADV_HUGEPAGE) == 0 ? backing::transparent : backing::none;
+}
+
+ContentCache::~ContentCache() {
+  index_.clear(); // Las referencias del índice devuelven sus huecos antes de desmapear la región
+  if (base_ != nullptr) {
+    munmap(base_, capacity_);
+  }
+}
+
+std::optional<ContentCache::document> ContentCache::find(std::string_view path, const struct stat& status) const {
+  std::shared_lock lock{mutex_};
+  auto found = index_.find(path);
+  if (found == index_.end()) {
+    return std::nullopt;
+  }
+  const cached_file& file = found->second;
+  if (file.device != status.st_dev || file.inode != status.st_ino ||
+      file.content.size() != static_cast<size_t>(status.st_size) ||
+      file.changed.tv_sec != status.st_ctim.tv_sec || file.changed.tv_nsec != status.st_ctim.tv_nsec) {
+    return std::nullopt;
+  }
+  return document{file.content, file.lease};
+}
+
+std::optional<ContentCache::document> ContentCache::insert(std::string_view path, const struct stat& status,
+                                                           std::string_view content) {
+  if (content.size() > max_file_) {
+    return std::nullopt;
+  }
+  char* slot;
+  {
+    std::lock_guard lock{mutex_};
+    slot = allocate(content.size());
+  }
+  if (slot == nullptr) {
+    return std::nullopt;
+  }
+  // La copia se hace sin el cerrojo: el hueco aún no es visible para nadie
+  std::memcpy(slot, content.data(), content.size());
+  auto lease = std::make_shared<const slot_lease>(*this, slot, size_class(content.size()));
+  document inserted{{slot, content.size()}, lease};
+
+  // La versión anterior se suelta después del cerrojo: si era su última referencia, devolver
+  // el hueco vuelve a tomarlo
+  std::shared_ptr<const slot_lease> previous;
+  std::lock_guard lock{mutex_};
+  cached_file file{inserted.content, status.st_dev, status.st_ino, status.st_ctim, std::move(lease)};
+  auto found = index_.find(path);
+  if (found != index_.end()) {
+    previous = std::exchange(found->second.lease, nullptr);
+    found->second = std::move(file);
+  } else {
+    index_.emplace(std::string{path}, std::move(file));
+  }
+  return inserted;
+}
+
+size_t ContentCache::entries() const {
+  std::shared_lock lock{mutex_};
+  return index_.size();
+}
+
+size_t ContentCache::used() const {
+  std::shared_lock lock{mutex_};
+  return next_slab_;
+}
+
+/// @brief Reserva un hueco de la clase del tamaño pedido (con el cerrojo tomado)
+/// @return Hueco o nullptr si la región está llena
+char* ContentCache::allocate(size_t size) {
+  size_t index = size_class(size);
+  size_t slot_size = min_slot << index;
+  slab_cursor& cursor = classes_[index];
+  if (cursor.free != nullptr) {
+    char* slot = cursor.free;
+    std::memcpy(&cursor.free, slot, sizeof(char*));
+    return slot;
+  }
+  if (cursor.next == cursor.end) {
+    if (next_slab_ + slab_size > capacity_) {
+      return nullptr;
+    }
+    cursor.next = base_ + next_slab_;
+    cursor.end = cursor.next + slab_size / slot_size * slot_size;
+    next_slab_ += slab_size;
+  }
+  char* slot = cursor.next;
+  cursor.next += slot_size;
+  return slot;
+}
+
+/// @brief Devuelve un hueco sin referencias a la lista libre de su clase
+/// @param slot Hueco
+/// @param index Su clase de tamaño
+void ContentCache::release(char* slot, size_t index) {
+  std::lock_guard lock{mutex_};
+  slab_cursor& cursor = classes_[index];
+  std::memcpy(slot, &cursor.free, sizeof(char*));
+  cursor.free = slot;
+}
@@ -0,0 +1,128 @@
+#ifndef CONTENT_CACHE_H
+#define CONTENT_CACHE_H
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/stat.h>
+#include "PathHash.h"
+
+// Caché de contenidos (docserver --cache): los archivos pequeños que se piden se copian en una
+// única región contigua respaldada por páginas enormes (MAP_HUGETLB o, si el sistema no tiene
+// reservadas, páginas enormes transparentes con MADV_HUGEPAGE). Miles de documentos caben así
+// en unas pocas entradas de la TLB, en lugar de un mapeo (y una entrada) por archivo.
+//
+// La región se reparte en bloques de 2 MiB y cada bloque guarda huecos de una sola clase de
+// tamaño (potencias de dos desde 64 bytes hasta el tamaño máximo de archivo): los documentos
+// de tamaño parecido quedan juntos y no hay fragmentación dentro de un bloque.
+//
+// Cada hueco tiene un contador de referencias: lo retienen el índice y cada petición que lo
+// está enviando. Si un archivo cambia se copia en un hueco nuevo y el anterior vuelve a la
+// lista libre de su clase en cuanto lo suelta el último envío que lo usaba; cuando la región
+// se llena y no quedan huecos libres se dejan de cachear documentos nuevos.
+class ContentCache
+{
+  public:
+    static constexpr size_t slab_size = size_t{2} << 20;
+    static constexpr size_t min_slot = 64;
+
+    enum class backing { none, hugetlb, transparent };
+
+  private:
+    struct slot_lease;
+
+  public:
+    // Documento de la caché: su hueco no se reutiliza mientras quede alguna copia de lease
+    struct document {
+      std::string_view content;
+      std::shared_ptr<const slot_lease> lease;
+    };
+
+    /// @brief Reserva la región (las páginas se ocupan al copiar los documentos)
+    /// @param capacity Tamaño de la región en bytes (se redondea a bloques de 2 MiB)
+    /// @param max_file Tamaño máximo de un documento cacheado (como mucho un bloque)
+    explicit ContentCache(size_t capacity, size_t max_file);
+    ContentCache(const ContentCache&) = delete;
+    ContentCache& operator=(const ContentCache&) = delete;
+    ~ContentCache();
+
+    [[nodiscard]] bool is_valid() const noexcept
+    {
+      return base_ != nullptr;
+    }
+
+    /// @brief Cómo está respaldada la región
+    [[nodiscard]] backing pages() const noexcept
+    {
+      return backing_;
+    }
+
+    [[nodiscard]] size_t max_file() const noexcept
+    {
+      return max_file_;
+    }
+
+    /// @brief Busca un documento y comprueba que no ha cambiado en disco
+    /// @param path Ruta del documento
+    /// @param status stat() actual del documento
+    /// @return Contenido o nada si no está o está obsoleto
+    [[nodiscard]] std::optional<document> find(std::string_view path, const struct stat& status) const;
+
+    /// @brief Copia un documento en la región
+    /// @param path Ruta del documento
+    /// @param status stat() del documento al leerlo
+    /// @param content Contenido leído
+    /// @return Contenido ya en la región o nada si no cabe
+    std::optional<document> insert(std::string_view path, const struct stat& status, std::string_view content);
+
+    [[nodiscard]] size_t entries() const;
+
+    /// @brief Bytes de la región ya repartidos en bloques
+    [[nodiscard]] size_t used() const;
+
+  private:
+    // Referencia a un hueco: el último en soltarla lo devuelve a la lista libre de su clase
+    struct slot_lease {
+      ContentCache& cache;
+      char* slot;
+      size_t size_class;
+      ~slot_lease()
+      {
+        cache.release(slot, size_class);
+      }
+    };
+
+    struct cached_file {
+      std::string_view content;
+      dev_t device;
+      ino_t inode;
+      timespec changed;   // ctime: cambia al escribir y también con chmod
+      std::shared_ptr<const slot_lease> lease;
+    };
+
+    // Bloque en curso de una clase de tamaño y huecos ya liberados de esa clase (cada hueco
+    // libre guarda al principio la dirección del siguiente)
+    struct slab_cursor {
+      char* next = nullptr;
+      char* end = nullptr;
+      char* free = nullptr;
+    };
+
+    char* allocate(size_t size);
+    void release(char* slot, size_t index);
+
+    char* base_ = nullptr;
+    size_t capacity_ = 0;
+    size_t max_file_;
+    backing backing_ = backing::none;
+    mutable std::shared_mutex mutex_;
+    size_t next_slab_ = 0;
+    std::vector<slab_cursor> classes_;
+    path_map<cached_file> index_;
+};
+
+#endif
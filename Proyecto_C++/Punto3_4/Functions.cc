@@ -1,4 +1,48 @@
 #include "Functions.h"
+#include <charconv>
+#include <climits>
+#include <cstddef>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <csignal>
+#include <algorithm>
+#include <cctype>
+
+/// @brief Interpreta una lista de CPU al estilo de taskset ("0-3,8,10-11")
+/// @param list
+/// @return CPU en el orden indicado o vacío si la lista no es válida
+static std::vector<int> parse_cpu_list(std::string_view list) {
+    std::vector<int> cpus;
+    while (!list.empty()) {
+        std::string_view item = list.substr(0, list.find(','));
+        list.remove_prefix(std::min(list.size(), item.size() + 1));
+        int first = -1;
+        int last = -1;
+        auto [first_end, first_error] = std::from_chars(item.data(), item.data() + item.size(), first);
+        if (first_error != std::errc{} || first < 0) {
+            return {};
+        }
+        last = first;
+        if (first_end != item.data() + item.size()) {
+            if (*first_end != '-') {
+                return {};
+            }
+            auto [last_end, last_error] = std::from_chars(first_end + 1, item.data() + item.size(), last);
+            if (last_error != std::errc{} || last_end != item.data() + item.size() || last < first) {
+                return {};
+            }
+        }
+        if (last >= CPU_SETSIZE) {
+            return {};
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
 
 /// @brief Pasa los argumentos de la línea de comandos
 /// @param argc 
@@ -34,6 +78,123 @@ std::expected<program_options, parse_args_errors> parse_args(int argc, char* arg
             // Almacenar la ruta en options
             options.ruta_base = std::string(it->data());
             options.base = true;
+        } else if (*it == "--backlog" || *it == "--max-conn" || *it == "--max-cgi" || *it == "--max-static" || *it == "--retry-after" ||
+                   *it == "--read-timeout" || *it == "--send-timeout" || *it == "--cgi-timeout" || *it == "--drain-timeout" ||
+                   *it == "--workers" || *it == "--cache" || *it == "--cache-max-file" || *it == "--processes" ||
+                   *it == "--shared-cache" || *it == "--rate-static" || *it == "--rate-cgi" || *it == "--rate-burst" ||
+                   *it == "--max-body" || *it == "--hot-set-interval" || *it == "--file-threads" ||
+                   *it == "--process-threads" || *it == "--defer-accept" || *it == "--fastopen" || *it == "--sndbuf" ||
+                   *it == "--rcvbuf") {
+            std::string_view option = *it;
+            // Verificar que hay un valor después de la opción
+            if (++it == end || it->starts_with("-")) {
+                return std::unexpected(parse_args_errors::missing_argument); // Error si no hay valor
+            }
+            int value = std::atoi(it->data());
+            if (value <= 0) {
+                return std::unexpected(parse_args_errors::invalid_value); // Los límites deben ser positivos
+            }
+            if (option == "--backlog") {
+                options.backlog = value;
+            } else if (option == "--max-conn") {
+                options.max_connections = static_cast<size_t>(value);
+            } else if (option == "--max-cgi") {
+                options.max_cgi = static_cast<size_t>(value);
+            } else if (option == "--max-static") {
+                options.max_static = static_cast<size_t>(value);
+            } else if (option == "--read-timeout") {
+                options.read_timeout_ms = static_cast<uint64_t>(value);
+            } else if (option == "--send-timeout") {
+                options.send_timeout_ms = static_cast<uint64_t>(value);
+            } else if (option == "--cgi-timeout") {
+                options.cgi_timeout_ms = static_cast<uint64_t>(value);
+            } else if (option == "--drain-timeout") {
+                options.drain_timeout_ms = static_cast<uint64_t>(value);
+            } else if (option == "--workers") {
+                options.workers = static_cast<size_t>(value);
+            } else if (option == "--cache") {
+                options.cache_mb = static_cast<size_t>(value);
+            } else if (option == "--cache-max-file") {
+                options.cache_max_file_kb = static_cast<size_t>(value);
+            } else if (option == "--processes") {
+                options.processes = static_cast<size_t>(value);
+            } else if (option == "--shared-cache") {
+                options.shared_cache_mb = static_cast<size_t>(value);
+            } else if (option == "--rate-static") {
+                options.rate_static = static_cast<uint32_t>(value);
+            } else if (option == "--rate-cgi") {
+                options.rate_cgi = static_cast<uint32_t>(value);
+            } else if (option == "--rate-burst") {
+                options.rate_burst = static_cast<uint32_t>(value);
+            } else if (option == "--max-body") {
+                options.max_body_kb = static_cast<uint32_t>(value);
+            } else if (option == "--hot-set-interval") {
+                options.hot_set_interval_s = static_cast<uint64_t>(value);
+            } else if (option == "--file-threads") {
+                options.file_threads = static_cast<size_t>(value);
+            } else if (option == "--process-threads") {
+                options.process_threads = static_cast<size_t>(value);
+            } else if (option == "--defer-accept") {
+                options.sockets.defer_accept_s = value;
+            } else if (option == "--fastopen") {
+                options.sockets.fastopen_queue = value;
+            } else if (option == "--sndbuf") {
+                options.sockets.send_buffer_kb = value;
+            } else if (option == "--rcvbuf") {
+                options.sockets.receive_buffer_kb = value;
+            } else {
+                options.retry_after = value;
+            }
+        } else if (*it == "--archive" || *it == "--routes") {
+            std::string_view option = *it;
+            // Verificar que hay una ruta después de la opción
+            if (++it == end || it->starts_with("-")) {
+                return std::unexpected(parse_args_errors::missing_argument); // Error si no hay valor
+            }
+            if (access(it->data(), R_OK) == -1) {
+                return std::unexpected(parse_args_errors::invalid_route); // Error si no existe
+            }
+            (option == "--routes" ? options.routes_path : options.archive_path) = std::string(*it);
+        } else if (*it == "--trace" || *it == "--capture" || *it == "--hot-set") {
+            std::string_view option = *it;
+            // Verificar que hay una ruta después de la opción (el archivo se crea después)
+            if (++it == end || it->starts_with("-")) {
+                return std::unexpected(parse_args_errors::missing_argument); // Error si no hay valor
+            }
+            (option == "--capture" ? options.capture_path
+             : option == "--hot-set" ? options.hot_set_path
+                                     : options.trace_path) = std::string(*it);
+        } else if (*it == "--cpus") {
+            // Verificar que hay una lista después de --cpus
+            if (++it == end || it->starts_with("-")) {
+                return std::unexpected(parse_args_errors::missing_argument); // Error si no hay valor
+            }
+            options.cpus = parse_cpu_list(*it);
+            if (options.cpus.empty()) {
+                return std::unexpected(parse_args_errors::invalid_value);
+            }
+        } else if (*it == "--incoming-cpu") {
+            options.incoming_cpu = true;
+        } else if (*it == "--async") {
+            options.async = true;
+        } else if (*it == "--listings") {
+            options.listings = true;
+        } else if (*it == "--nodelay") {
+            options.sockets.nodelay = true;
+        } else if (*it == "--cork") {
+            options.sockets.cork = true;
+        } else if (*it == "--upgrade-socket" || *it == "--inherit" || *it == "--unix") {
+            std::string_view option = *it;
+            // Verificar que hay una ruta después de la opción
+            if (++it == end || it->starts_with("-")) {
+                return std::unexpected(parse_args_errors::missing_argument); // Error si no hay valor
+            }
+            if (it->size() >= sizeof(sockaddr_un::sun_path)) {
+                return std::unexpected(parse_args_errors::invalid_route); // No cabe en sockaddr_un
+            }
+            (option == "--inherit" ? options.inherit_socket
+             : option == "--unix"  ? options.unix_path
+                                   : options.upgrade_socket) = std::string(*it);
         } else {
             return std::unexpected(parse_args_errors::unknown_option);
         }
@@ -45,9 +206,9 @@ std::expected<program_options, parse_args_errors> parse_args(int argc, char* arg
 /// @brief Lee el contenido de un archivo
 /// @param path
 /// @return std::string
-std::expected<SafeMap, int> read_all(const std::string& path) {
+std::expected<SafeMap, int> read_all(const char* path) {
   int fd; // File descriptor
-  SafeFD safe_fd{fd = open(path.c_str(), O_RDONLY)}; // Safe file descriptor
+  SafeFD safe_fd{fd = open(path, O_RDONLY | O_CLOEXEC)}; // Safe file descriptor
 
   // Comprobar si se ha abierto correctamente el archivo
   if (!safe_fd.is_valid()) { 
@@ -58,17 +219,27 @@ std::expected<SafeMap, int> read_all(const std::string& path) {
   // Una forma es usar fstat() y otra es usar lseek().
   // La función lseek() sirve para mover el puntero de lectura/escritura de un archivo y retorna la posición
   // a la que se ha movido. Por tanto, si se mueve al final del archivo, se obtiene el tamaño de este.
-  int length = lseek(fd, 0, SEEK_END);
+  // off_t (64 bits) para no desbordar con archivos de más de 2 GB
+  // Un directorio se abre sin error pero no se puede mapear: se distingue (EISDIR) para que
+  // quien llama pueda listarlo
+  auto failure = [fd] {
+    int error = errno;
+    struct stat status;
+    return std::unexpected(fstat(fd, &status) == 0 && S_ISDIR(status.st_mode) ? EISDIR : error);
+  };
+  off_t length = lseek(fd, 0, SEEK_END);
+  if (length < 0) {
+    return failure();
+  }
 
   // Se mapea el archivo completo en memoria para solo lectura y de forma privada
   void* mem = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
   // Comprobar si se ha mapeado correctamente el archivo
   if (mem == MAP_FAILED) {
-    return std::unexpected(errno);
+    return failure();
   }
 
-  // Opcionalmente, se puede cerrar el archivo después de mapearlo
-  close(safe_fd.get());
+  // El mapeo sigue siendo válido tras cerrar el archivo, que cierra safe_fd al salir
 
   // Copiar los datos mapeados en un std::string_view
   std::string_view sv{static_cast<char*>(mem), static_cast<size_t>(length)};
@@ -79,12 +250,26 @@ std::expected<SafeMap, int> read_all(const std::string& path) {
 
 /// @brief Crea un socket
 /// @param port
+/// @param backlog Tamaño de la cola de conexiones pendientes
+/// @param incoming_cpu CPU cuyas conexiones recibe este socket (SO_REUSEPORT + SO_INCOMING_CPU), o -1
 /// @return SafeFD
-std::expected<SafeFD, int> make_socket(uint16_t port) {
-  int sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+std::expected<SafeFD, int> make_socket(uint16_t port, int backlog, int incoming_cpu) {
+  // CLOEXEC: los programas CGI no deben heredar el socket de escucha
+  int sock_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
   if (sock_fd < 0) {
     return std::unexpected(errno);
   }
+  // Un socket por CPU en el mismo puerto: el kernel entrega cada conexión al socket cuya CPU
+  // es la que atendió la cola de la tarjeta de red por la que llegó
+  if (incoming_cpu >= 0) {
+    int one = 1;
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0 ||
+        setsockopt(sock_fd, SOL_SOCKET, SO_INCOMING_CPU, &incoming_cpu, sizeof(incoming_cpu)) < 0) {
+      int error = errno;
+      close(sock_fd);
+      return std::unexpected(error);
+    }
+  }
   // BIND
   sockaddr_in local_address{};
   local_address.sin_family = AF_INET;
@@ -92,10 +277,12 @@ std::expected<SafeFD, int> make_socket(uint16_t port) {
   local_address.sin_port = htons(port);
   int result = bind(sock_fd, reinterpret_cast<sockaddr*>(&local_address), sizeof(local_address));
   if (result < 0) {
-    return std::unexpected(errno);
+    int error = errno;
+    close(sock_fd);
+    return std::unexpected(error);
   }
 
-  result = listen(sock_fd, 5);
+  result = listen(sock_fd, backlog);
   if (result < 0) {
     close(sock_fd);
     return std::unexpected(errno);
@@ -105,9 +292,10 @@ std::expected<SafeFD, int> make_socket(uint16_t port) {
 
 /// @brief Escucha conexiones
 /// @param socket
+/// @param backlog Tamaño de la cola de conexiones pendientes
 /// @return int
-int listen_connection(const SafeFD& socket) {
-  int result = listen(socket.get(), 5);
+int listen_connection(const SafeFD& socket, int backlog) {
+  int result = listen(socket.get(), backlog);
   if (result < 0) {
     return errno;
   }
@@ -117,10 +305,13 @@ int listen_connection(const SafeFD& socket) {
 /// @brief Acepta una conexión
 /// @param socket
 /// @param client_addr
+/// @param flags SOCK_CLOEXEC y/o SOCK_NONBLOCK para el socket aceptado, sin llamadas a fcntl()
 /// @return SafeFD
-std::expected<SafeFD, int> accept_connection(const SafeFD& socket, sockaddr_in& client_addr) {
+std::expected<SafeFD, int> accept_connection(const SafeFD& socket, sockaddr_storage& client_addr, int flags) {
   socklen_t client_addr_length = sizeof(client_addr);
-  int new_fd = accept(socket.get(), reinterpret_cast<sockaddr*>(&client_addr), &client_addr_length);
+  // Con CLOEXEC (por defecto) un CGI lanzado desde otro hilo no se queda con el socket de esta
+  // conexión abierto en el hijo, lo que retrasaría su cierre hasta que el programa terminase
+  int new_fd = accept4(socket.get(), reinterpret_cast<sockaddr*>(&client_addr), &client_addr_length, flags);
   if (new_fd < 0) {
     return std::unexpected(errno);
   }
@@ -133,10 +324,56 @@ std::expected<SafeFD, int> accept_connection(const SafeFD& socket, sockaddr_in&
 /// @param body
 /// @return int
 int send_response(const SafeFD& socket, std::string_view header, std::string_view body) {
-  std::string response = std::string(header) + std::string(body) + "\n";
-  int bytes_sent = send(socket.get(), response.c_str(), response.size(), 0);
-  if (bytes_sent < 0) {
-    return errno;
+  // Cabecera, cuerpo y '\n' final en un solo sendmsg(): sin concatenarlos en una cadena nueva
+  std::string_view parts[] = {header, body, "\n"};
+  auto sent = send_parts(socket, parts);
+  if (!sent) {
+    errno = sent.error();
+    return -1;
+  }
+  return static_cast<int>(sent.value());
+}
+
+/// @brief Envía todas las partes seguidas con sendmsg(), sin concatenarlas
+/// @param socket
+/// @param parts Partes en orden (hasta 64 por llamada al sistema)
+/// @return Bytes enviados o errno
+std::expected<uint64_t, int> send_parts(const SafeFD& socket, std::span<const std::string_view> parts) {
+  constexpr size_t max_iov = 64;
+  iovec iov[max_iov];
+  uint64_t bytes_sent = 0;
+  while (!parts.empty()) {
+    size_t count = std::min(parts.size(), max_iov);
+    for (size_t i = 0; i < count; ++i) {
+      iov[i] = {const_cast<char*>(parts[i].data()), parts[i].size()};
+    }
+    parts = parts.subspan(count);
+    msghdr message{};
+    message.msg_iov = iov;
+    message.msg_iovlen = count;
+    // MSG_MORE mientras queden tandas: el final de una y el principio de la siguiente van en el
+    // mismo segmento
+    int flags = MSG_NOSIGNAL | (parts.empty() ? 0 : MSG_MORE);
+    while (message.msg_iovlen > 0) {
+      ssize_t sent = sendmsg(socket.get(), &message, flags);
+      if (sent < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return std::unexpected(errno);
+      }
+      bytes_sent += static_cast<uint64_t>(sent);
+      // Saltar lo ya enviado (envío parcial)
+      while (message.msg_iovlen > 0 && static_cast<size_t>(sent) >= message.msg_iov->iov_len) {
+        sent -= static_cast<ssize_t>(message.msg_iov->iov_len);
+        ++message.msg_iov;
+        --message.msg_iovlen;
+      }
+      if (message.msg_iovlen > 0) {
+        message.msg_iov->iov_base = static_cast<char*>(message.msg_iov->iov_base) + sent;
+        message.msg_iov->iov_len -= static_cast<size_t>(sent);
+      }
+    }
   }
   return bytes_sent;
 }
@@ -144,34 +381,439 @@ int send_response(const SafeFD& socket, std::string_view header, std::string_vie
 /// @brief Recibe una petición
 /// @param socket
 /// @param max_size
-/// @return std::string
-std::expected<std::string, int> receive_request(const SafeFD& socket, size_t max_size) {
-  std::string buffer(max_size, '\0');
-  int bytes_received = recv(socket.get(), buffer.data(), max_size, 0);
+/// @param resource Asignador del búfer (la arena de la petición)
+/// @return std::pmr::string
+std::expected<std::pmr::string, int> receive_request(const SafeFD& socket, size_t max_size, std::pmr::memory_resource* resource) {
+  std::pmr::string buffer(max_size, '\0', resource);
+  ssize_t bytes_received = recv(socket.get(), buffer.data(), max_size, 0);
   if (bytes_received < 0) {
     return std::unexpected(errno);
   }
-  buffer.resize(bytes_received);
+  buffer.resize(static_cast<size_t>(bytes_received));
   return buffer;
 }
 
+/// @brief Separa el método y la ruta de la primera línea de una petición
+/// @param request Petición recibida
+/// @return request_line (campos vacíos si faltan)
+request_line parse_request(std::string_view request) {
+  constexpr std::string_view blanks = " \t\r\n";
+  request_line line;
+  std::string_view* fields[] = {&line.method, &line.path};
+  for (std::string_view* field : fields) {
+    size_t start = request.find_first_not_of(blanks);
+    if (start == std::string_view::npos) {
+      break;
+    }
+    request.remove_prefix(start);
+    *field = request.substr(0, request.find_first_of(blanks));
+    request.remove_prefix(field->size());
+  }
+  return line;
+}
+
+/// @brief Compara dos textos sin distinguir mayúsculas (nombres de cabecera)
+static bool equals_ignoring_case(std::string_view a, std::string_view b) {
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+    return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+  });
+}
+
+/// @brief Lee las cabeceras de una petición con cuerpo
+/// @param request Petición recibida hasta ahora
+/// @return request_body, EAGAIN si aún falta la línea vacía o EINVAL
+std::expected<request_body, int> parse_request_body(std::string_view request) {
+  constexpr std::string_view blanks = " \t";
+  size_t position = request.find('\n');
+  if (position == std::string_view::npos) {
+    return std::unexpected(EAGAIN);
+  }
+  ++position;
+  request_body body;
+  bool chunked = false;
+  bool has_length = false;
+  while (true) {
+    size_t line_end = request.find('\n', position);
+    if (line_end == std::string_view::npos) {
+      return std::unexpected(EAGAIN);
+    }
+    std::string_view line = request.substr(position, line_end - position);
+    position = line_end + 1;
+    if (line.ends_with('\r')) {
+      line.remove_suffix(1);
+    }
+    if (line.empty()) {
+      break;
+    }
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos) {
+      return std::unexpected(EINVAL);
+    }
+    std::string_view name = line.substr(0, colon);
+    std::string_view value = line.substr(colon + 1);
+    value.remove_prefix(std::min(value.find_first_not_of(blanks), value.size()));
+    value = value.substr(0, value.find_last_not_of(blanks) + 1);
+    if (equals_ignoring_case(name, "Content-Length")) {
+      auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), body.length);
+      if (has_length || error != std::errc{} || end != value.data() + value.size()) {
+        return std::unexpected(EINVAL);
+      }
+      has_length = true;
+    } else if (equals_ignoring_case(name, "Transfer-Encoding")) {
+      if (!equals_ignoring_case(value, "chunked")) {
+        return std::unexpected(EINVAL);
+      }
+      chunked = true;
+    }
+  }
+  // Con las dos cabeceras no está claro dónde acaba el cuerpo: se rechaza
+  if (chunked && has_length) {
+    return std::unexpected(EINVAL);
+  }
+  body.type = chunked ? request_body::encoding::chunked
+            : has_length ? request_body::encoding::length
+                         : request_body::encoding::none;
+  body.offset = position;
+  return body;
+}
+
+/// @brief Lee la lista de documentos de un lote
+/// @param request Petición recibida
+/// @param documents Dónde dejar los nombres (vistas sobre request)
+/// @return Número de documentos o EAGAIN, EINVAL, E2BIG
+std::expected<size_t, int> parse_bundle(std::string_view request, std::span<std::string_view> documents) {
+  constexpr std::string_view blanks = " \t";
+  size_t position = request.find('\n');
+  if (position == std::string_view::npos) {
+    return std::unexpected(EAGAIN);
+  }
+  ++position;
+  size_t count = 0;
+  while (true) {
+    size_t line_end = request.find('\n', position);
+    if (line_end == std::string_view::npos) {
+      return std::unexpected(EAGAIN);
+    }
+    std::string_view line = request.substr(position, line_end - position);
+    position = line_end + 1;
+    if (line.ends_with('\r')) {
+      line.remove_suffix(1);
+    }
+    if (line.empty()) {
+      break;
+    }
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos) {
+      return std::unexpected(EINVAL);
+    }
+    if (!equals_ignoring_case(line.substr(0, colon), "Document")) {
+      continue;
+    }
+    std::string_view value = line.substr(colon + 1);
+    value.remove_prefix(std::min(value.find_first_not_of(blanks), value.size()));
+    value = value.substr(0, value.find_last_not_of(blanks) + 1);
+    if (value.empty()) {
+      return std::unexpected(EINVAL);
+    }
+    if (count == documents.size()) {
+      return std::unexpected(E2BIG);
+    }
+    documents[count++] = value;
+  }
+  if (count == 0) {
+    return std::unexpected(EINVAL);
+  }
+  return count;
+}
+
+/// @brief Sigue recibiendo hasta tener la línea vacía que cierra las cabeceras, max_size bytes
+/// o el cierre del cliente
+/// @param socket
+/// @param request Petición recibida hasta ahora (se amplía)
+/// @param max_size
+/// @return 0 o errno de recv()
+int receive_headers(const SafeFD& socket, std::pmr::string& request, size_t max_size) {
+  auto incomplete = [&request] {
+    auto body = parse_request_body(request);
+    return !body && body.error() == EAGAIN;
+  };
+  while (request.size() < max_size && incomplete()) {
+    size_t received = request.size();
+    request.resize(max_size);
+    ssize_t bytes_received = recv(socket.get(), request.data() + received, max_size - received, 0);
+    request.resize(received + static_cast<size_t>(std::max<ssize_t>(bytes_received, 0)));
+    if (bytes_received < 0 && errno != EINTR) {
+      return errno;
+    }
+    if (bytes_received == 0) {
+      break;
+    }
+  }
+  return 0;
+}
+
+/// @brief Escribe todo el búfer en un descriptor
+/// @return 0 o errno
+static int write_all(const SafeFD& fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t written = write(fd.get(), data.data(), data.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno;
+    }
+    data.remove_prefix(static_cast<size_t>(written));
+  }
+  return 0;
+}
+
+// Origen del cuerpo de una petición: primero lo que llegó junto a las cabeceras y después el
+// socket
+struct body_source {
+  const SafeFD& socket;
+  std::string_view buffered;
+
+  /// @brief Pasa count bytes del cuerpo a la tubería: lo ya recibido con write() y el resto con
+  /// splice(), que lo mueve del socket a la tubería sin copiarlo a este proceso
+  /// @return 0 o errno
+  int forward(uint64_t count, const SafeFD& input)
+  {
+    size_t from_buffer = static_cast<size_t>(std::min<uint64_t>(count, buffered.size()));
+    if (int error = write_all(input, buffered.substr(0, from_buffer)); error != 0) {
+      return error;
+    }
+    buffered.remove_prefix(from_buffer);
+    count -= from_buffer;
+    while (count > 0) {
+      ssize_t moved = splice(socket.get(), nullptr, input.get(), nullptr, static_cast<size_t>(std::min<uint64_t>(count, 1 << 20)),
+                             SPLICE_F_MOVE | SPLICE_F_MORE);
+      if (moved < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return errno;
+      }
+      if (moved == 0) {
+        return ECONNABORTED;
+      }
+      count -= static_cast<uint64_t>(moved);
+    }
+    return 0;
+  }
+
+  /// @brief Lee una línea de control de los trozos (tamaño o final de trozo), sin el salto
+  /// @return 0 o errno
+  int read_line(char (&line)[80], size_t& size)
+  {
+    size = 0;
+    while (true) {
+      char c;
+      if (!buffered.empty()) {
+        c = buffered.front();
+        buffered.remove_prefix(1);
+      } else {
+        // Byte a byte: las líneas de control son cortas y lo que sigue es del siguiente splice()
+        ssize_t received = recv(socket.get(), &c, 1, 0);
+        if (received < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return errno;
+        }
+        if (received == 0) {
+          return ECONNABORTED;
+        }
+      }
+      if (c == '\n') {
+        if (size > 0 && line[size - 1] == '\r') {
+          --size;
+        }
+        return 0;
+      }
+      if (size == sizeof(line)) {
+        return EPROTO;
+      }
+      line[size++] = c;
+    }
+  }
+};
+
+/// @brief Envía el cuerpo de una petición a la entrada de un programa, sin guardarlo entero
+/// @param socket Socket del cliente (bloqueante)
+/// @param buffered Parte del cuerpo que llegó junto a las cabeceras
+/// @param body Cuerpo según las cabeceras
+/// @param max_size Tamaño máximo del cuerpo
+/// @param input Extremo de escritura de la entrada del programa
+/// @return Bytes del cuerpo entregados o errno
+std::expected<uint64_t, int> stream_request_body(const SafeFD& socket, std::string_view buffered, const request_body& body,
+                                                 uint64_t max_size, const SafeFD& input) {
+  body_source source{socket, buffered};
+  if (body.type == request_body::encoding::none) {
+    return 0;
+  }
+  if (body.type == request_body::encoding::length) {
+    if (body.length > max_size) {
+      return std::unexpected(EFBIG);
+    }
+    if (int error = source.forward(body.length, input); error != 0) {
+      return std::unexpected(error);
+    }
+    return body.length;
+  }
+
+  // Por trozos: "TAMAÑO-HEX[;extensiones]\r\n" + datos + "\r\n", hasta un trozo de tamaño 0
+  uint64_t total = 0;
+  char line[80];
+  size_t size;
+  while (true) {
+    if (int error = source.read_line(line, size); error != 0) {
+      return std::unexpected(error);
+    }
+    std::string_view digits{line, size};
+    digits = digits.substr(0, digits.find(';'));
+    uint64_t chunk = 0;
+    auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), chunk, 16);
+    if (error != std::errc{} || end == digits.data()) {
+      return std::unexpected(EPROTO);
+    }
+    if (chunk == 0) {
+      break;
+    }
+    if (chunk > max_size - total) {
+      return std::unexpected(EFBIG);
+    }
+    if (int error = source.forward(chunk, input); error != 0) {
+      return std::unexpected(error);
+    }
+    total += chunk;
+    if (int error = source.read_line(line, size); error != 0 || size != 0) {
+      return std::unexpected(error != 0 ? error : EPROTO);
+    }
+  }
+  // Cabeceras finales, que se descartan, hasta la línea vacía
+  do {
+    if (int error = source.read_line(line, size); error != 0) {
+      return std::unexpected(error);
+    }
+  } while (size != 0);
+  return total;
+}
+
+/// @brief Escribe "Content-Length: N\n\n" en el búfer
+/// @param buffer
+/// @param length
+/// @return Vista sobre la cabecera escrita
+std::string_view format_content_length(char (&buffer)[content_length_capacity], uint64_t length) {
+  constexpr std::string_view prefix = "Content-Length: ";
+  prefix.copy(buffer, prefix.size());
+  char* end = std::to_chars(buffer + prefix.size(), buffer + content_length_capacity - 2, length).ptr;
+  *end++ = '\n';
+  *end++ = '\n';
+  return {buffer, static_cast<size_t>(end - buffer)};
+}
+
+/// @brief Entorno del programa hijo: el del servidor más las variables de la petición
+///
+/// Se construye antes de fork(): en el hijo de un proceso con varios hilos solo es seguro usar
+/// funciones async-signal-safe, así que allí no se puede llamar a setenv() (reserva memoria y
+/// toma el cerrojo del entorno, que otro hilo puede tener) y el entorno se pasa a execve()
+struct child_environment {
+  std::pmr::vector<std::pmr::string> variables;
+  std::pmr::vector<char*> pointers;   // Terminado en nullptr, apunta a variables
+};
+
+/// @brief Construye el entorno de execve()
+/// @param env Variables de la petición (su asignador se usa también aquí)
+/// @return Entorno listo para execve()
+static child_environment make_child_environment(const exec_environment& env) {
+    auto allocator = env.REQUEST_PATH.get_allocator();
+    child_environment child{std::pmr::vector<std::pmr::string>{allocator}, std::pmr::vector<char*>{allocator}};
+    // Tamaño final reservado de una vez: en una arena monótona cada crecimiento del vector
+    // dejaría atrás el bloque anterior
+    size_t inherited_count = 0;
+    while (environ[inherited_count] != nullptr) {
+        ++inherited_count;
+    }
+    child.variables.reserve(inherited_count + 6); // Las 6 de la petición como mucho
+    auto add = [&](std::string_view name, const std::pmr::string& value) {
+        std::pmr::string& variable = child.variables.emplace_back(name);
+        variable += '=';
+        variable += value;
+    };
+    add("REQUEST_PATH", env.REQUEST_PATH);
+    add("SERVER_BASEDIR", env.SERVER_BASEDIR);
+    add("REMOTE_PORT", env.REMOTE_PORT);
+    add("REMOTE_IP", env.REMOTE_IP);
+    add("REQUEST_METHOD", env.REQUEST_METHOD);
+    if (!env.CONTENT_LENGTH.empty()) {
+        add("CONTENT_LENGTH", env.CONTENT_LENGTH);
+    }
+    size_t own = child.variables.size();
+
+    // El resto del entorno del servidor, sin las variables que se acaban de definir
+    for (char** entry = environ; *entry != nullptr; ++entry) {
+        std::string_view inherited{*entry};
+        auto own_end = child.variables.begin() + static_cast<ptrdiff_t>(own);
+        bool replaced = std::any_of(child.variables.begin(), own_end, [&](const std::pmr::string& variable) {
+            size_t name_end = variable.find('=') + 1;
+            return inherited.starts_with(std::string_view{variable}.substr(0, name_end));
+        });
+        if (!replaced) {
+            child.variables.emplace_back(inherited);
+        }
+    }
+    child.pointers.reserve(child.variables.size() + 1);
+    for (std::pmr::string& variable : child.variables) {
+        child.pointers.push_back(variable.data());
+    }
+    child.pointers.push_back(nullptr);
+    return child;
+}
+
 /// @brief Ejecuta un programa
 /// @param path Ruta del programa
-/// @param env Entorno de ejecución
+/// @param env Entorno de ejecución (su asignador se usa también para la salida)
+/// @param on_spawn Se llama con el PID del hijo nada más crearlo (antes de esperarlo)
+/// @param on_input Si se indica, el hijo lee su entrada de una tubería cuyo extremo de escritura
+/// se entrega aquí (quien lo reciba debe escribir en otro hilo y cerrarlo al terminar)
 /// @return Resultado de la ejecución o error
-std::expected<std::string, execute_program_error> execute_program(const std::string& path, const exec_environment& env) {
-    // Crear una tubería para capturar la salida estándar del proceso hijo
+std::expected<std::pmr::string, execute_program_error> execute_program(const std::pmr::string& path, const exec_environment& env,
+                                                                       const std::function<void(pid_t)>& on_spawn,
+                                                                       const std::function<void(SafeFD)>& on_input) {
+    // Crear una tubería para capturar la salida estándar del proceso hijo, con O_CLOEXEC: los
+    // hijos que lancen otros hilos a la vez no deben heredar su extremo de escritura o la lectura
+    // no vería el final hasta que ellos terminen
     int pipefd[2];
-    if (pipe(pipefd) == -1) {
+    if (pipe2(pipefd, O_CLOEXEC) == -1) {
         std::cerr << "Error: no se pudo crear la tubería\n";
         return std::unexpected(execute_program_error{.exit_code = -1, .error_code = errno});
     }
+    SafeFD output_fd{pipefd[0]};
+    SafeFD child_output{pipefd[1]};
 
     // Comprobar que el programa existe y tenemos permisos con la función access()
     if (access(path.c_str(), X_OK) == -1) {
         return std::unexpected(execute_program_error{.exit_code = -1, .error_code = errno});
     }
 
+    // Tubería para la entrada estándar, con O_CLOEXEC: los hijos que lancen otros hilos a la vez
+    // no deben heredar su extremo de escritura o el programa nunca vería el final de la entrada
+    SafeFD input_fd;
+    SafeFD child_input;
+    if (on_input) {
+        int inputfd[2];
+        if (pipe2(inputfd, O_CLOEXEC) == -1) {
+            return std::unexpected(execute_program_error{.exit_code = -1, .error_code = errno});
+        }
+        child_input = SafeFD{inputfd[0]};
+        input_fd = SafeFD{inputfd[1]};
+    }
+
+    // Todo lo que necesita el hijo se prepara antes de fork()
+    child_environment environment = make_child_environment(env);
+    char* arguments[] = {const_cast<char*>(path.c_str()), nullptr};
+
     // Crear un proceso hijo con fork()
     pid_t pid = fork();
     if (pid < 0) {
@@ -181,38 +823,40 @@ std::expected<std::string, execute_program_error> execute_program(const std::str
 
     // Flujo de ejecución proceso hijo
     if (pid == 0) {
-        close(pipefd[0]); // Cerrar extremo de lectura
-        if (dup2(pipefd[1], STDOUT_FILENO) == -1) { // Redirigir salida estándar
-            std::cerr << "Error: fallo al redirigir la salida estándar\n";
-            return std::unexpected(execute_program_error{.exit_code = 125, .error_code = errno});
+        setpgid(0, 0); // Grupo de procesos propio: así se puede terminar también a sus descendientes
+        // Redirigir salida estándar (dup2 quita O_CLOEXEC a la copia; los extremos originales
+        // se cierran solos al ejecutar el programa)
+        if (dup2(child_output.get(), STDOUT_FILENO) == -1) {
+            _exit(125);
+        }
+        if (child_input.is_valid() && dup2(child_input.get(), STDIN_FILENO) == -1) { // Redirigir entrada estándar
+            _exit(125);
         }
-        close(pipefd[1]); // Cerrar extremo de escritura después de redirigir
-
-        // Configurar las variables de entorno
-        setenv("REQUEST_PATH", env.REQUEST_PATH.c_str(), 1);
-        setenv("SERVER_BASEDIR", env.SERVER_BASEDIR.c_str(), 1);
-        setenv("REMOTE_PORT", env.REMOTE_PORT.c_str(), 1);
-        setenv("REMOTE_IP", env.REMOTE_IP.c_str(), 1);
 
-        // Ejecutar el programa con execl()
-        execl(path.c_str(), path.c_str(), nullptr);
+        // Ejecutar el programa con execve() y el entorno preparado antes de fork()
+        execve(path.c_str(), arguments, environment.pointers.data());
 
-        // Si execl() falla
-        std::cerr << "Error: fallo al ejecutar el programa con execl()\n";
-        exit(errno == ENOENT ? 127 : 126);
+        // Si execve() falla (sin iostream ni exit(): otro hilo podría tener sus cerrojos)
+        _exit(errno == ENOENT ? 127 : 126);
     }
 
     // Flujo de ejecución proceso padre
-    close(pipefd[1]); // Cerrar extremo de escritura en el proceso padre
+    child_output = SafeFD{}; // Cerrar extremo de escritura en el proceso padre
+    if (on_spawn) {
+        on_spawn(pid);
+    }
+    if (on_input) {
+        child_input = SafeFD{};
+        on_input(std::move(input_fd));
+    }
 
-    // Leer la tubería con read() hasta que devuelva 0
-    std::string output;
+    // Leer la tubería con read() hasta que devuelva 0 (la salida usa el mismo asignador que el entorno)
+    std::pmr::string output{env.REQUEST_PATH.get_allocator()};
     while (true) {
         char buffer[4096];
-        ssize_t bytes_read = read(pipefd[0], buffer, sizeof(buffer));
+        ssize_t bytes_read = read(output_fd.get(), buffer, sizeof(buffer));
         if (bytes_read < 0) {
             std::cerr << "Error: fallo al leer de la tubería\n";
-            close(pipefd[0]);
             return std::unexpected(execute_program_error{.exit_code = 126, .error_code = errno});
         }
         if (bytes_read == 0) {
@@ -220,7 +864,7 @@ std::expected<std::string, execute_program_error> execute_program(const std::str
         }
         output.append(buffer, bytes_read);
     }
-    close(pipefd[0]);
+    output_fd = SafeFD{};
 
     // Esperar a que el proceso hijo termine
     int status;
@@ -241,3 +885,211 @@ std::expected<std::string, execute_program_error> execute_program(const std::str
     // Devolver la salida estándar del proceso hijo
     return output;
 }
+
+/// @brief Lanza un programa con el mismo entorno que execute_program, sin esperarlo
+/// @param path Ruta del programa
+/// @param env Entorno de ejecución
+/// @param with_input Dar al hijo una tubería como entrada estándar (extremo de escritura en input)
+/// @return Hijo con su pidfd y el extremo de lectura de su salida, o errno
+std::expected<child_process, int> spawn_program(const std::pmr::string& path, const exec_environment& env, bool with_input) {
+    if (access(path.c_str(), X_OK) == -1) {
+        return std::unexpected(errno);
+    }
+    int pipefd[2];
+    if (pipe2(pipefd, O_CLOEXEC) == -1) {
+        return std::unexpected(errno);
+    }
+    SafeFD output{pipefd[0]};
+    SafeFD child_output{pipefd[1]};
+    SafeFD input;
+    SafeFD child_input;
+    if (with_input) {
+        if (pipe2(pipefd, O_CLOEXEC) == -1) {
+            return std::unexpected(errno);
+        }
+        child_input = SafeFD{pipefd[0]};
+        input = SafeFD{pipefd[1]};
+    }
+    child_environment environment = make_child_environment(env);
+    char* arguments[] = {const_cast<char*>(path.c_str()), nullptr};
+    pid_t pid = fork();
+    if (pid < 0) {
+        return std::unexpected(errno);
+    }
+    if (pid == 0) {
+        setpgid(0, 0);
+        if (dup2(child_output.get(), STDOUT_FILENO) == -1) { // dup2 quita O_CLOEXEC a la copia
+            _exit(125);
+        }
+        if (child_input.is_valid() && dup2(child_input.get(), STDIN_FILENO) == -1) {
+            _exit(125);
+        }
+        execve(path.c_str(), arguments, environment.pointers.data());
+        _exit(errno == ENOENT ? 127 : 126);
+    }
+    child_output = SafeFD{};
+    child_input = SafeFD{};
+    fcntl(output.get(), F_SETFL, O_NONBLOCK);
+    SafeFD pidfd{static_cast<int>(syscall(SYS_pidfd_open, pid, 0))};
+    if (!pidfd.is_valid()) {
+        int error = errno;
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        return std::unexpected(error);
+    }
+    return child_process{pid, std::move(pidfd), std::move(output), std::move(input)};
+}
+
+/// @brief Dirección de un socket Unix: una ruta o, si empieza por '@', un nombre del espacio
+/// abstracto (sin archivo que borrar, desaparece con el último socket que lo usa)
+/// @param path Ruta o "@nombre"
+/// @param address Dirección a rellenar
+/// @return Longitud de la dirección
+static socklen_t unix_address(const std::string& path, sockaddr_un& address) {
+  address = {};
+  address.sun_family = AF_UNIX;
+  size_t length = path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+  if (path.starts_with('@')) {
+    address.sun_path[0] = '\0';
+    return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + length); // Sin '\0' final
+  }
+  return sizeof(address);
+}
+
+/// @brief Crea un socket Unix a la escucha en la ruta indicada (borra la anterior si existe)
+/// @param path Ruta del socket o "@nombre" en el espacio abstracto
+/// @param backlog Tamaño de la cola de conexiones pendientes
+/// @return SafeFD
+std::expected<SafeFD, int> make_unix_socket(const std::string& path, int backlog) {
+  SafeFD sock_fd{socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+  if (!sock_fd.is_valid()) {
+    return std::unexpected(errno);
+  }
+  sockaddr_un local_address;
+  socklen_t length = unix_address(path, local_address);
+  // Puede quedar de un servidor anterior; solo se borra si es un socket
+  struct stat status;
+  if (!path.starts_with('@') && lstat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+    unlink(path.c_str());
+  }
+  if (bind(sock_fd.get(), reinterpret_cast<sockaddr*>(&local_address), length) < 0) {
+    return std::unexpected(errno);
+  }
+  if (listen(sock_fd.get(), backlog) < 0) {
+    return std::unexpected(errno);
+  }
+  return sock_fd;
+}
+
+/// @brief Conecta con un socket Unix
+/// @param path Ruta del socket o "@nombre" en el espacio abstracto
+/// @return SafeFD
+std::expected<SafeFD, int> connect_unix_socket(const std::string& path) {
+  SafeFD sock_fd{socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+  if (!sock_fd.is_valid()) {
+    return std::unexpected(errno);
+  }
+  sockaddr_un remote_address;
+  socklen_t length = unix_address(path, remote_address);
+  if (connect(sock_fd.get(), reinterpret_cast<sockaddr*>(&remote_address), length) < 0) {
+    return std::unexpected(errno);
+  }
+  return sock_fd;
+}
+
+/// @brief Dirección de un cliente en texto
+/// @param peer Dirección devuelta por accept()
+/// @return IP y puerto, o "unix" sin puerto si no es una conexión TCP
+peer_text describe_peer(const sockaddr_storage& peer) {
+  peer_text text{};
+  if (peer.ss_family != AF_INET) {
+    std::string_view local = "unix";
+    local.copy(text.ip, sizeof(text.ip) - 1);
+    return text;
+  }
+  const auto& address = reinterpret_cast<const sockaddr_in&>(peer);
+  inet_ntop(AF_INET, &address.sin_addr, text.ip, sizeof(text.ip)); // inet_ntoa no es segura entre hilos
+  std::to_chars(text.port, text.port + sizeof(text.port) - 1, ntohs(address.sin_port));
+  return text;
+}
+
+/// @brief Envía un descriptor de archivo a otro proceso (SCM_RIGHTS)
+/// @param channel Socket Unix conectado con el otro proceso
+/// @param descriptor Descriptor a compartir (sigue siendo válido en este proceso)
+/// @return 0 o el errno de sendmsg
+int send_descriptor(const SafeFD& channel, const SafeFD& descriptor) {
+  char data = 'F'; // Hay que enviar al menos un byte de datos junto al mensaje de control
+  iovec iov{&data, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  cmsghdr* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(int));
+  int fd = descriptor.get();
+  memcpy(CMSG_DATA(header), &fd, sizeof(fd));
+  if (sendmsg(channel.get(), &message, MSG_NOSIGNAL) < 0) {
+    return errno;
+  }
+  return 0;
+}
+
+/// @brief Recibe un descriptor de archivo enviado con send_descriptor
+/// @param channel Socket Unix conectado con el otro proceso
+/// @return SafeFD con el descriptor recibido
+std::expected<SafeFD, int> receive_descriptor(const SafeFD& channel) {
+  char data;
+  iovec iov{&data, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  ssize_t received = recvmsg(channel.get(), &message, MSG_CMSG_CLOEXEC);
+  if (received < 0) {
+    return std::unexpected(errno);
+  }
+  cmsghdr* header = CMSG_FIRSTHDR(&message);
+  if (received == 0 || header == nullptr || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+    return std::unexpected(EPROTO);
+  }
+  int fd;
+  memcpy(&fd, CMSG_DATA(header), sizeof(fd));
+  return SafeFD(fd);
+}
+
+/// @brief Fija el hilo actual a una CPU (los hilos que cree después la heredan)
+/// @param cpu
+/// @return 0 o errno
+int pin_thread(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/// @brief Hace que la memoria que toque el hilo actual (y los hilos que cree después) salga
+/// de preferencia del nodo NUMA de la CPU en la que se ejecuta
+/// @return Nodo elegido o errno
+std::expected<int, int> prefer_local_node() {
+  unsigned int cpu = 0;
+  unsigned int node = 0;
+  if (getcpu(&cpu, &node) < 0) {
+    return std::unexpected(errno);
+  }
+  unsigned long mask[16]{};
+  constexpr unsigned long bits = sizeof(mask) * CHAR_BIT;
+  if (node >= bits) {
+    return std::unexpected(EINVAL);
+  }
+  mask[node / (sizeof(unsigned long) * CHAR_BIT)] |= 1UL << (node % (sizeof(unsigned long) * CHAR_BIT));
+  if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, bits) < 0) {
+    return std::unexpected(errno);
+  }
+  return static_cast<int>(node);
+}
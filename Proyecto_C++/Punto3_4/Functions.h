@@ -14,10 +14,16 @@
 #include <sstream>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <sys/un.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <functional>
+#include <memory_resource>
+#include <span>
+#include <string_view>
 #include "SafeFD.h"
 #include "SafeMap.h"
+#include "SocketPolicy.h"
 
 // Enumerado para los errores de parse_args
 enum class parse_args_errors
@@ -25,7 +31,8 @@ enum class parse_args_errors
   missing_argument,
   unknown_option,
   invalid_port,
-  invalid_route
+  invalid_route,
+  invalid_value
 };
 
 // Estructura para almacenar las opciones del programa
@@ -37,32 +44,153 @@ struct program_options
   bool base = false;
   uint16_t port_value = 0;
   std::string ruta_base;
+  std::string unix_path;             // Escuchar en un socket Unix en lugar de -p ("@nombre": abstracto)
   std::string output_filename;
+  // Control de admisión
+  int backlog = 128;                 // Cola de conexiones pendientes del kernel (listen)
+  size_t max_connections = 64;       // Conexiones atendidas a la vez
+  size_t max_cgi = 8;                // Peticiones /bin/ ejecutándose a la vez
+  size_t max_static = 64;            // Peticiones de archivos enviándose a la vez
+  int retry_after = 1;               // Segundos que se anuncian en Retry-After al rechazar
+  // Plazos por conexión (milisegundos)
+  uint64_t read_timeout_ms = 10000;  // Recibir la petición completa
+  uint64_t send_timeout_ms = 30000;  // Enviar la respuesta
+  uint64_t cgi_timeout_ms = 30000;   // Ejecución de un programa de /bin/
+  // Reinicio sin cortes
+  std::string upgrade_socket;        // Socket Unix donde se atienden peticiones de relevo
+  std::string inherit_socket;        // Socket Unix del servidor anterior del que heredar la escucha
+  uint64_t drain_timeout_ms = 30000; // Espera máxima a las conexiones en curso tras el relevo
+  // Documentos empaquetados con docpack
+  std::string archive_path;          // Archivo a servir en lugar del directorio base
+  // Enrutado
+  std::string routes_path;           // Tabla de rutas (por defecto: /bin/ CGI y / estático)
+  // Diagnóstico
+  std::string trace_path;            // Activar las trazas por fase desde el arranque y volcarlas aquí
+  std::string capture_path;          // Grabar cada petición atendida (para docreplay)
+  // Hilos de aceptación y afinidad
+  size_t workers = 0;                // Hilos de aceptación (0: uno por CPU de --cpus, o uno)
+  std::vector<int> cpus;             // CPU a las que se fijan los hilos de aceptación, por turnos
+  bool incoming_cpu = false;         // Un socket de escucha por hilo, con SO_INCOMING_CPU
+  // Caché de contenidos en páginas enormes
+  size_t cache_mb = 0;               // Tamaño de la región en MiB (0: sin caché)
+  size_t cache_max_file_kb = 64;     // Documentos más grandes no se cachean
+  // Modelo de ejecución
+  bool async = false;                // Corrutinas sobre epoll en lugar de un hilo por conexión
+  size_t file_threads = 4;           // Con --async: hilos para stat()/open()/leer documentos
+  size_t process_threads = 2;        // Con --async: hilos para lanzar CGI y ejecutar plugins
+  size_t processes = 1;              // Procesos de trabajo creados con fork() al arrancar
+  size_t shared_cache_mb = 0;        // Caché memfd compartida por los procesos, en MiB (0: sin ella)
+  // Límite de peticiones por cliente (0: sin límite)
+  uint32_t rate_static = 0;          // Peticiones por segundo y IP a rutas no CGI
+  uint32_t rate_cgi = 0;             // Programas de /bin/ por segundo y IP
+  uint32_t rate_burst = 1;           // Ráfaga admitida, en segundos de ritmo
+  // Peticiones con cuerpo
+  uint32_t max_body_kb = 1024;       // Tamaño máximo del cuerpo de un POST/PUT, en KiB
+  // Índices de directorio
+  bool listings = false;             // Responder a un directorio con sus entradas (si no, 403)
+  // Conjunto caliente
+  std::string hot_set_path;          // Manifiesto de los documentos más pedidos (vacío: sin él)
+  uint64_t hot_set_interval_s = 60;  // Cada cuánto se guarda el manifiesto
+  // Ajustes TCP de los sockets de escucha y de las conexiones
+  socket_policy sockets;
   // ...
   std::vector<std::string> additional_args; 
 };
 
 std::expected<program_options, parse_args_errors> parse_args(int argc, char* argv[]);
-std::expected<SafeMap, int> read_all(const std::string& path);
-std::expected<SafeFD, int> make_socket(uint16_t port);
-int listen_connection(const SafeFD& socket);
-std::expected<SafeFD, int> accept_connection(const SafeFD& socket, sockaddr_in& client_addr);
+std::expected<SafeMap, int> read_all(const char* path);
+std::expected<SafeFD, int> make_socket(uint16_t port, int backlog, int incoming_cpu = -1);
+int listen_connection(const SafeFD& socket, int backlog);
+std::expected<SafeFD, int> accept_connection(const SafeFD& socket, sockaddr_storage& client_addr, int flags = SOCK_CLOEXEC);
 int send_response(const SafeFD& socket, std::string_view header, std::string_view body = {});
-std::expected<std::string, int> receive_request(const SafeFD& socket,size_t max_size);
+std::expected<uint64_t, int> send_parts(const SafeFD& socket, std::span<const std::string_view> parts);
+std::expected<std::pmr::string, int> receive_request(const SafeFD& socket, size_t max_size,
+                                                     std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+std::expected<SafeFD, int> make_unix_socket(const std::string& path, int backlog = 1);
+std::expected<SafeFD, int> connect_unix_socket(const std::string& path);
+int send_descriptor(const SafeFD& channel, const SafeFD& descriptor);
+std::expected<SafeFD, int> receive_descriptor(const SafeFD& channel);
+int pin_thread(int cpu);
+std::expected<int, int> prefer_local_node();
+
+// Dirección de un cliente en texto, para el entorno CGI y los mensajes
+struct peer_text {
+  char ip[INET_ADDRSTRLEN];          // IPv4, o "unix" si llegó por un socket Unix
+  char port[8];                      // Vacío si llegó por un socket Unix
+};
+
+peer_text describe_peer(const sockaddr_storage& peer);
 
 struct execute_program_error {
   int exit_code;
   int error_code;
 };
 
+// Las cadenas usan el asignador de quien crea el entorno (la arena de la petición)
 struct exec_environment {
-  std::string REQUEST_PATH;
-  std::string SERVER_BASEDIR;
-  std::string REMOTE_PORT;
-  std::string REMOTE_IP;
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+  explicit exec_environment(allocator_type allocator = {})
+    : REQUEST_PATH{allocator}, SERVER_BASEDIR{allocator}, REMOTE_PORT{allocator}, REMOTE_IP{allocator},
+      REQUEST_METHOD{allocator}, CONTENT_LENGTH{allocator} {}
+
+  std::pmr::string REQUEST_PATH;
+  std::pmr::string SERVER_BASEDIR;
+  std::pmr::string REMOTE_PORT;
+  std::pmr::string REMOTE_IP;
+  std::pmr::string REQUEST_METHOD;
+  std::pmr::string CONTENT_LENGTH;   // Vacío (y sin definir en el hijo) si el cuerpo va por trozos
+};
+
+// Primera línea de una petición ("GET /ruta"); las vistas apuntan al búfer recibido
+struct request_line {
+  std::string_view method;
+  std::string_view path;
+};
+
+request_line parse_request(std::string_view request);
+
+// Cuerpo de una petición POST/PUT según sus cabeceras. Tras la primera línea puede haber
+// cabeceras hasta una línea vacía; solo se interpretan Content-Length y Transfer-Encoding
+struct request_body {
+  enum class encoding { none, length, chunked };
+  encoding type = encoding::none;
+  uint64_t length = 0;               // Content-Length
+  size_t offset = 0;                 // Dónde empieza el cuerpo en el búfer recibido
+};
+
+// Errores: EAGAIN si aún no ha llegado la línea vacía, EINVAL si las cabeceras no son válidas
+std::expected<request_body, int> parse_request_body(std::string_view request);
+int receive_headers(const SafeFD& socket, std::pmr::string& request, size_t max_size);
+
+// Lote de documentos: "BUNDLE /base/" seguido de una cabecera "Document: nombre" por documento
+// (relativo a la base) y una línea vacía. Errores: EAGAIN si aún falta la línea vacía, EINVAL
+// si no hay ningún documento o una línea no es una cabecera, E2BIG si hay más de los que caben
+constexpr size_t max_bundle = 64;
+std::expected<size_t, int> parse_bundle(std::string_view request, std::span<std::string_view> documents);
+// Errores: EFBIG si supera max_size, EPROTO si los trozos están mal formados, ECONNABORTED si
+// el cliente cierra antes de tiempo o el errno de write/splice
+std::expected<uint64_t, int> stream_request_body(const SafeFD& socket, std::string_view buffered, const request_body& body,
+                                                 uint64_t max_size, const SafeFD& input);
+
+// Cabecera "Content-Length: N\n\n" escrita sobre un búfer del llamador, sin reservar memoria
+constexpr size_t content_length_capacity = 48;
+std::string_view format_content_length(char (&buffer)[content_length_capacity], uint64_t length);
+
+std::expected<std::pmr::string, execute_program_error> execute_program(const std::pmr::string& path, const exec_environment& env,
+                                                                       const std::function<void(pid_t)>& on_spawn = {},
+                                                                       const std::function<void(SafeFD)>& on_input = {});
+
+// Hijo lanzado sin esperarlo: su salida estándar se lee de output (no bloqueante) y su final
+// se espera con pidfd, que sigue refiriéndose a él aunque su PID se reutilice
+struct child_process {
+  pid_t pid;
+  SafeFD pidfd;
+  SafeFD output;
+  SafeFD input;                      // Entrada estándar del hijo (solo si se pidió)
 };
 
-std::expected<std::string, execute_program_error> execute_program(const std::string& path, const exec_environment& env);
+std::expected<child_process, int> spawn_program(const std::pmr::string& path, const exec_environment& env,
+                                                bool with_input = false);
 std::expected<std::string, int> ProcesoPipe(std::string programa);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "HotSet.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <fstream>
+#include <cstdio>
+
+void HotSet::record(std::string_view path, uint64_t bytes) {
+  add(path, 1, bytes);
+}
+
+void HotSet::seed(const std::vector<entry>& entries) {
+  for (const entry& loaded : entries) {
+    add(loaded.path, loaded.hits, loaded.bytes);
+  }
+}
+
+/// @brief Suma a los contadores de una ruta (la crea si aún cabe)
+void HotSet::add(std::string_view path, uint64_t hits, uint64_t bytes) {
+  // Una ruta con salto de línea no se podría escribir en el manifiesto
+  if (path.find('\n') != std::string_view::npos) {
+    return;
+  }
+  shard& owner = shards_[path_hash{}(path) % shard_count];
+  std::lock_guard lock{owner.mutex};
+  auto found = owner.paths.find(path);
+  if (found == owner.paths.end()) {
+    if (size_.load(std::memory_order_relaxed) >= max_paths) {
+      return;
+    }
+    found = owner.paths.emplace(std::string{path}, counters{}).first;
+    size_.fetch_add(1, std::memory_order_relaxed);
+  }
+  found->second.hits += hits;
+  found->second.bytes += bytes;
+}
+
+std::vector<HotSet::entry> HotSet::ranked(size_t limit) const {
+  std::vector<entry> entries;
+  for (const shard& part : shards_) {
+    std::lock_guard lock{part.mutex};
+    for (const auto& [path, count] : part.paths) {
+      entries.push_back({path, count.hits, count.bytes});
+    }
+  }
+  auto hotter = [](const entry& a, const entry& b) {
+    return a.hits != b.hits ? a.hits > b.hits : a.bytes > b.bytes;
+  };
+  if (entries.size() > limit) {
+    std::partial_sort(entries.begin(), entries.begin() + static_cast<std::ptrdiff_t>(limit), entries.end(), hotter);
+    entries.resize(limit);
+  } else {
+    std::sort(entries.begin(), entries.end(), hotter);
+  }
+  return entries;
+}
+
+int HotSet::save(const std::string& path) {
+  std::vector<entry> entries = ranked(manifest_size);
+  std::string temporary = path + ".tmp";
+  {
+    std::ofstream output{temporary, std::ios::trunc};
+    if (!output) {
+      return errno != 0 ? errno : EIO;
+    }
+    output << "# docserver hot-set: aciertos bytes ruta\n";
+    for (const entry& hot : entries) {
+      output << hot.hits << ' ' << hot.bytes << ' ' << hot.path << '\n';
+    }
+    output.flush();
+    if (!output) {
+      return EIO;
+    }
+  }
+  // El renombrado es atómico: quien lea el manifiesto ve el anterior o el nuevo, nunca uno a medias
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    return errno;
+  }
+
+  // Envejecer: lo que ya no se pide acaba desapareciendo y deja sitio a rutas nuevas
+  for (shard& part : shards_) {
+    std::lock_guard lock{part.mutex};
+    for (auto it = part.paths.begin(); it != part.paths.end();) {
+      it->second.hits /= 2;
+      it->second.bytes /= 2;
+      if (it->second.hits == 0) {
+        it = part.paths.erase(it);
+        size_.fetch_sub(1, std::memory_order_relaxed);
+      } else {
+        ++it;
+      }
+    }
+  }
+  return 0;
+}
+
+std::expected<std::vector<HotSet::entry>, int> HotSet::load(const std::string& path) {
+  std::ifstream input{path};
+  if (!input) {
+    return std::unexpected(errno != 0 ? errno : ENOENT);
+  }
+  std::vector<entry> entries;
+  std::string line;
+  while (std::getline(input, line) && entries.size() < manifest_size) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    // "aciertos bytes ruta": la ruta es el resto de la línea, aunque tenga espacios
+    entry hot;
+    const char* end = line.data() + line.size();
+    auto [after_hits, hits_error] = std::from_chars(line.data(), end, hot.hits);
+    if (hits_error != std::errc{} || after_hits == end || *after_hits != ' ') {
+      continue;
+    }
+    auto [after_bytes, bytes_error] = std::from_chars(after_hits + 1, end, hot.bytes);
+    if (bytes_error != std::errc{} || after_bytes == end || *after_bytes != ' ' || after_bytes + 1 == end) {
+      continue;
+    }
+    hot.path.assign(after_bytes + 1, end);
+    entries.push_back(std::move(hot));
+  }
+  return entries;
+}
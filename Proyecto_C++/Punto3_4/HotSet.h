@@ -0,0 +1,89 @@
+#ifndef HOT_SET_H
+#define HOT_SET_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "PathHash.h"
+
+// Conjunto caliente (docserver --hot-set): aciertos y bytes servidos por documento, para
+// guardar de vez en cuando un manifiesto con los más pedidos y, al arrancar, leerlos de
+// antemano (caché de páginas y cachés de contenidos) antes de que llegue el tráfico.
+//
+// Los contadores se reparten en 16 fragmentos con su propio cerrojo, elegidos por el hash de
+// la ruta: los hilos que sirven documentos distintos casi nunca compiten. Cada vez que se guarda
+// el manifiesto los contadores se dividen a la mitad, así que lo que se dejó de pedir se va
+// olvidando y el manifiesto sigue al tráfico reciente.
+//
+// Manifiesto, ordenado por aciertos y después por bytes:
+//   # docserver hot-set: aciertos bytes ruta
+//   1520 3112960 /srv/docs/index.html
+class HotSet
+{
+  public:
+    static constexpr size_t shard_count = 16;
+    static constexpr size_t max_paths = 65536;       // Rutas distintas que se cuentan
+    static constexpr size_t manifest_size = 1024;    // Rutas que se guardan en el manifiesto
+
+    struct entry {
+      std::string path;
+      uint64_t hits;
+      uint64_t bytes;
+    };
+
+    HotSet() = default;
+    HotSet(const HotSet&) = delete;
+    HotSet& operator=(const HotSet&) = delete;
+
+    /// @brief Apunta un documento servido
+    /// @param path Ruta en disco
+    /// @param bytes Tamaño del documento
+    void record(std::string_view path, uint64_t bytes);
+
+    /// @brief Parte de los contadores de un manifiesto anterior (para no perderlos al reiniciar)
+    void seed(const std::vector<entry>& entries);
+
+    /// @brief Rutas más pedidas, de más a menos
+    /// @param limit Máximo de rutas
+    [[nodiscard]] std::vector<entry> ranked(size_t limit) const;
+
+    /// @brief Guarda el manifiesto (en un temporal que luego se renombra) y divide los contadores
+    /// @param path Archivo del manifiesto
+    /// @return 0 o errno
+    int save(const std::string& path);
+
+    /// @brief Lee un manifiesto guardado con save()
+    /// @return Rutas en el orden del manifiesto o errno (ENOENT si aún no hay ninguno)
+    static std::expected<std::vector<entry>, int> load(const std::string& path);
+
+    /// @brief Rutas distintas con contadores
+    [[nodiscard]] size_t size() const noexcept
+    {
+      return size_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct counters {
+      uint64_t hits = 0;
+      uint64_t bytes = 0;
+    };
+
+    // Un fragmento por línea de caché: los cerrojos de fragmentos distintos no se estorban
+    struct alignas(64) shard {
+      mutable std::mutex mutex;
+      path_map<counters> paths;
+    };
+
+    void add(std::string_view path, uint64_t hits, uint64_t bytes);
+
+    std::array<shard, shard_count> shards_;
+    std::atomic<size_t> size_{0};
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include "Listing.h"
+#include "Functions.h"
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+
+// Cabecera de cada registro de getdents64 (glibc no la declara para la llamada directa); el
+// nombre, terminado en '\0', empieza justo detrás de d_type
+struct dirent64_header {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+};
+constexpr size_t dirent64_name_offset = offsetof(dirent64_header, d_type) + 1;
+
+// Cambios en un directorio que invalidan su índice (IN_ATTRIB también cubre un chmod del propio
+// directorio, que cambia quién puede listarlo)
+constexpr uint32_t watched_events = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB |
+                                    IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+// Representación compacta mientras se construye el índice: los nombres seguidos en un único
+// búfer y, por entrada, dónde empieza el suyo
+struct listing_entry {
+  uint32_t offset;
+  uint16_t length;
+  bool directory;
+};
+
+/// @brief Lee todas las entradas de un directorio con getdents64
+/// @param directory Directorio abierto con O_DIRECTORY
+/// @param names Búfer donde se copian los nombres
+/// @param entries Entradas (sin "." ni "..")
+/// @return 0 o errno
+static int read_entries(const SafeFD& directory, std::string& names, std::vector<listing_entry>& entries) {
+  alignas(dirent64_header) char buffer[32768];
+  while (true) {
+    long length = syscall(SYS_getdents64, directory.get(), buffer, sizeof(buffer));
+    if (length < 0) {
+      return errno;
+    }
+    if (length == 0) {
+      return 0;
+    }
+    for (long position = 0; position < length;) {
+      const auto* record = reinterpret_cast<const dirent64_header*>(buffer + position);
+      position += record->d_reclen;
+      std::string_view name{reinterpret_cast<const char*>(record) + dirent64_name_offset};
+      if (name == "." || name == "..") {
+        continue;
+      }
+      bool directory_entry = record->d_type == DT_DIR;
+      if (record->d_type == DT_UNKNOWN) {
+        // Sistemas de archivos que no rellenan d_type: solo entonces hace falta un stat()
+        struct stat status;
+        std::string terminated{name};
+        directory_entry = fstatat(directory.get(), terminated.c_str(), &status, AT_SYMLINK_NOFOLLOW) == 0 &&
+                          S_ISDIR(status.st_mode);
+      }
+      entries.push_back({static_cast<uint32_t>(names.size()), static_cast<uint16_t>(name.size()), directory_entry});
+      names.append(name);
+    }
+  }
+}
+
+/// @brief Construye el índice formateado de un directorio en un memfd sellado
+/// @param path Ruta del directorio
+/// @return Índice o errno
+static std::expected<std::shared_ptr<const ListingCache::listing>, int> build_listing(const std::string& path) {
+  SafeFD directory{open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+  if (!directory.is_valid()) {
+    return std::unexpected(errno);
+  }
+  std::string names;
+  std::vector<listing_entry> entries;
+  if (int error = read_entries(directory, names, entries); error != 0) {
+    return std::unexpected(error);
+  }
+  auto name_of = [&names](const listing_entry& entry) {
+    return std::string_view{names}.substr(entry.offset, entry.length);
+  };
+  std::sort(entries.begin(), entries.end(),
+            [&name_of](const listing_entry& a, const listing_entry& b) { return name_of(a) < name_of(b); });
+
+  // Un nombre por línea y el '\n' final de la respuesta, todo en una sola escritura
+  std::string rendered;
+  rendered.reserve(names.size() + 2 * entries.size() + 1);
+  for (const listing_entry& entry : entries) {
+    rendered.append(name_of(entry));
+    if (entry.directory) {
+      rendered.push_back('/');
+    }
+    rendered.push_back('\n');
+  }
+  uint64_t size = rendered.size();
+  rendered.push_back('\n');
+
+  SafeFD content{memfd_create("docserver-listing", MFD_CLOEXEC | MFD_ALLOW_SEALING)};
+  if (!content.is_valid()) {
+    return std::unexpected(errno);
+  }
+  for (size_t written = 0; written < rendered.size();) {
+    ssize_t result = write(content.get(), rendered.data() + written, rendered.size() - written);
+    if (result < 0) {
+      return std::unexpected(errno);
+    }
+    written += static_cast<size_t>(result);
+  }
+  // Sellado: el contenido ya no puede cambiar mientras otro hilo lo envía
+  fcntl(content.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+
+  char header[content_length_capacity];
+  auto built = std::make_shared<ListingCache::listing>();
+  built->content = std::move(content);
+  built->header = format_content_length(header, size);
+  built->size = size;
+  built->entries = entries.size();
+  return built;
+}
+
+/// @brief Índices que se pueden guardar: una cuarta parte del límite de descriptores
+static size_t listing_capacity() {
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_cur == RLIM_INFINITY) {
+    return ListingCache::max_listings;
+  }
+  return std::min<size_t>(ListingCache::max_listings, static_cast<size_t>(limit.rlim_cur) / 4);
+}
+
+ListingCache::ListingCache() : inotify_{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)}, capacity_{listing_capacity()} {}
+
+/// @brief Comprueba que una ruta no tiene segmentos "." ni ".."
+static bool is_plain_path(std::string_view path) noexcept {
+  while (!path.empty()) {
+    size_t slash = path.find('/');
+    std::string_view segment = path.substr(0, slash);
+    if (segment == "." || segment == "..") {
+      return false;
+    }
+    path.remove_prefix(slash == std::string_view::npos ? path.size() : slash + 1);
+  }
+  return true;
+}
+
+std::expected<std::shared_ptr<const ListingCache::listing>, int> ListingCache::find(std::string_view path) {
+  // Solo se indexan rutas ya normalizadas: un ".." podría salir del directorio servido y cada
+  // forma distinta de escribir el mismo directorio ocuparía su propia entrada y su vigilante
+  if (!is_plain_path(path)) {
+    return std::unexpected(EACCES);
+  }
+  while (path.size() > 1 && path.back() == '/') {
+    path.remove_suffix(1);
+  }
+  drain_events();
+  size_t cached;
+  {
+    std::shared_lock lock{mutex_};
+    if (auto found = index_.find(path); found != index_.end()) {
+      return found->second;
+    }
+    cached = index_.size();
+  }
+
+  // El vigilante se pone antes de leer el directorio: un cambio durante la lectura llega como
+  // evento y descarta el índice recién construido. Con la caché llena (o sin vigilantes libres
+  // en el sistema) el índice se construye igual, pero no se guarda
+  std::string key{path};
+  uint64_t generation = generation_.load(std::memory_order_acquire);
+  int watch = -1;
+  if (cached < capacity_) {
+    watch = inotify_add_watch(inotify_.get(), key.c_str(), watched_events);
+    if (watch < 0 && errno != ENOSPC) {
+      return std::unexpected(errno);
+    }
+  }
+  auto built = build_listing(key);
+  if (!built || watch < 0) {
+    return built;
+  }
+
+  std::lock_guard lock{mutex_};
+  // Si entretanto otro hilo ha recogido eventos, alguno puede ser de este directorio (y puede
+  // haber quitado ya el vigilante): no se guarda, y el vigilante solo sigue si otro índice lo usa
+  if (generation_.load(std::memory_order_acquire) != generation) {
+    if (!watches_.contains(watch)) {
+      inotify_rm_watch(inotify_.get(), watch);
+    }
+    return built;
+  }
+  std::vector<std::string>& paths = watches_[watch];
+  if (std::find(paths.begin(), paths.end(), key) == paths.end()) {
+    paths.push_back(key);
+  }
+  index_.insert_or_assign(std::move(key), built.value());
+  return built;
+}
+
+size_t ListingCache::entries() const {
+  std::shared_lock lock{mutex_};
+  return index_.size();
+}
+
+/// @brief Recoge los eventos pendientes de inotify y descarta los índices afectados
+void ListingCache::drain_events() {
+  alignas(inotify_event) char buffer[4096];
+  while (true) {
+    ssize_t length = read(inotify_.get(), buffer, sizeof(buffer));
+    if (length <= 0) {
+      return; // EAGAIN: ningún directorio indexado ha cambiado
+    }
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+    std::lock_guard lock{mutex_};
+    for (ssize_t position = 0; position < length;) {
+      const auto* event = reinterpret_cast<const inotify_event*>(buffer + position);
+      position += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+      if ((event->mask & IN_Q_OVERFLOW) != 0) {
+        // Se han perdido eventos: ningún índice es fiable
+        invalidations_.fetch_add(index_.size(), std::memory_order_relaxed);
+        index_.clear();
+        while (!watches_.empty()) {
+          drop_watch(watches_.begin()->first);
+        }
+        continue;
+      }
+      auto watched = watches_.find(event->wd);
+      if (watched == watches_.end()) {
+        continue; // Incluido el IN_IGNORED de un vigilante ya quitado
+      }
+      for (const std::string& path : watched->second) {
+        invalidations_.fetch_add(index_.erase(path), std::memory_order_relaxed);
+      }
+      drop_watch(event->wd);
+    }
+    // Quien haya puesto un vigilante antes de quitarlo aquí (el kernel devuelve el mismo para
+    // el mismo directorio) ve otra generación y no guarda un índice que ya nadie vigila
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+  }
+}
+
+/// @brief Quita un vigilante cuyos índices ya se descartaron (con mutex_ tomado). Si el kernel
+/// ya lo quitó (directorio borrado o desmontado) inotify_rm_watch falla sin más
+void ListingCache::drop_watch(int watch) {
+  inotify_rm_watch(inotify_.get(), watch);
+  watches_.erase(watch);
+}
+
+std::expected<uint64_t, int> send_listing(const SafeFD& socket, const ListingCache::listing& found) {
+  // MSG_MORE: la cabecera sale en el mismo segmento que el principio del índice
+  if (send(socket.get(), found.header.data(), found.header.size(), MSG_MORE | MSG_NOSIGNAL) < 0) {
+    return std::unexpected(errno);
+  }
+  off_t offset = 0;
+  uint64_t remaining = found.size + 1;
+  while (remaining > 0) {
+    ssize_t sent = sendfile(socket.get(), found.content.get(), &offset, remaining);
+    if (sent < 0) {
+      return std::unexpected(errno);
+    }
+    if (sent == 0) {
+      return std::unexpected(EIO);
+    }
+    remaining -= static_cast<uint64_t>(sent);
+  }
+  return found.size;
+}
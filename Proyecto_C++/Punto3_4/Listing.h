@@ -0,0 +1,93 @@
+#ifndef LISTING_H
+#define LISTING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "SafeFD.h"
+#include "PathHash.h"
+
+// Índices de directorio (docserver --listings): al pedir un directorio se responde con sus
+// entradas, una por línea y en orden, con '/' detrás de los subdirectorios.
+//
+// El índice se construye leyendo el directorio con getdents64() en bloques grandes (el tipo de
+// cada entrada viene en d_type, sin un stat() por entrada) y se guarda ya formateado en un
+// memfd sellado, que se envía con sendfile() como los documentos de --archive. Cada directorio
+// indexado tiene un vigilante inotify: cualquier alta, baja o renombrado dentro de él descarta
+// su índice y quita el vigilante, y la siguiente petición lo vuelve a construir. Los eventos se
+// recogen sin hilo propio, al principio de cada búsqueda (una lectura no bloqueante del
+// descriptor inotify).
+//
+// Cada índice guardado retiene un descriptor (su memfd), así que cuántos se guardan depende de
+// RLIMIT_NOFILE: como mucho una cuarta parte del límite, y el resto queda para las conexiones,
+// los documentos y las tuberías de los programas. Con la caché llena los índices se construyen
+// igual pero no se guardan.
+class ListingCache
+{
+  public:
+    static constexpr size_t max_listings = 4096;   // Directorios indexados a la vez, como mucho
+
+    // Índice ya formateado: válido mientras se tenga el puntero, aunque se descarte de la caché
+    struct listing {
+      SafeFD content;              // memfd sellado: nombres y '\n' final de la respuesta
+      std::string header;          // Cabecera precalculada
+      uint64_t size;               // Bytes de nombres (sin el '\n' final)
+      size_t entries;
+    };
+
+    ListingCache();
+    ListingCache(const ListingCache&) = delete;
+    ListingCache& operator=(const ListingCache&) = delete;
+
+    [[nodiscard]] bool is_valid() const noexcept
+    {
+      return inotify_.is_valid();
+    }
+
+    /// @brief Índice de un directorio, de la caché o construido ahora
+    /// @param path Ruta del directorio en disco (con o sin '/' final)
+    /// @return Índice o errno (ENOENT, EACCES, ENOTDIR...); EACCES si la ruta tiene "." o ".."
+    std::expected<std::shared_ptr<const listing>, int> find(std::string_view path);
+
+    /// @brief Directorios con el índice en caché
+    [[nodiscard]] size_t entries() const;
+
+    /// @brief Directorios que caben en la caché con el límite de descriptores del proceso
+    [[nodiscard]] size_t capacity() const noexcept
+    {
+      return capacity_;
+    }
+
+    /// @brief Índices descartados por cambios en su directorio
+    [[nodiscard]] size_t invalidations() const noexcept
+    {
+      return invalidations_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    void drain_events();
+    void drop_watch(int watch);
+
+    SafeFD inotify_;
+    size_t capacity_;
+    mutable std::shared_mutex mutex_;
+    path_map<std::shared_ptr<const listing>> index_;
+    std::unordered_map<int, std::vector<std::string>> watches_;   // Vigilante -> rutas que lo usan
+    std::atomic<uint64_t> generation_{0};                         // Cambia con cada lote de eventos
+    std::atomic<size_t> invalidations_{0};
+};
+
+/// @brief Envía un índice: cabecera precalculada y contenido con sendfile()
+/// @param socket Socket del cliente
+/// @param found Índice obtenido con ListingCache::find
+/// @return Bytes de nombres enviados o errno
+std::expected<uint64_t, int> send_listing(const SafeFD& socket, const ListingCache::listing& found);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef PATH_HASH_H
+#define PATH_HASH_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Hash de rutas para las tablas indexadas por ruta (ContentCache, ListingCache, HotSet): con
+// is_transparent y std::equal_to<> se busca con un std::string_view sin construir un std::string
+struct path_hash {
+  using is_transparent = void;
+  size_t operator()(std::string_view path) const noexcept
+  {
+    return std::hash<std::string_view>{}(path);
+  }
+};
+
+// Tabla de ruta -> T que admite búsquedas por std::string_view
+template <typename T>
+using path_map = std::unordered_map<std::string, T, path_hash, std::equal_to<>>;
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <netinet/in.h>
+
+// Límite de peticiones por dirección IP (docserver --rate-static / --rate-cgi): un cubo de
+// fichas por cliente y por carril que se rellena a ritmo constante; cada petición gasta una
+// ficha (un lote, una por documento, de una vez) y sin fichas se rechaza. Así un solo cliente
+// no puede acaparar el servidor ni lanzar un programa de /bin/ tras otro.
+//
+// Los cubos viven en una tabla de tamaño fijo (sondeo lineal corto), una línea de caché por
+// cliente, y se actualizan solo con CAS: no hay cerrojo global. Si los huecos de un cliente
+// están todos ocupados, la petición se deja pasar (y se cuenta) en lugar de penalizar a nadie.
+// Cada cierto tiempo un hilo, el primero que lo nota, libera los clientes inactivos cuyo cubo
+// ya estaría lleno de nuevo.
+class RateLimiter
+{
+  public:
+    enum class lane { statics, cgi };
+
+    static constexpr size_t table_size = 4096;   // Clientes distintos a la vez
+    static constexpr size_t max_probe = 8;       // Huecos que se miran por cliente
+
+    /// @brief Crea la tabla
+    /// @param static_rate Peticiones por segundo y cliente a rutas no CGI (0: sin límite)
+    /// @param cgi_rate Peticiones por segundo y cliente a /bin/ (0: sin límite)
+    /// @param burst_seconds Capacidad del cubo en segundos de ritmo (hasta 65535 fichas)
+    explicit RateLimiter(uint32_t static_rate, uint32_t cgi_rate, uint32_t burst_seconds = 1)
+      : rates_{static_rate, cgi_rate},
+        capacities_{std::min(uint64_t{static_rate} * burst_seconds * one_token, token_mask),
+                    std::min(uint64_t{cgi_rate} * burst_seconds * one_token, token_mask)},
+        idle_ms_{static_cast<uint64_t>(burst_seconds) * 1000 + sweep_interval_ms},
+        slots_{std::make_unique<slot[]>(table_size)},
+        start_{std::chrono::steady_clock::now()}
+    {
+    }
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    /// @brief Gasta fichas del cliente en un carril, todas o ninguna
+    /// @param address Dirección IPv4 del cliente (orden de red)
+    /// @param kind Carril de la petición
+    /// @param cost Fichas que cuesta la petición (un lote, una por documento). Si supera la
+    /// capacidad del cubo se cobra el cubo entero: así un lote grande vacía el cubo en lugar de
+    /// rechazarse siempre
+    /// @return false si el cliente no tiene fichas suficientes (y entonces no gasta ninguna)
+    [[nodiscard]] bool try_take(in_addr_t address, lane kind, uint64_t cost = 1) noexcept
+    {
+      size_t index = static_cast<size_t>(kind);
+      if (rates_[index] == 0) {
+        return true;
+      }
+      uint64_t now = now_ms();
+      if (now - last_sweep_.load(std::memory_order_relaxed) >= sweep_interval_ms) {
+        sweep(now);
+      }
+      std::atomic<uint64_t>* states = find(address);
+      if (states == nullptr) {
+        overflowed_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+      // Estado: instante del último relleno (ms, 40 bits) y fichas en 1/256 (24 bits)
+      std::atomic<uint64_t>& state = states[index];
+      uint64_t price = std::min(cost * one_token, capacities_[index]);
+      uint64_t current = state.load(std::memory_order_relaxed);
+      uint64_t updated;
+      do {
+        uint64_t last = current >> 24;
+        uint64_t tokens = current & token_mask;
+        // Más allá de idle_ms_ el cubo ya estaría lleno: se acota para no desbordar
+        uint64_t elapsed = std::min(now - last, idle_ms_);
+        tokens = last == 0 ? capacities_[index]
+                           : std::min(capacities_[index], tokens + elapsed * rates_[index] * one_token / 1000);
+        if (tokens < price) {
+          rejected_.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        }
+        updated = now << 24 | (tokens - price);
+      } while (!state.compare_exchange_weak(current, updated, std::memory_order_relaxed));
+      return true;
+    }
+
+    /// @brief Peticiones rechazadas por falta de fichas
+    [[nodiscard]] size_t rejected() const noexcept
+    {
+      return rejected_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Peticiones que pasaron sin límite porque la tabla estaba llena
+    [[nodiscard]] size_t overflowed() const noexcept
+    {
+      return overflowed_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Clientes con cubo en la tabla
+    [[nodiscard]] size_t clients() const noexcept
+    {
+      size_t count = 0;
+      for (size_t i = 0; i < table_size; ++i) {
+        count += slots_[i].address.load(std::memory_order_relaxed) != 0;
+      }
+      return count;
+    }
+
+  private:
+    static constexpr uint64_t one_token = 256;
+    static constexpr uint64_t token_mask = (uint64_t{1} << 24) - 1;
+    static constexpr uint64_t sweep_interval_ms = 5000;
+
+    // Un cliente por línea de caché: los clientes distintos no se estorban entre sí
+    struct alignas(64) slot {
+      std::atomic<in_addr_t> address{0};   // 0 si el hueco está libre (0.0.0.0 no se conecta)
+      std::atomic<uint64_t> states[2]{};   // Cubo de cada carril
+    };
+
+    /// @brief Milisegundos desde la creación, empezando en 1 (0 marca un cubo sin usar)
+    [[nodiscard]] uint64_t now_ms() const noexcept
+    {
+      auto elapsed = std::chrono::steady_clock::now() - start_;
+      return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) + 1;
+    }
+
+    /// @brief Hueco del cliente (ocupando uno libre si no tenía)
+    /// @return Cubos del cliente o nullptr si sus huecos están ocupados por otros
+    std::atomic<uint64_t>* find(in_addr_t address) noexcept
+    {
+      // Mezcla de Fibonacci: las direcciones consecutivas quedan repartidas por la tabla
+      size_t start = static_cast<size_t>((uint64_t{address} * 0x9e3779b97f4a7c15) >> 32);
+      // Primero su hueco, si ya tiene uno: al liberarse un hueco anterior al suyo, ocupar el
+      // primero libre le daría un segundo cubo lleno
+      for (size_t probe = 0; probe < max_probe; ++probe) {
+        slot& candidate = slots_[(start + probe) & (table_size - 1)];
+        if (candidate.address.load(std::memory_order_acquire) == address) {
+          return candidate.states;
+        }
+      }
+      for (size_t probe = 0; probe < max_probe; ++probe) {
+        slot& candidate = slots_[(start + probe) & (table_size - 1)];
+        in_addr_t owner = candidate.address.load(std::memory_order_acquire);
+        if (owner == 0 && candidate.address.compare_exchange_strong(owner, address, std::memory_order_acq_rel)) {
+          owner = address;
+        }
+        if (owner == address) {
+          return candidate.states;
+        }
+      }
+      return nullptr;
+    }
+
+    /// @brief Libera los huecos de los clientes inactivos. Sus cubos se quedan como estaban: el
+    /// siguiente cliente los ve tan antiguos que los rellena enteros al primer uso.
+    void sweep(uint64_t now) noexcept
+    {
+      uint64_t last = last_sweep_.load(std::memory_order_relaxed);
+      if (now - last < sweep_interval_ms || !last_sweep_.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        return;
+      }
+      for (size_t i = 0; i < table_size; ++i) {
+        slot& candidate = slots_[i];
+        in_addr_t owner = candidate.address.load(std::memory_order_relaxed);
+        if (owner == 0) {
+          continue;
+        }
+        uint64_t newest = std::max(candidate.states[0].load(std::memory_order_relaxed) >> 24,
+                                   candidate.states[1].load(std::memory_order_relaxed) >> 24);
+        if (newest + idle_ms_ <= now) {
+          candidate.address.compare_exchange_strong(owner, 0, std::memory_order_relaxed);
+        }
+      }
+    }
+
+    uint64_t rates_[2];
+    uint64_t capacities_[2];
+    uint64_t idle_ms_;
+    std::unique_ptr<slot[]> slots_;
+    std::chrono::steady_clock::time_point start_;
+    std::atomic<uint64_t> last_sweep_{1};
+    std::atomic<size_t> rejected_{0};
+    std::atomic<size_t> overflowed_{0};
+};
+
+#endif
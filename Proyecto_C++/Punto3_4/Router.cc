@@ -0,0 +1,198 @@
+#include "Router.h"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <utility>
+#include <dlfcn.h>
+#include <unistd.h>
+
+// Nodo del árbol sin comprimir que se usa solo durante la compilación
+struct build_node
+{
+  std::map<char, std::unique_ptr<build_node>> children;
+  int32_t route = -1;
+};
+
+/// @brief Compila una tabla de rutas
+/// @param routes Rutas (los prefijos deben empezar por '/' y no repetirse)
+/// @return Router o error (con la posición de la ruta, empezando en 1)
+std::expected<Router, route_error> Router::compile(std::vector<route> routes) {
+  build_node root;
+  for (size_t i = 0; i < routes.size(); ++i) {
+    const std::string& prefix = routes[i].prefix;
+    if (prefix.empty() || prefix[0] != '/') {
+      return std::unexpected(route_error{i + 1, "el prefijo " + prefix + " no empieza por '/'"});
+    }
+    build_node* current = &root;
+    for (char c : prefix) {
+      auto& child = current->children[c];
+      if (!child) {
+        child = std::make_unique<build_node>();
+      }
+      current = child.get();
+    }
+    if (current->route >= 0) {
+      return std::unexpected(route_error{i + 1, "el prefijo " + prefix + " está repetido"});
+    }
+    current->route = static_cast<int32_t>(i);
+  }
+
+  // Aplanar por niveles: cada nodo reserva un bloque contiguo para sus hijos, y las cadenas
+  // de nodos con un único hijo y sin ruta se funden en una sola etiqueta
+  Router router;
+  router.routes_ = std::move(routes);
+  router.nodes_.push_back({0, 0, 0, 0, root.route});
+  router.first_bytes_.push_back('\0');
+  std::vector<std::pair<const build_node*, uint32_t>> queue{{&root, 0}};
+  for (size_t next = 0; next < queue.size(); ++next) {
+    auto [current, index] = queue[next];
+    uint32_t first_child = static_cast<uint32_t>(router.nodes_.size());
+    router.nodes_[index].first_child = first_child;
+    router.nodes_[index].child_count = static_cast<uint16_t>(current->children.size());
+    for (const auto& [c, child] : current->children) {
+      const build_node* end = child.get();
+      uint32_t label_offset = static_cast<uint32_t>(router.labels_.size());
+      router.labels_.push_back(c);
+      while (end->route < 0 && end->children.size() == 1 && router.labels_.size() - label_offset < UINT16_MAX) {
+        router.labels_.push_back(end->children.begin()->first);
+        end = end->children.begin()->second.get();
+      }
+      uint32_t child_index = static_cast<uint32_t>(router.nodes_.size());
+      router.nodes_.push_back({label_offset, static_cast<uint16_t>(router.labels_.size() - label_offset), 0, 0, end->route});
+      router.first_bytes_.push_back(c);
+      queue.emplace_back(end, child_index);
+    }
+  }
+  return router;
+}
+
+/// @brief Comprueba que una ruta relativa no sale de su raíz con segmentos ".."
+/// @param relative Ruta (las barras iniciales, repetidas y los "." no cuentan como segmentos)
+/// @return true si ningún ".." sube por encima del punto de partida
+bool stays_below(std::string_view relative) noexcept {
+  size_t depth = 0;
+  while (!relative.empty()) {
+    std::string_view segment = relative.substr(0, relative.find('/'));
+    relative.remove_prefix(std::min(relative.size(), segment.size() + 1));
+    if (segment == "..") {
+      if (depth == 0) {
+        return false;
+      }
+      --depth;
+    } else if (!segment.empty() && segment != ".") {
+      ++depth;
+    }
+  }
+  return true;
+}
+
+/// @brief Busca la ruta de prefijo más largo que casa con la ruta pedida
+/// @param path Ruta pedida
+/// @return Ruta y resto de la ruta pedida, o nada si ninguna casa (o el resto se sale de ella)
+std::optional<route_match> Router::find(std::string_view path) const noexcept {
+  std::optional<route_match> best;
+  uint32_t index = 0;
+  size_t position = 0;
+  while (true) {
+    const node& current = nodes_[index];
+    if (current.route >= 0) {
+      const route& candidate = routes_[static_cast<size_t>(current.route)];
+      // Un prefijo sin '/' final solo casa si la ruta sigue con un nuevo segmento o termina
+      if (candidate.prefix.back() == '/' || position == path.size() || path[position] == '/') {
+        best = route_match{&candidate, path.substr(position)};
+      }
+    }
+    if (position == path.size() || current.child_count == 0) {
+      break;
+    }
+    const char* first = first_bytes_.data() + current.first_child;
+    const char* found = std::find(first, first + current.child_count, path[position]);
+    if (found == first + current.child_count) {
+      break;
+    }
+    index = current.first_child + static_cast<uint32_t>(found - first);
+    const node& child = nodes_[index];
+    std::string_view label{labels_.data() + child.label_offset, child.label_length};
+    if (path.substr(position, label.size()) != label) {
+      break;
+    }
+    position += label.size();
+  }
+  // El resto se añade al destino de la ruta: no puede llevar fuera de él
+  if (best && !stays_below(best->remainder)) {
+    return std::nullopt;
+  }
+  return best;
+}
+
+/// @brief Lee y compila un archivo de rutas
+/// Cada línea es "tipo prefijo destino"; las líneas vacías y las que empiezan por '#' se ignoran.
+///   static   /docs/   /srv/docs/     archivos bajo /srv/docs
+///   cgi      /bin/    /srv/bin/      programas de /srv/bin
+///   plugin   /hola    ./hola.so      biblioteca con docserver_plugin
+///   internal /status  status         estado del servidor (status | routes)
+/// @param path Archivo de rutas
+/// @return Router o error con el número de línea
+std::expected<Router, route_error> Router::load(const std::string& path) {
+  std::ifstream input{path};
+  if (!input) {
+    return std::unexpected(route_error{0, "no se puede abrir " + path});
+  }
+  std::vector<route> routes;
+  std::vector<size_t> lines;
+  std::string line;
+  for (size_t number = 1; std::getline(input, line); ++number) {
+    std::istringstream fields{line};
+    std::string kind, prefix, target, extra;
+    if (!(fields >> kind) || kind[0] == '#') {
+      continue;
+    }
+    if (!(fields >> prefix >> target) || (fields >> extra)) {
+      return std::unexpected(route_error{number, "se esperaba \"tipo prefijo destino\""});
+    }
+    route entry{route_kind::static_files, prefix, target, nullptr};
+    if (kind == "static" || kind == "cgi") {
+      entry.kind = kind == "static" ? route_kind::static_files : route_kind::cgi;
+      if (access(target.c_str(), F_OK) == -1) {
+        return std::unexpected(route_error{number, "el directorio " + target + " no existe"});
+      }
+    } else if (kind == "plugin") {
+      entry.kind = route_kind::plugin;
+      // La biblioteca se queda cargada mientras viva el proceso
+      void* library = dlopen(target.c_str(), RTLD_NOW | RTLD_LOCAL);
+      void* symbol = library != nullptr ? dlsym(library, "docserver_plugin") : nullptr;
+      if (symbol == nullptr) {
+        return std::unexpected(route_error{number, std::string{"plugin no válido: "} + dlerror()});
+      }
+      entry.plugin = reinterpret_cast<plugin_handler>(symbol);
+    } else if (kind == "internal") {
+      entry.kind = route_kind::internal;
+      if (target != "status" && target != "routes") {
+        return std::unexpected(route_error{number, "manejador interno desconocido: " + target});
+      }
+    } else {
+      return std::unexpected(route_error{number, "tipo de ruta desconocido: " + kind});
+    }
+    routes.push_back(std::move(entry));
+    lines.push_back(number);
+  }
+  auto router = compile(std::move(routes));
+  if (!router) {
+    // Traducir la posición de la ruta a su línea en el archivo
+    return std::unexpected(route_error{lines[router.error().line - 1], router.error().message});
+  }
+  return router;
+}
+
+/// @brief Tabla por defecto: /bin/ ejecuta programas de base/bin y el resto se lee de base
+/// @param base Directorio base
+/// @return Router
+Router Router::defaults(const std::string& base) {
+  std::vector<route> routes{
+    {route_kind::cgi, "/bin/", base + "/bin/", nullptr},
+    {route_kind::static_files, "/", base + "/", nullptr},
+  };
+  return std::move(compile(std::move(routes)).value());
+}
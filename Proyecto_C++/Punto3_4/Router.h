@@ -0,0 +1,99 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Tipo de manejador asociado a una ruta
+enum class route_kind
+{
+  static_files, // Archivos bajo un directorio raíz
+  cgi,          // Programas de un directorio, ejecutados con execute_program
+  plugin,       // Función de una biblioteca dinámica cargada al arrancar
+  internal      // Respuesta generada por el propio servidor (status, routes)
+};
+
+// Interfaz de los plugins: la biblioteca exporta
+//   extern "C" int docserver_plugin(const char* request_path, const char* remainder,
+//                                   plugin_append append, void* context);
+// que escribe el cuerpo llamando a append(context, datos, tamaño) y devuelve 0 o un errno.
+using plugin_append = void (*)(void* context, const char* data, size_t size);
+using plugin_handler = int (*)(const char* request_path, const char* remainder, plugin_append append, void* context);
+
+struct route
+{
+  route_kind kind;
+  std::string prefix;   // Empieza por '/'; si no acaba en '/', solo casa en un límite de segmento
+  std::string target;   // Raíz (static, cgi), biblioteca (plugin) o nombre (internal)
+  plugin_handler plugin = nullptr;
+};
+
+struct route_match
+{
+  const route* matched;
+  std::string_view remainder; // Parte de la ruta pedida posterior al prefijo
+};
+
+struct route_error
+{
+  size_t line;          // Línea del archivo de rutas o posición en la tabla (0 si no aplica)
+  std::string message;
+};
+
+/// @brief Comprueba que una ruta relativa no sale de su raíz: recorriendo sus segmentos, los ".."
+/// nunca deshacen más segmentos de los que ya se han bajado ("a/../b" sí; "../b" o "a/../../b" no)
+[[nodiscard]] bool stays_below(std::string_view relative) noexcept;
+
+// Tabla de rutas compilada en un árbol radix plano: los nodos (16 bytes) están en un único
+// vector con los hijos de cada nodo contiguos, y el primer carácter de cada etiqueta en un
+// array paralelo. Elegir el hijo es recorrer unos pocos bytes seguidos, y la búsqueda toca
+// tantos nodos como segmentos distintos tiene la ruta, no tantos como rutas hay en la tabla.
+class Router
+{
+  public:
+    Router(const Router&) = delete;
+    Router& operator=(const Router&) = delete;
+    Router(Router&&) noexcept = default;
+    Router& operator=(Router&&) noexcept = default;
+
+    /// @brief Compila una tabla de rutas
+    static std::expected<Router, route_error> compile(std::vector<route> routes);
+
+    /// @brief Lee y compila un archivo de rutas (líneas "tipo prefijo destino")
+    static std::expected<Router, route_error> load(const std::string& path);
+
+    /// @brief Tabla por defecto, equivalente al comportamiento original: /bin/ ejecuta y el resto se lee
+    static Router defaults(const std::string& base);
+
+    /// @brief Busca la ruta de prefijo más largo que casa con la ruta pedida; no casa ninguna si
+    /// el resto de la ruta sube por encima del prefijo con segmentos ".."
+    [[nodiscard]] std::optional<route_match> find(std::string_view path) const noexcept;
+
+    [[nodiscard]] const std::vector<route>& routes() const noexcept
+    {
+      return routes_;
+    }
+
+  private:
+    explicit Router() noexcept = default;
+
+    struct node
+    {
+      uint32_t label_offset;
+      uint16_t label_length;
+      uint16_t child_count;
+      uint32_t first_child;
+      int32_t route;        // Índice en routes_ o -1
+    };
+
+    std::vector<node> nodes_;
+    std::string first_bytes_; // first_bytes_[i] == primer carácter de la etiqueta del nodo i
+    std::string labels_;
+    std::vector<route> routes_;
+};
+
+#endif
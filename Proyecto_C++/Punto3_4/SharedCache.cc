@@ -0,0 +1,361 @@
+#include "SharedCache.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <vector>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Los bloques se cuentan en unidades de 64 bytes desde el principio de la región: 32 bits
+// alcanzan para 256 GiB
+static constexpr size_t block_unit = 64;
+static constexpr size_t size_classes = 32;
+static constexpr size_t huge_page = size_t{2} << 20;
+
+struct SharedCache::region_header {
+  struct alignas(64) reader_slot {
+    std::atomic<uint32_t> owner;     // tid del hilo que la ocupa o 0
+    std::atomic<uint64_t> epoch;     // Época anunciada al empezar a leer o 0 si no lee
+  };
+
+  uint64_t bucket_count;
+  uint64_t data_offset;              // Principio de la zona de datos
+  std::atomic<uint64_t> epoch;       // Época global, avanza con cada retirada
+  std::atomic<uint64_t> cursor;      // Siguiente byte sin repartir de la zona de datos
+  std::atomic<uint64_t> entries;
+  std::atomic<uint64_t> free_lists[size_classes];  // Contador (32 bits) y primer bloque libre (32)
+  reader_slot readers[max_readers];
+};
+
+struct SharedCache::entry {
+  uint64_t device;
+  uint64_t inode;
+  uint64_t size;
+  int64_t changed_sec;               // ctime: cambia al escribir y también con chmod
+  int64_t changed_nsec;
+  uint32_t size_class;
+  uint16_t path_size;
+  uint8_t header_size;
+  char header[max_header];
+  // Siguen la ruta y el contenido
+
+  [[nodiscard]] std::string_view path() const noexcept
+  {
+    return {reinterpret_cast<const char*>(this + 1), path_size};
+  }
+};
+
+// Ranura de lector del hilo actual
+struct thread_reader {
+  const void* region = nullptr;      // Caché a la que pertenece la ranura
+  std::atomic<uint32_t>* owner = nullptr;
+  std::atomic<uint64_t>* epoch = nullptr;
+  // Épocas de las secciones de lectura abiertas en el hilo, de menor a mayor (la época global
+  // solo avanza, así que basta con añadir al final)
+  std::vector<uint64_t> open;
+
+  void release() noexcept
+  {
+    if (owner != nullptr) {
+      epoch->store(0);
+      owner->store(0);
+    }
+    region = nullptr;
+    owner = nullptr;
+    epoch = nullptr;
+    open.clear();
+  }
+  ~thread_reader()
+  {
+    release();
+  }
+};
+
+static thread_local thread_reader current_reader;
+
+/// @brief Clase de tamaño de un bloque: 0 para 256 bytes, 1 para 512...
+static size_t size_class(size_t size) {
+  return static_cast<size_t>(std::bit_width(std::max(size, SharedCache::min_block) - 1)) -
+         static_cast<size_t>(std::bit_width(SharedCache::min_block - 1));
+}
+
+static uint64_t path_hash(std::string_view path) {
+  return std::hash<std::string_view>{}(path);
+}
+
+SharedCache::Reader::Reader(const SharedCache& cache) noexcept : cache_{&cache} {
+  thread_reader& slot = current_reader;
+  if (slot.region != cache.header_) {
+    // Cada hilo lee de una sola caché a la vez
+    if (!slot.open.empty()) {
+      cache_ = nullptr;
+      return;
+    }
+    slot.release();
+    uint32_t self = static_cast<uint32_t>(gettid());
+    for (region_header::reader_slot& reader : cache.header_->readers) {
+      uint32_t expected = 0;
+      if (reader.owner.compare_exchange_strong(expected, self)) {
+        slot.region = cache.header_;
+        slot.owner = &reader.owner;
+        slot.epoch = &reader.epoch;
+        break;
+      }
+    }
+    if (slot.region == nullptr) {
+      cache_ = nullptr;
+      return;
+    }
+  }
+  // Una época anunciada con retraso solo hace que se espere de más para reutilizar un bloque
+  epoch_ = cache.header_->epoch.load();
+  if (slot.open.empty()) {
+    slot.epoch->store(epoch_);
+  }
+  slot.open.push_back(epoch_);
+}
+
+SharedCache::Reader::~Reader() {
+  if (cache_ == nullptr) {
+    return;
+  }
+  // Al cerrarse la más antigua se anuncia la siguiente: las secciones abiertas después no
+  // retienen lo retirado antes de empezar
+  std::vector<uint64_t>& open = current_reader.open;
+  auto own = std::find(open.begin(), open.end(), epoch_);
+  if (own == open.end()) {
+    return; // La caché ya se destruyó en este hilo
+  }
+  bool oldest = own == open.begin();
+  open.erase(own);
+  if (open.empty()) {
+    current_reader.epoch->store(0);
+  } else if (oldest) {
+    current_reader.epoch->store(open.front());
+  }
+}
+
+SharedCache::SharedCache(size_t capacity, size_t max_file) : max_file_{max_file} {
+  size_t bucket_count = std::bit_ceil(std::max<size_t>(capacity / 4096, 1024));
+  size_t data_offset = (sizeof(region_header) + bucket_count * sizeof(uint64_t) + block_unit - 1) / block_unit * block_unit;
+  size_t size = (data_offset + capacity + huge_page - 1) / huge_page * huge_page;
+  if (size / block_unit > std::numeric_limits<uint32_t>::max()) {
+    errno = EINVAL;
+    return;
+  }
+
+  // Páginas enormes reservadas por el administrador; si no hay bastantes, mmap falla al
+  // reservarlas y se usa memoria compartida normal con páginas enormes transparentes
+  void* region = MAP_FAILED;
+  for (unsigned int flags : {MFD_CLOEXEC | MFD_HUGETLB, unsigned{MFD_CLOEXEC}}) {
+    SafeFD memfd{memfd_create("docserver-cache", flags)};
+    if (!memfd.is_valid() || ftruncate(memfd.get(), static_cast<off_t>(size)) < 0) {
+      continue;
+    }
+    region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd.get(), 0);
+    if (region != MAP_FAILED) {
+      memfd_ = std::move(memfd);
+      backing_ = (flags & MFD_HUGETLB) != 0 ? backing::hugetlb : backing::none;
+      break;
+    }
+  }
+  if (region == MAP_FAILED) {
+    return;
+  }
+  base_ = static_cast<char*>(region);
+  size_ = size;
+  if (backing_ == backing::none && madvise(base_, size_, MADV_HUGEPAGE) == 0) {
+    backing_ = backing::transparent;
+  }
+
+  // La región recién creada está a cero: los átomos empiezan vacíos
+  header_ = new (base_) region_header{};
+  header_->bucket_count = bucket_count;
+  header_->data_offset = data_offset;
+  header_->epoch.store(1);
+  header_->cursor.store(data_offset);
+  buckets_ = reinterpret_cast<std::atomic<uint64_t>*>(base_ + sizeof(region_header));
+  std::uninitialized_value_construct_n(buckets_, bucket_count);
+}
+
+SharedCache::~SharedCache() {
+  if (base_ == nullptr) {
+    return;
+  }
+  if (current_reader.region == header_) {
+    current_reader.release();
+  }
+  munmap(base_, size_);
+}
+
+const SharedCache::entry* SharedCache::entry_at(uint64_t word) const noexcept {
+  return reinterpret_cast<const entry*>(base_ + (word & 0xffffffff) * block_unit);
+}
+
+SharedCache::document SharedCache::view(const entry& found) const noexcept {
+  return {{found.header, found.header_size}, {found.path().data() + found.path_size, found.size}};
+}
+
+std::optional<SharedCache::document> SharedCache::find(const Reader& reader, std::string_view path,
+                                                       const struct stat& status) const {
+  if (reader.cache_ != this) {
+    return std::nullopt;
+  }
+  uint64_t hash = path_hash(path);
+  uint64_t tag = hash >> 32;
+  size_t mask = header_->bucket_count - 1;
+  for (size_t probe = 0, bucket = hash & mask; probe <= mask; ++probe, bucket = (bucket + 1) & mask) {
+    uint64_t word = buckets_[bucket].load();
+    if (word == 0) {
+      return std::nullopt;
+    }
+    if ((word >> 32) != tag) {
+      continue;
+    }
+    const entry& found = *entry_at(word);
+    if (found.path() != path) {
+      continue;
+    }
+    if (found.device != status.st_dev || found.inode != status.st_ino ||
+        found.size != static_cast<uint64_t>(status.st_size) || found.changed_sec != status.st_ctim.tv_sec ||
+        found.changed_nsec != status.st_ctim.tv_nsec) {
+      return std::nullopt;
+    }
+    return view(found);
+  }
+  return std::nullopt;
+}
+
+std::optional<SharedCache::document> SharedCache::insert(const Reader& reader, std::string_view path, const struct stat& status,
+                                                         std::string_view header, std::string_view content) {
+  if (reader.cache_ != this || content.size() > max_file_ || header.size() > max_header ||
+      path.size() > std::numeric_limits<uint16_t>::max()) {
+    return std::nullopt;
+  }
+  size_t block_class = size_class(sizeof(entry) + path.size() + content.size());
+  if (block_class >= size_classes) {
+    return std::nullopt;
+  }
+  uint32_t block = allocate(block_class);
+  if (block == 0) {
+    return std::nullopt;
+  }
+
+  // La entrada se escribe entera antes de publicarla y ya no cambia
+  entry* created = new (base_ + block * block_unit) entry{};
+  created->device = status.st_dev;
+  created->inode = status.st_ino;
+  created->size = content.size();
+  created->changed_sec = status.st_ctim.tv_sec;
+  created->changed_nsec = status.st_ctim.tv_nsec;
+  created->size_class = static_cast<uint32_t>(block_class);
+  created->path_size = static_cast<uint16_t>(path.size());
+  created->header_size = static_cast<uint8_t>(header.size());
+  std::memcpy(created->header, header.data(), header.size());
+  char* data = reinterpret_cast<char*>(created + 1);
+  std::memcpy(data, path.data(), path.size());
+  std::memcpy(data + path.size(), content.data(), content.size());
+
+  uint64_t hash = path_hash(path);
+  uint64_t tag = hash >> 32;
+  uint64_t word = tag << 32 | block;
+  size_t mask = header_->bucket_count - 1;
+  for (size_t probe = 0, bucket = hash & mask; probe <= mask; ++probe, bucket = (bucket + 1) & mask) {
+    uint64_t current = buckets_[bucket].load();
+    // Un CAS fallido deja en current lo que haya ahora en el hueco y se vuelve a mirar
+    while (true) {
+      if (current == 0) {
+        if (buckets_[bucket].compare_exchange_weak(current, word)) {
+          header_->entries.fetch_add(1);
+          return view(*created);
+        }
+        continue;
+      }
+      if ((current >> 32) != tag || entry_at(current)->path() != path) {
+        break;
+      }
+      uint32_t replaced_class = entry_at(current)->size_class;
+      if (buckets_[bucket].compare_exchange_weak(current, word)) {
+        retire(static_cast<uint32_t>(current & 0xffffffff), replaced_class);
+        return view(*created);
+      }
+    }
+  }
+  // Índice lleno: la entrada no llegó a publicarse
+  release(block, block_class);
+  return std::nullopt;
+}
+
+size_t SharedCache::entries() const noexcept {
+  return header_->entries.load();
+}
+
+size_t SharedCache::used() const noexcept {
+  return header_->cursor.load() - header_->data_offset;
+}
+
+size_t SharedCache::pending() const {
+  std::lock_guard lock{limbo_mutex_};
+  return limbo_.size();
+}
+
+/// @brief Toma un bloque de la lista libre de su clase o, si está vacía, de la zona sin repartir
+/// @return Bloque o 0 si la región está llena
+uint32_t SharedCache::allocate(size_t block_class) {
+  std::atomic<uint64_t>& free_list = header_->free_lists[block_class];
+  uint64_t head = free_list.load();
+  while ((head & 0xffffffff) != 0) {
+    uint32_t block = static_cast<uint32_t>(head & 0xffffffff);
+    // Si otro hilo se lleva el bloque a la vez, el siguiente leído es basura pero el contador
+    // del CAS ha cambiado y se reintenta
+    uint32_t next = std::atomic_ref<uint32_t>{*reinterpret_cast<uint32_t*>(base_ + block * block_unit)}.load();
+    if (free_list.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | next)) {
+      return block;
+    }
+  }
+  size_t block_size = min_block << block_class;
+  uint64_t cursor = header_->cursor.load();
+  do {
+    if (cursor + block_size > size_) {
+      return 0;
+    }
+  } while (!header_->cursor.compare_exchange_weak(cursor, cursor + block_size));
+  return static_cast<uint32_t>(cursor / block_unit);
+}
+
+/// @brief Devuelve un bloque que ya nadie puede estar leyendo a la lista libre de su clase
+void SharedCache::release(uint32_t block, size_t block_class) noexcept {
+  std::atomic<uint64_t>& free_list = header_->free_lists[block_class];
+  std::atomic_ref<uint32_t> next{*reinterpret_cast<uint32_t*>(base_ + block * block_unit)};
+  uint64_t head = free_list.load();
+  do {
+    next.store(static_cast<uint32_t>(head & 0xffffffff));
+  } while (!free_list.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | block));
+}
+
+/// @brief Aparta el bloque de una entrada sustituida hasta que terminen los lectores que
+/// pudieron verla, y libera los apartados antes cuyos lectores ya terminaron
+void SharedCache::retire(uint32_t block, size_t block_class) {
+  // Quien anuncie una época posterior leyó el índice después de la sustitución
+  uint64_t epoch = header_->epoch.fetch_add(1);
+  std::lock_guard lock{limbo_mutex_};
+  limbo_.push_back({block, static_cast<uint32_t>(block_class), epoch});
+  uint64_t oldest = std::numeric_limits<uint64_t>::max();
+  for (const region_header::reader_slot& reader : header_->readers) {
+    uint64_t announced = reader.epoch.load();
+    if (announced != 0) {
+      oldest = std::min(oldest, announced);
+    }
+  }
+  std::erase_if(limbo_, [&](const retired_block& retired) {
+    if (retired.epoch >= oldest) {
+      return false;
+    }
+    release(retired.block, retired.size_class);
+    return true;
+  });
+}
@@ -0,0 +1,148 @@
+#ifndef SHARED_CACHE_H
+#define SHARED_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+#include "SafeFD.h"
+
+// Caché compartida entre procesos (docserver --shared-cache con --processes): una región
+// memfd_create() mapeada con MAP_SHARED antes de crear los procesos de trabajo, de forma que un
+// documento que lee uno de ellos queda en caché para todos, con su cabecera ya formateada. Dentro
+// de la región solo hay desplazamientos, nunca punteros.
+//
+// El índice es una tabla de direccionamiento abierto (sondeo lineal) de palabras de 64 bits:
+// 32 bits del hash de la ruta y 32 del bloque de la entrada. Se escribe solo con CAS: una ruta
+// nueva ocupa un hueco vacío y una versión nueva de un documento sustituye a la palabra de la
+// anterior. Las rutas no se borran nunca, así que no hacen falta lápidas.
+//
+// Las entradas son inmutables una vez publicadas. La entrada sustituida se retira y su bloque
+// vuelve a una lista libre (pila de Treiber con contador contra ABA) cuando ningún lector pueda
+// estar usándola: recuperación por épocas, con una ranura por hilo lector en la propia región.
+class SharedCache
+{
+  public:
+    static constexpr size_t max_readers = 256;     // Hilos lectores a la vez, entre todos los procesos
+    static constexpr size_t min_block = 256;       // Bloque más pequeño (entrada, ruta y contenido)
+    static constexpr size_t max_header = 48;       // Cabecera precalculada más larga
+
+    enum class backing { none, hugetlb, transparent };
+
+    // Documento en caché: válido mientras viva el Reader con el que se obtuvo
+    struct document {
+      std::string_view header;
+      std::string_view content;
+    };
+
+    // Sección de lectura: mientras exista, ninguna entrada que se haya podido ver se reutiliza.
+    // Cada una guarda la época en la que empezó, y la ranura del hilo anuncia la más antigua de
+    // las que siguen abiertas en él: pueden solaparse en cualquier orden (con --async, una por
+    // conexión que está enviando) sin que la época quede fijada mientras haya alguna. La ranura
+    // del hilo se ocupa la primera vez y se libera al terminar el hilo (o al destruir la caché,
+    // si es el hilo que la destruye: los demás lectores deben haber terminado antes). Se
+    // destruye en el hilo que la creó.
+    class Reader
+    {
+      public:
+        explicit Reader(const SharedCache& cache) noexcept;
+        Reader(Reader&& other) noexcept : cache_{std::exchange(other.cache_, nullptr)}, epoch_{other.epoch_} {}
+        Reader& operator=(Reader&&) = delete;
+        Reader(const Reader&) = delete;
+        ~Reader();
+
+        /// @brief false si no quedaban ranuras de lector libres (se trata como un fallo de caché)
+        [[nodiscard]] bool is_valid() const noexcept
+        {
+          return cache_ != nullptr;
+        }
+
+      private:
+        friend class SharedCache;
+        const SharedCache* cache_;
+        uint64_t epoch_ = 0;           // Época anunciada al abrirla
+    };
+
+    /// @brief Crea la región (las páginas se ocupan al copiar los documentos)
+    /// @param capacity Tamaño de la región en bytes
+    /// @param max_file Tamaño máximo de un documento cacheado
+    explicit SharedCache(size_t capacity, size_t max_file);
+    SharedCache(const SharedCache&) = delete;
+    SharedCache& operator=(const SharedCache&) = delete;
+    ~SharedCache();
+
+    [[nodiscard]] bool is_valid() const noexcept
+    {
+      return base_ != nullptr;
+    }
+
+    /// @brief Cómo está respaldada la región
+    [[nodiscard]] backing pages() const noexcept
+    {
+      return backing_;
+    }
+
+    [[nodiscard]] size_t max_file() const noexcept
+    {
+      return max_file_;
+    }
+
+    /// @brief Busca un documento y comprueba que no ha cambiado en disco
+    /// @param reader Sección de lectura abierta en este hilo
+    /// @param path Ruta del documento
+    /// @param status stat() actual del documento
+    /// @return Documento o nada si no está o está obsoleto
+    [[nodiscard]] std::optional<document> find(const Reader& reader, std::string_view path, const struct stat& status) const;
+
+    /// @brief Copia un documento en la región y lo publica para todos los procesos
+    /// @param reader Sección de lectura abierta en este hilo
+    /// @param path Ruta del documento
+    /// @param status stat() del documento al leerlo
+    /// @param header Cabecera de la respuesta (como mucho max_header bytes)
+    /// @param content Contenido leído
+    /// @return Documento ya en la región o nada si no cabe
+    std::optional<document> insert(const Reader& reader, std::string_view path, const struct stat& status,
+                                   std::string_view header, std::string_view content);
+
+    /// @brief Documentos distintos en el índice (entre todos los procesos)
+    [[nodiscard]] size_t entries() const noexcept;
+
+    /// @brief Bytes de la zona de datos ya repartidos en bloques
+    [[nodiscard]] size_t used() const noexcept;
+
+    /// @brief Bloques retirados por este proceso que aún esperan a sus lectores
+    [[nodiscard]] size_t pending() const;
+
+  private:
+    struct region_header;
+    struct entry;
+
+    struct retired_block {
+      uint32_t block;
+      uint32_t size_class;
+      uint64_t epoch;                // Época en la que dejó de ser visible
+    };
+
+    [[nodiscard]] const entry* entry_at(uint64_t word) const noexcept;
+    [[nodiscard]] document view(const entry& found) const noexcept;
+    uint32_t allocate(size_t size_class);
+    void release(uint32_t block, size_t size_class) noexcept;
+    void retire(uint32_t block, size_t size_class);
+
+    SafeFD memfd_;
+    char* base_ = nullptr;
+    size_t size_ = 0;
+    size_t max_file_;
+    backing backing_ = backing::none;
+    region_header* header_ = nullptr;
+    std::atomic<uint64_t>* buckets_ = nullptr;
+    mutable std::mutex limbo_mutex_;
+    std::vector<retired_block> limbo_;
+};
+
+#endif
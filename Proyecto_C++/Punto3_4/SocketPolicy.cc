@@ -0,0 +1,59 @@
+#include "SocketPolicy.h"
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+/// @brief setsockopt() de un entero
+/// @return 0 o errno
+static int set_option(int fd, int level, int name, int value) {
+  return setsockopt(fd, level, name, &value, sizeof(value)) == 0 ? 0 : errno;
+}
+
+int configure_listener(const SafeFD& listener, const socket_policy& policy) {
+  int fd = listener.get();
+  int error = 0;
+  auto apply = [&error](int result) {
+    if (error == 0) {
+      error = result;
+    }
+  };
+  if (policy.send_buffer_kb != 0) {
+    apply(set_option(fd, SOL_SOCKET, SO_SNDBUF, policy.send_buffer_kb << 10));
+  }
+  if (policy.receive_buffer_kb != 0) {
+    apply(set_option(fd, SOL_SOCKET, SO_RCVBUF, policy.receive_buffer_kb << 10));
+  }
+
+  int domain = 0;
+  socklen_t length = sizeof(domain);
+  if (getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &domain, &length) < 0 || domain != AF_INET) {
+    return error; // Socket Unix: lo demás es de TCP
+  }
+  if (policy.defer_accept_s != 0) {
+    apply(set_option(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, policy.defer_accept_s));
+  }
+  if (policy.fastopen_queue != 0) {
+    apply(set_option(fd, IPPROTO_TCP, TCP_FASTOPEN, policy.fastopen_queue));
+  }
+  return error;
+}
+
+int configure_connection(const SafeFD& client, const socket_policy& policy, sa_family_t family) {
+  if (policy.nodelay && family == AF_INET) {
+    return set_option(client.get(), IPPROTO_TCP, TCP_NODELAY, 1);
+  }
+  return 0;
+}
+
+ResponseCork::ResponseCork(const SafeFD& client, const socket_policy& policy, sa_family_t family) noexcept
+  : fd_{policy.cork && family == AF_INET ? client.get() : -1} {
+  if (fd_ >= 0 && set_option(fd_, IPPROTO_TCP, TCP_CORK, 1) != 0) {
+    fd_ = -1;
+  }
+}
+
+ResponseCork::~ResponseCork() {
+  if (fd_ >= 0) {
+    set_option(fd_, IPPROTO_TCP, TCP_CORK, 0);
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef SOCKET_POLICY_H
+#define SOCKET_POLICY_H
+
+#include <sys/socket.h>
+#include "SafeFD.h"
+
+// Ajustes TCP de docserver (--defer-accept, --fastopen, --nodelay, --cork, --sndbuf, --rcvbuf).
+// Sin ninguna opción los sockets quedan como los deja el kernel y no se hace ninguna llamada
+// de más. Los ajustes TCP no se aplican a un socket Unix (--unix); los tamaños de búfer sí.
+//
+//   --defer-accept S  TCP_DEFER_ACCEPT: la conexión no se entrega a accept() hasta que llega la
+//                     petición (o pasan S segundos): ni un despertar ni un recv() que solo
+//                     devuelve EAGAIN por cada conexión, y los clientes que conectan y callan
+//                     no ocupan plazas de --max-conn.
+//   --fastopen N      TCP_FASTOPEN: la petición viaja en el propio SYN de los clientes que ya
+//                     tienen cookie, y la respuesta sale un viaje de ida y vuelta antes. Hace
+//                     falta además net.ipv4.tcp_fastopen con el bit 2 (p. ej. 3).
+//   --nodelay         TCP_NODELAY en cada conexión: sin Nagle, un trozo pequeño que sigue a
+//                     otro sin confirmar no espera al ACK.
+//   --cork            TCP_CORK durante cada respuesta: cabecera y cuerpo salen en segmentos
+//                     llenos aunque se escriban por separado (cabecera y sendfile() de
+//                     --archive o de los índices), y quitar el corcho al final envía el resto.
+//   --sndbuf/--rcvbuf Tamaños de los búferes (KiB) en el socket de escucha, que los heredan las
+//                     conexiones aceptadas.
+struct socket_policy {
+  int defer_accept_s = 0;            // Segundos de espera de la petición (0: sin TCP_DEFER_ACCEPT)
+  int fastopen_queue = 0;            // Conexiones Fast Open pendientes (0: sin TCP_FASTOPEN)
+  bool nodelay = false;
+  bool cork = false;
+  int send_buffer_kb = 0;            // 0: el del kernel
+  int receive_buffer_kb = 0;         // 0: el del kernel
+};
+
+/// @brief Aplica la política a un socket de escucha (ya creado, antes o después de listen())
+/// @param listener
+/// @param policy
+/// @return 0 o errno del primer ajuste que el kernel rechaza
+int configure_listener(const SafeFD& listener, const socket_policy& policy);
+
+/// @brief Aplica la política a una conexión recién aceptada
+/// @param client
+/// @param policy
+/// @param family Familia de la dirección del cliente (AF_INET, AF_UNIX)
+/// @return 0 o errno
+int configure_connection(const SafeFD& client, const socket_policy& policy, sa_family_t family);
+
+// Corcho de una respuesta (--cork): lo pone al construirse y lo quita al destruirse, lo que
+// envía lo que quede pendiente. Sin --cork, o en un socket Unix, no hace nada
+class ResponseCork
+{
+  public:
+    ResponseCork(const SafeFD& client, const socket_policy& policy, sa_family_t family) noexcept;
+    ResponseCork(const ResponseCork&) = delete;
+    ResponseCork& operator=(const ResponseCork&) = delete;
+    ~ResponseCork();
+
+  private:
+    int fd_;
+};
+
+#endif
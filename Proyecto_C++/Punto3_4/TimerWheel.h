@@ -0,0 +1,222 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <functional>
+
+// Temporizador intrusivo: vive dentro de quien lo usa (conexión, petición...), así que
+// programarlo o cancelarlo no reserva memoria.
+class TimerNode
+{
+  public:
+    explicit TimerNode() noexcept = default;
+    TimerNode(const TimerNode&) = delete;
+    TimerNode& operator=(const TimerNode&) = delete;
+
+    [[nodiscard]] bool is_armed() const noexcept
+    {
+      return prev_ != nullptr;
+    }
+
+    std::function<void()> on_expire;
+
+  private:
+    friend class TimerWheel;
+    TimerNode* prev_ = nullptr;
+    TimerNode* next_ = nullptr;
+    uint64_t expires_ = 0;
+};
+
+// Rueda de temporizadores jerárquica: 4 niveles de 64 casillas. Programar y cancelar son
+// O(1); los temporizadores lejanos bajan de nivel (cascada) al acercarse su vencimiento.
+// No es segura entre hilos: la usa un único bucle de eventos.
+class TimerWheel
+{
+  public:
+    static constexpr unsigned level_bits = 6;
+    static constexpr unsigned slots = 1u << level_bits;
+    static constexpr unsigned levels = 4;
+    static constexpr uint64_t max_delay = (uint64_t{1} << (level_bits * levels)) - 1;
+
+    explicit TimerWheel(uint64_t now = 0) noexcept : now_{now}
+    {
+      for (auto& level : wheel_) {
+        for (auto& head : level) {
+          head.prev_ = head.next_ = &head;
+        }
+      }
+    }
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /// @brief Programa un temporizador para dentro de 'delay' ticks (si ya estaba, se reprograma)
+    void schedule(TimerNode& node, uint64_t delay) noexcept
+    {
+      cancel(node);
+      node.expires_ = now_ + std::clamp<uint64_t>(delay, 1, max_delay);
+      insert(node);
+      ++armed_;
+    }
+
+    /// @brief Cancela un temporizador (no hace nada si no estaba programado)
+    /// La casilla puede quedar marcada como ocupada; la marca se limpia al recorrerla.
+    void cancel(TimerNode& node) noexcept
+    {
+      if (!node.is_armed()) {
+        return;
+      }
+      node.prev_->next_ = node.next_;
+      node.next_->prev_ = node.prev_;
+      node.prev_ = node.next_ = nullptr;
+      --armed_;
+    }
+
+    /// @brief Avanza la rueda hasta 'now' y ejecuta los temporizadores vencidos
+    /// @return Número de temporizadores ejecutados
+    size_t advance(uint64_t now)
+    {
+      return advance(now, [](TimerNode& node) {
+        if (node.on_expire) {
+          node.on_expire();
+        }
+      });
+    }
+
+    /// @brief Avanza la rueda hasta 'now' y entrega cada temporizador vencido a 'run'
+    /// @param run Se llama con cada temporizador ya fuera de la rueda; puede volver a programarlo
+    /// @return Número de temporizadores vencidos
+    template <typename Run>
+    size_t advance(uint64_t now, Run&& run)
+    {
+      size_t fired = 0;
+      while (now_ < now) {
+        if (armed_ == 0) {
+          now_ = now;
+          break;
+        }
+        // Si el nivel 0 está vacío se salta directamente a la siguiente cascada
+        if (occupied_[0] == 0) {
+          uint64_t boundary = (now_ | (slots - 1)) + 1;
+          now_ = std::min(now, boundary - 1);
+          if (now_ == now) {
+            break;
+          }
+        }
+        ++now_;
+        cascade();
+        fired += expire(wheel_[0][now_ & (slots - 1)], 0, now_ & (slots - 1), run);
+      }
+      return fired;
+    }
+
+    /// @brief Ticks hasta la próxima vez que hay que llamar a advance()
+    /// @return 0 si no hay temporizadores; si no, el siguiente vencimiento del nivel 0
+    ///         o la siguiente cascada, lo que llegue antes
+    [[nodiscard]] uint64_t next_wakeup() const noexcept
+    {
+      if (armed_ == 0) {
+        return 0;
+      }
+      unsigned index = now_ & (slots - 1);
+      // Casillas del nivel 0 posteriores a la actual, en orden circular
+      uint64_t rotated = std::rotr(occupied_[0], (index + 1) % slots);
+      if (rotated != 0) {
+        uint64_t ahead = static_cast<uint64_t>(std::countr_zero(rotated)) + 1;
+        if (index + ahead < slots) {
+          return ahead;
+        }
+      }
+      return slots - index;
+    }
+
+    [[nodiscard]] uint64_t now() const noexcept
+    {
+      return now_;
+    }
+    [[nodiscard]] size_t armed() const noexcept
+    {
+      return armed_;
+    }
+
+  private:
+    void insert(TimerNode& node) noexcept
+    {
+      uint64_t delta = node.expires_ - now_;
+      unsigned level = 0;
+      while (level + 1 < levels && delta >= (uint64_t{1} << (level_bits * (level + 1)))) {
+        ++level;
+      }
+      unsigned slot = (node.expires_ >> (level_bits * level)) & (slots - 1);
+      TimerNode& head = wheel_[level][slot];
+      node.next_ = &head;
+      node.prev_ = head.prev_;
+      head.prev_->next_ = &node;
+      head.prev_ = &node;
+      occupied_[level] |= uint64_t{1} << slot;
+    }
+
+    // Al completar una vuelta de un nivel se reparten los temporizadores de la casilla
+    // correspondiente del nivel superior entre los niveles inferiores
+    void cascade() noexcept
+    {
+      for (unsigned level = 1; level < levels; ++level) {
+        if ((now_ & ((uint64_t{1} << (level_bits * level)) - 1)) != 0) {
+          break;
+        }
+        unsigned slot = (now_ >> (level_bits * level)) & (slots - 1);
+        TimerNode pending;
+        take(wheel_[level][slot], pending, level, slot);
+        while (pending.next_ != &pending) {
+          TimerNode& node = *pending.next_;
+          pending.next_ = node.next_;
+          node.next_->prev_ = &pending;
+          insert(node);
+        }
+      }
+    }
+
+    template <typename Run>
+    size_t expire(TimerNode& head, unsigned level, unsigned slot, Run& run)
+    {
+      TimerNode pending;
+      take(head, pending, level, slot);
+      size_t fired = 0;
+      while (pending.next_ != &pending) {
+        TimerNode& node = *pending.next_;
+        pending.next_ = node.next_;
+        node.next_->prev_ = &pending;
+        node.prev_ = node.next_ = nullptr;
+        --armed_;
+        ++fired;
+        // El callback puede volver a programar el temporizador: ya no está en ninguna lista
+        run(node);
+      }
+      pending.prev_ = pending.next_ = nullptr;
+      return fired;
+    }
+
+    // Mueve la lista de una casilla a 'pending' (vacía la casilla)
+    void take(TimerNode& head, TimerNode& pending, unsigned level, unsigned slot) noexcept
+    {
+      occupied_[level] &= ~(uint64_t{1} << slot);
+      if (head.next_ == &head) {
+        pending.prev_ = pending.next_ = &pending;
+        return;
+      }
+      pending.next_ = head.next_;
+      pending.prev_ = head.prev_;
+      pending.next_->prev_ = &pending;
+      pending.prev_->next_ = &pending;
+      head.prev_ = head.next_ = &head;
+    }
+
+    uint64_t now_;
+    size_t armed_ = 0;
+    std::array<uint64_t, levels> occupied_{};
+    std::array<std::array<TimerNode, slots>, levels> wheel_;
+};
+
+#endif
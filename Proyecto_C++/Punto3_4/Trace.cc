@@ -0,0 +1,154 @@
+#include "Trace.h"
+#include <algorithm>
+#include <array>
+#include <csignal>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+std::atomic<bool> trace_enabled{false};
+
+struct trace_event {
+  const char* name;
+  uint64_t start_ns;
+  uint64_t duration_ns;
+  pid_t tid;
+};
+
+// Búfer de un hilo: solo escribe su dueño; si se llena se sobrescriben los más antiguos
+struct trace_ring {
+  static constexpr size_t capacity = 4096;
+  std::array<trace_event, capacity> events;
+  std::atomic<uint64_t> head{0};
+};
+
+// Los búferes no mueren con su hilo (los hilos son de una conexión): al terminar el hilo su
+// búfer vuelve a la lista de libres y lo reutiliza el siguiente, con sus intervalos dentro
+struct trace_registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<trace_ring>> rings;
+  std::vector<trace_ring*> free;
+};
+
+static trace_registry registry;
+static std::atomic<uint64_t> enabled_since{0};
+static volatile sig_atomic_t dump_requested = 0;
+static int signal_fd = -1; // eventfd que despierta al bucle principal, atienda la señal el hilo que la atienda
+
+struct ring_owner {
+  trace_ring* ring = nullptr;
+  ~ring_owner()
+  {
+    if (ring != nullptr) {
+      std::lock_guard lock{registry.mutex};
+      registry.free.push_back(ring);
+    }
+  }
+};
+
+static thread_local ring_owner current_ring;
+
+static trace_ring& ring_for_this_thread() {
+  if (current_ring.ring == nullptr) {
+    std::lock_guard lock{registry.mutex};
+    if (!registry.free.empty()) {
+      current_ring.ring = registry.free.back();
+      registry.free.pop_back();
+    } else {
+      current_ring.ring = registry.rings.emplace_back(std::make_unique<trace_ring>()).get();
+    }
+  }
+  return *current_ring.ring;
+}
+
+static void on_trace_signal(int) {
+  bool was_enabled = trace_enabled.load(std::memory_order_relaxed);
+  if (was_enabled) {
+    trace_enabled.store(false, std::memory_order_relaxed);
+    dump_requested = 1;
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = write(signal_fd, &one, sizeof(one));
+  } else {
+    enabled_since.store(trace_now(), std::memory_order_relaxed);
+    trace_enabled.store(true, std::memory_order_relaxed);
+  }
+}
+
+void trace_record(const char* name, uint64_t start_ns, uint64_t end_ns) noexcept {
+  static thread_local pid_t tid = gettid();
+  trace_ring& ring = ring_for_this_thread();
+  uint64_t head = ring.head.load(std::memory_order_relaxed);
+  ring.events[head % trace_ring::capacity] = trace_event{name, start_ns, end_ns - start_ns, tid};
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+void trace_set_enabled(bool enabled) noexcept {
+  if (enabled) {
+    enabled_since.store(trace_now(), std::memory_order_relaxed);
+  }
+  trace_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+/// @brief Vuelca los intervalos en JSON de Chrome ("ph":"X", tiempos en microsegundos)
+/// Pensado para hacerse con las trazas ya desactivadas: un hilo que siga escribiendo puede
+/// sobrescribir algún intervalo mientras se copia.
+/// @param path Archivo de salida
+/// @return 0 o errno
+int trace_dump(const std::string& path) {
+  std::unique_ptr<FILE, int (*)(FILE*)> output{fopen(path.c_str(), "w"), fclose};
+  if (!output) {
+    return errno;
+  }
+  uint64_t since = enabled_since.load(std::memory_order_relaxed);
+  pid_t pid = getpid();
+  std::fputs("{\"traceEvents\":[", output.get());
+  bool first = true;
+  std::lock_guard lock{registry.mutex};
+  for (const auto& ring : registry.rings) {
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t count = std::min<uint64_t>(head, trace_ring::capacity);
+    for (uint64_t i = head - count; i < head; ++i) {
+      const trace_event& event = ring->events[i % trace_ring::capacity];
+      if (event.start_ns < since) {
+        continue;
+      }
+      std::fprintf(output.get(), "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu.%03llu,\"dur\":%llu.%03llu,\"pid\":%d,\"tid\":%d}",
+                   first ? "" : ",", event.name,
+                   static_cast<unsigned long long>(event.start_ns / 1000), static_cast<unsigned long long>(event.start_ns % 1000),
+                   static_cast<unsigned long long>(event.duration_ns / 1000), static_cast<unsigned long long>(event.duration_ns % 1000),
+                   static_cast<int>(pid), static_cast<int>(event.tid));
+      first = false;
+    }
+  }
+  std::fputs("\n],\"displayTimeUnit\":\"ns\"}\n", output.get());
+  if (std::fflush(output.get()) != 0) {
+    return errno;
+  }
+  return 0;
+}
+
+int trace_install_signal() {
+  signal_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (signal_fd < 0) {
+    return -1;
+  }
+  struct sigaction action{};
+  action.sa_handler = on_trace_signal;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGUSR2, &action, nullptr);
+  return signal_fd;
+}
+
+bool trace_take_dump_request() noexcept {
+  uint64_t count;
+  [[maybe_unused]] ssize_t drained = read(signal_fd, &count, sizeof(count));
+  if (dump_requested == 0) {
+    return false;
+  }
+  dump_requested = 0;
+  return true;
+}
@@ -0,0 +1,82 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <time.h>
+
+// Sondas USDT en los límites de cada fase (perf, bpftrace, systemtap):
+//   docserver:phase__start(nombre)  docserver:phase__end(nombre, duración en ns o 0)
+// Sin <sys/sdt.h> las sondas desaparecen. Una sonda sin nadie enganchado es un nop.
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define DOCSERVER_PROBE1(probe, a) DTRACE_PROBE1(docserver, probe, a)
+#define DOCSERVER_PROBE2(probe, a, b) DTRACE_PROBE2(docserver, probe, a, b)
+#else
+#define DOCSERVER_PROBE1(probe, a) ((void)(a))
+#define DOCSERVER_PROBE2(probe, a, b) ((void)(a), (void)(b))
+#endif
+
+// Trazas por fase de cada petición: cada hilo apunta sus intervalos en un búfer circular
+// propio (sin bloqueos ni memoria nueva una vez creado) y trace_dump() los vuelca en el
+// formato de eventos de Chrome (chrome://tracing, Perfetto). Desactivadas, cada fase cuesta
+// una comprobación de trace_enabled.
+extern std::atomic<bool> trace_enabled;
+
+/// @brief Reloj de las trazas en nanosegundos (CLOCK_MONOTONIC, sin llamada al sistema gracias al vDSO)
+inline uint64_t trace_now() noexcept
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000 + static_cast<uint64_t>(now.tv_nsec);
+}
+
+/// @brief Apunta un intervalo en el búfer del hilo actual
+/// @param name Nombre de la fase (debe ser una cadena literal: se guarda el puntero)
+void trace_record(const char* name, uint64_t start_ns, uint64_t end_ns) noexcept;
+
+/// @brief Activa o desactiva las trazas; al activarlas se descartan los intervalos anteriores
+void trace_set_enabled(bool enabled) noexcept;
+
+/// @brief Vuelca los intervalos apuntados desde la última activación en JSON de Chrome
+/// @return 0 o errno
+int trace_dump(const std::string& path);
+
+/// @brief Instala el manejador de SIGUSR2, que alterna las trazas (al desactivarlas pide el volcado)
+/// @return Descriptor que se vuelve legible cuando hay que volcar (para poll()) o -1
+int trace_install_signal();
+
+/// @brief Indica (una sola vez) si una señal ha desactivado las trazas y hay que volcarlas
+bool trace_take_dump_request() noexcept;
+
+// Intervalo de una fase: empieza al construirse y se apunta al destruirse
+class TraceSpan
+{
+  public:
+    explicit TraceSpan(const char* name) noexcept : name_{name}
+    {
+      DOCSERVER_PROBE1(phase__start, name_);
+      if (trace_enabled.load(std::memory_order_relaxed)) [[unlikely]] {
+        start_ = trace_now();
+      }
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+    ~TraceSpan()
+    {
+      uint64_t duration = 0;
+      if (start_ != 0) [[unlikely]] {
+        uint64_t end = trace_now();
+        duration = end - start_;
+        trace_record(name_, start_, end);
+      }
+      DOCSERVER_PROBE2(phase__end, name_, duration);
+    }
+
+  private:
+    const char* name_;
+    uint64_t start_ = 0;
+};
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <ctime>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include "SafeFD.h"
+#include "TimerWheel.h"
+
+// Bucle de plazos: un hilo que posee una TimerWheel y ejecuta los temporizadores vencidos.
+// Las conexiones (cada una en su hilo) programan sus plazos aquí. El timerfd solo se arma
+// para el siguiente vencimiento real, así que todas las expiraciones de un mismo tick se
+// atienden con un único despertar y, sin plazos pendientes, el hilo no se despierta nunca.
+// Las acciones se ejecutan sin el cerrojo: pueden programar o cancelar temporizadores,
+// incluido el suyo.
+class Watchdog
+{
+  public:
+    static constexpr uint64_t tick_ms = 10;
+
+    explicit Watchdog() : timer_fd_{timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)}, wheel_{current_tick()}
+    {
+      thread_ = std::thread{&Watchdog::run, this};
+    }
+    Watchdog(const Watchdog&) = delete;
+    Watchdog& operator=(const Watchdog&) = delete;
+    ~Watchdog()
+    {
+      {
+        std::lock_guard lock{mutex_};
+        stop_ = true;
+        arm_timerfd(1);
+      }
+      thread_.join();
+    }
+
+    [[nodiscard]] bool is_valid() const noexcept
+    {
+      return timer_fd_.is_valid();
+    }
+
+    /// @brief Programa (o reprograma) un temporizador
+    /// @param node Temporizador, que debe seguir vivo hasta cancelarlo o que venza
+    /// @param timeout_ms Plazo en milisegundos
+    /// @param on_expire Acción a ejecutar en el hilo del watchdog al vencer
+    void arm(TimerNode& node, uint64_t timeout_ms, std::function<void()> on_expire)
+    {
+      std::lock_guard lock{mutex_};
+      node.on_expire = std::move(on_expire);
+      // La rueda solo avanza al despertar, así que el plazo se cuenta desde su "ahora"
+      uint64_t lag = current_tick() - wheel_.now();
+      wheel_.schedule(node, lag + (timeout_ms + tick_ms - 1) / tick_ms);
+      uint64_t wakeup = wheel_.now() + wheel_.next_wakeup();
+      if (armed_for_ == 0 || wakeup < armed_for_) {
+        arm_timerfd(wakeup);
+      }
+    }
+
+    /// @brief Cancela un temporizador; a la vuelta se garantiza que su acción no se está ejecutando
+    /// (salvo si se llama desde esa misma acción)
+    void cancel(TimerNode& node)
+    {
+      std::unique_lock lock{mutex_};
+      wheel_.cancel(node);
+      if (std::this_thread::get_id() != thread_.get_id()) {
+        finished_.wait(lock, [&] { return running_ != &node; });
+      }
+    }
+
+  private:
+    static uint64_t current_tick() noexcept
+    {
+      timespec now{};
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      return (static_cast<uint64_t>(now.tv_sec) * 1000 + static_cast<uint64_t>(now.tv_nsec) / 1000000) / tick_ms;
+    }
+
+    // Arma el timerfd para el tick absoluto indicado (0 lo desarma)
+    void arm_timerfd(uint64_t tick) noexcept
+    {
+      itimerspec spec{};
+      if (tick != 0) {
+        uint64_t ms = tick * tick_ms;
+        spec.it_value.tv_sec = static_cast<time_t>(ms / 1000);
+        spec.it_value.tv_nsec = static_cast<long>((ms % 1000) * 1000000);
+      }
+      timerfd_settime(timer_fd_.get(), TFD_TIMER_ABSTIME, &spec, nullptr);
+      armed_for_ = tick;
+    }
+
+    void run()
+    {
+      while (true) {
+        uint64_t expirations;
+        if (read(timer_fd_.get(), &expirations, sizeof(expirations)) < 0 && errno != EINTR) {
+          return;
+        }
+        std::unique_lock lock{mutex_};
+        if (stop_) {
+          return;
+        }
+        wheel_.advance(current_tick(), [&](TimerNode& node) {
+          // La acción se saca del temporizador antes de soltar el cerrojo: si mientras se
+          // ejecuta otro hilo (o ella misma) lo vuelve a programar, no se pisan
+          running_ = &node;
+          {
+            std::function<void()> action = std::move(node.on_expire);
+            lock.unlock();
+            if (action) {
+              action();
+            }
+          }
+          lock.lock();
+          running_ = nullptr;
+          finished_.notify_all();
+        });
+        uint64_t delay = wheel_.next_wakeup();
+        arm_timerfd(delay == 0 ? 0 : wheel_.now() + delay);
+      }
+    }
+
+    SafeFD timer_fd_;
+    std::mutex mutex_;
+    std::condition_variable finished_;  // Se avisa al terminar cada acción
+    TimerWheel wheel_;
+    TimerNode* running_ = nullptr;       // Temporizador cuya acción se está ejecutando
+    uint64_t armed_for_ = 0;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+// Plazo de una conexión: se cancela solo al destruirse. Debe declararse después de los
+// recursos que toca su acción (socket, pidfd...) para destruirse antes que ellos.
+class Deadline
+{
+  public:
+    explicit Deadline(Watchdog& watchdog) noexcept : watchdog_{watchdog} {}
+    Deadline(const Deadline&) = delete;
+    Deadline& operator=(const Deadline&) = delete;
+    ~Deadline()
+    {
+      watchdog_.cancel(node_);
+    }
+
+    /// @brief Programa el plazo; si ya estaba programado, lo sustituye. No se puede llamar desde
+    /// su propia acción, que se estaría ejecutando mientras se sustituye
+    void arm(uint64_t timeout_ms, std::function<void()> on_expire)
+    {
+      // La acción se guarda aquí y el temporizador solo captura 'this': así su std::function
+      // cabe en el almacenamiento interno y programar un plazo no reserva memoria. Tras
+      // cancel() la acción anterior ya no se está ejecutando y se puede sustituir.
+      watchdog_.cancel(node_);
+      action_ = std::move(on_expire);
+      watchdog_.arm(node_, timeout_ms, [this] {
+        expired_.store(true, std::memory_order_release);
+        action_();
+      });
+    }
+    void cancel()
+    {
+      watchdog_.cancel(node_);
+    }
+    [[nodiscard]] bool expired() const noexcept
+    {
+      return expired_.load(std::memory_order_acquire);
+    }
+  private:
+    Watchdog& watchdog_;
+    std::function<void()> action_;
+    TimerNode node_;
+    std::atomic<bool> expired_{false};
+};
+
+#endif
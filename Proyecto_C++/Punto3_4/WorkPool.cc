@@ -0,0 +1,93 @@
+#include "WorkPool.h"
+#include <algorithm>
+
+WorkPool::WorkPool(size_t file_threads, size_t process_threads) {
+  start(groups_[static_cast<size_t>(work_class::file)], file_threads);
+  start(groups_[static_cast<size_t>(work_class::process)], process_threads);
+}
+
+WorkPool::~WorkPool() {
+  for (group& workers : groups_) {
+    {
+      std::lock_guard lock{workers.idle_mutex};
+      workers.stopping = true;
+    }
+    workers.idle.notify_all();
+    workers.threads.clear();
+  }
+}
+
+/// @brief Crea las colas y los hilos de una clase de trabajo
+void WorkPool::start(group& workers, size_t count) {
+  workers.size = std::max<size_t>(count, 1);
+  workers.queues = std::make_unique<worker_queue[]>(workers.size);
+  workers.threads.reserve(workers.size);
+  for (size_t i = 0; i < workers.size; ++i) {
+    workers.threads.emplace_back([&workers, i] { run(workers, i); });
+  }
+}
+
+void WorkPool::submit(work_class kind, std::function<void()> work) {
+  group& workers = groups_[static_cast<size_t>(kind)];
+  worker_queue& queue = workers.queues[workers.next.fetch_add(1, std::memory_order_relaxed) % workers.size];
+  {
+    std::lock_guard lock{queue.mutex};
+    queue.jobs.push_back(std::move(work));
+  }
+  workers.pending.fetch_add(1, std::memory_order_release);
+  // Pasar por el cerrojo de los ociosos: un hilo que acaba de ver pending == 0 ya está
+  // esperando cuando llega el aviso, y no se lo pierde
+  { std::lock_guard lock{workers.idle_mutex}; }
+  workers.idle.notify_one();
+}
+
+/// @brief Saca una tarea: de la propia cola por delante o, si está vacía, de otra por detrás
+/// @param workers
+/// @param index Hilo que busca trabajo
+/// @param work Tarea sacada
+/// @return false si todas las colas están vacías
+bool WorkPool::take(group& workers, size_t index, std::function<void()>& work) {
+  for (size_t offset = 0; offset < workers.size; ++offset) {
+    worker_queue& queue = workers.queues[(index + offset) % workers.size];
+    std::lock_guard lock{queue.mutex};
+    if (queue.jobs.empty()) {
+      continue;
+    }
+    if (offset == 0) {
+      work = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+    } else {
+      work = std::move(queue.jobs.back());
+      queue.jobs.pop_back();
+      workers.stolen.fetch_add(1, std::memory_order_relaxed);
+    }
+    workers.pending.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+/// @brief Bucle de un hilo de trabajo: ejecuta tareas hasta que se detenga el grupo
+void WorkPool::run(group& workers, size_t index) {
+  std::function<void()> work;
+  while (true) {
+    if (take(workers, index, work)) {
+      work();
+      work = nullptr;
+      workers.completed.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    std::unique_lock lock{workers.idle_mutex};
+    workers.idle.wait(lock, [&workers] {
+      return workers.stopping || workers.pending.load(std::memory_order_acquire) > 0;
+    });
+    if (workers.stopping) {
+      return;
+    }
+  }
+}
+
+WorkPool::statistics WorkPool::stats(work_class kind) const noexcept {
+  const group& workers = groups_[static_cast<size_t>(kind)];
+  return {workers.size, workers.completed.load(std::memory_order_relaxed), workers.stolen.load(std::memory_order_relaxed)};
+}
@@ -0,0 +1,81 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Hilos de trabajo con robo de tareas (docserver --async): los bucles de eventos les pasan lo
+// que puede bloquear (stat(), open(), los fallos de página de un mapeo en un disco lento, fork()
+// de un CGI...) y siguen atendiendo sus conexiones mientras tanto. Quien entrega una tarea
+// recibe el aviso de que ha terminado por su cuenta (EventLoop::offload lo hace con un eventfd).
+//
+// Hay dos clases de trabajo con sus propios hilos y colas, para que una no acapare a la otra:
+// mil lecturas de disco en cola no retrasan el lanzamiento de un CGI, ni al revés. Dentro de
+// cada clase, cada hilo tiene su cola: las tareas se reparten por turnos y cada hilo saca de la
+// suya por delante (en orden de llegada); el que se queda sin trabajo roba por detrás de las
+// de los demás. Así una lectura atascada en un disco lento solo retiene a su propio hilo y lo
+// que se había encolado detrás lo recogen los otros.
+class WorkPool
+{
+  public:
+    enum class work_class { file, process };
+
+    struct statistics {
+      size_t threads;
+      uint64_t completed;           // Tareas terminadas
+      uint64_t stolen;              // De ellas, las que hizo un hilo distinto del que las recibió
+    };
+
+    /// @brief Arranca los hilos de las dos clases
+    /// @param file_threads Hilos para el sistema de archivos (al menos uno)
+    /// @param process_threads Hilos para lanzar programas y plugins (al menos uno)
+    WorkPool(size_t file_threads, size_t process_threads);
+    WorkPool(const WorkPool&) = delete;
+    WorkPool& operator=(const WorkPool&) = delete;
+    /// @brief Detiene los hilos; lo que quede en las colas no se ejecuta
+    ~WorkPool();
+
+    /// @brief Encola una tarea (desde cualquier hilo)
+    /// @param kind Clase de trabajo
+    /// @param work Tarea; se ejecuta en uno de los hilos de su clase
+    void submit(work_class kind, std::function<void()> work);
+
+    [[nodiscard]] statistics stats(work_class kind) const noexcept;
+
+  private:
+    // Una cola por hilo y por línea de caché: el dueño y los ladrones solo compiten en ella
+    struct alignas(64) worker_queue {
+      std::mutex mutex;
+      std::deque<std::function<void()>> jobs;
+    };
+
+    struct group {
+      std::unique_ptr<worker_queue[]> queues;
+      size_t size = 0;
+      std::atomic<size_t> next{0};          // Turno para repartir
+      std::atomic<size_t> pending{0};       // Tareas en las colas
+      std::atomic<uint64_t> completed{0};
+      std::atomic<uint64_t> stolen{0};
+      std::mutex idle_mutex;
+      std::condition_variable idle;         // Hilos sin trabajo
+      bool stopping = false;                // Protegido por idle_mutex
+      std::vector<std::jthread> threads;    // Lo último: se unen antes de destruir las colas
+    };
+
+    void start(group& workers, size_t count);
+    static bool take(group& workers, size_t index, std::function<void()>& work);
+    static void run(group& workers, size_t index);
+
+    std::array<group, 2> groups_;
+};
+
+#endif
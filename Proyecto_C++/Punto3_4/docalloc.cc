@@ -0,0 +1,269 @@
+/**
+ * Universidad de La Laguna
+ * Escuela Superior de Ingeniería y Tecnología
+ * Asignatura: Sistemas Operativos (SSOO)
+ * Curso: 2º
+ * Proyecto C++: Servidor de Documentos
+ * @author
+ * @file docalloc.cc
+ * @brief docalloc [-h | --help] [-n | --requests N]
+ *
+ * Prueba de reservas de memoria del camino de una petición. Sustituye malloc (y sus variantes)
+ * y operator new por versiones que cuentan cada reserva, y atiende peticiones sobre un
+ * socketpair con las mismas piezas y en el mismo orden que handle_connection: arena en la
+ * pila, plazo del watchdog, receive_request, parse_request, Router::find, la ruta en disco en
+ * la arena y, según la ruta, read_all y send_response (estática) o execute_program con el
+ * entorno del CGI en la arena (programa).
+ *
+ * Tras unas peticiones de calentamiento (que rellenan las cachés de glibc y de la biblioteca
+ * estándar), cada petición estática y cada petición CGI debe hacer 0 reservas en este proceso.
+ * Imprime las reservas por petición de cada caso y termina con código 0 si se cumple o 1 si no.
+ * std::thread (un bloque por conexión en el servidor) queda fuera: aquí no se crean hilos por
+ * petición.
+ *
+ * Compilar con: g++ -std=c++23 -O2 -pthread docalloc.cc Functions.cc Router.cc -ldl -o docalloc
+*/
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <new>
+#include <charconv>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include "Functions.h"
+#include "Router.h"
+#include "Arena.h"
+#include "Watchdog.h"
+
+// -------------------
+//  Reservas contadas
+// -------------------
+
+// Las funciones internas de glibc a las que se delega: así las sustituciones no se llaman a sí mismas
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+}
+
+static std::atomic<uint64_t> allocations{0};
+
+extern "C" void* malloc(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** pointer, size_t alignment, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    *pointer = __libc_memalign(alignment, size);
+    return *pointer == nullptr ? ENOMEM : 0;
+}
+
+extern "C" void free(void* pointer) {
+    __libc_free(pointer);
+}
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = __libc_malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = __libc_memalign(static_cast<size_t>(alignment), size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* pointer) noexcept {
+    __libc_free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    __libc_free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    __libc_free(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    __libc_free(pointer);
+}
+
+// -------------------
+//     Peticiones
+// -------------------
+
+constexpr size_t max_request_head = 4096;
+
+// Opciones de la ejecución
+struct alloc_options {
+    int warm_up = 8;                    // Peticiones de cada caso antes de contar
+    int requests = 200;                 // Peticiones contadas de cada caso
+};
+
+/// @brief Atiende una petición ya escrita en el otro extremo del socketpair, como
+/// handle_connection y los manejadores de rutas estáticas y CGI
+/// @param client Extremo del servidor
+/// @param router Tabla de rutas
+/// @param watchdog Plazos de la conexión
+/// @param base_dir Directorio base (SERVER_BASEDIR)
+/// @return Código de la respuesta enviada (200, 404 o 500)
+static int serve_one(const SafeFD& client, const Router& router, Watchdog& watchdog, const std::string& base_dir) {
+    RequestArena<16384> arena;
+    Deadline deadline{watchdog};
+    std::function<void()> abort_io = [fd = client.get()] { shutdown(fd, SHUT_RDWR); };
+    deadline.arm(10000, abort_io);
+
+    auto request = receive_request(client, max_request_head, arena.resource());
+    if (!request) {
+        return 500;
+    }
+    request_line line = parse_request(request.value());
+    auto match = router.find(line.path);
+    if (!match) {
+        return 404;
+    }
+    deadline.arm(10000, abort_io);
+    std::pmr::string complete_path{arena.resource()};
+    complete_path.reserve(match->matched->target.size() + match->remainder.size());
+    complete_path.append(match->matched->target).append(match->remainder);
+
+    char length[content_length_capacity];
+    if (match->matched->kind == route_kind::static_files) {
+        auto file = read_all(complete_path.c_str());
+        if (!file) {
+            return 404;
+        }
+        std::string_view body = file->get();
+        return send_response(client, format_content_length(length, body.size()), body) < 0 ? 500 : 200;
+    }
+
+    exec_environment env{arena.resource()};
+    env.REQUEST_PATH = complete_path;
+    env.SERVER_BASEDIR = base_dir;
+    env.REMOTE_PORT = "0";
+    env.REMOTE_IP = "127.0.0.1";
+    env.REQUEST_METHOD = line.method;
+    auto output = execute_program(complete_path, env);
+    if (!output) {
+        return 500;
+    }
+    return send_response(client, format_content_length(length, output->size()), output.value()) < 0 ? 500 : 200;
+}
+
+/// @brief Hace una petición completa sobre un socketpair nuevo
+/// @param request Petición ("GET /ruta\n")
+/// @return Código de serve_one, o 500 si la respuesta no llegó
+static int round_trip(std::string_view request, const Router& router, Watchdog& watchdog, const std::string& base_dir) {
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0) {
+        return 500;
+    }
+    SafeFD server_end{pair[0]};
+    SafeFD client_end{pair[1]};
+    if (write(client_end.get(), request.data(), request.size()) != static_cast<ssize_t>(request.size())) {
+        return 500;
+    }
+    shutdown(client_end.get(), SHUT_WR);
+    int status = serve_one(server_end, router, watchdog, base_dir);
+    server_end = SafeFD{};
+    // La respuesta cabe en el búfer del socket: se lee entera después de atenderla
+    char response[4096];
+    ssize_t received = 0;
+    while (ssize_t bytes = read(client_end.get(), response, sizeof(response))) {
+        if (bytes < 0) {
+            return 500;
+        }
+        received += bytes;
+    }
+    return received > 0 ? status : 500;
+}
+
+/// @brief Cuenta las reservas por petición de un caso
+/// @return true si no hubo ninguna
+static bool check_case(std::string_view name, std::string_view request, const alloc_options& options, const Router& router,
+                       Watchdog& watchdog, const std::string& base_dir) {
+    for (int i = 0; i < options.warm_up; ++i) {
+        if (round_trip(request, router, watchdog, base_dir) != 200) {
+            std::cerr << "Error: la petición de " << name << " no se atendió\n";
+            return false;
+        }
+    }
+    uint64_t before = allocations.load(std::memory_order_relaxed);
+    for (int i = 0; i < options.requests; ++i) {
+        round_trip(request, router, watchdog, base_dir);
+    }
+    uint64_t counted = allocations.load(std::memory_order_relaxed) - before;
+    double per_request = static_cast<double>(counted) / options.requests;
+    std::cout << name << ": " << per_request << " reservas por petición (" << counted << " en " << options.requests << ")\n";
+    return counted == 0;
+}
+
+int main(int argc, char* argv[]) {
+    alloc_options options;
+    std::vector<std::string_view> args(argv + 1, argv + argc);
+    for (auto it = args.begin(), end = args.end(); it != end; ++it) {
+        if (*it == "-h" || *it == "--help") {
+            std::cout << "Uso: docalloc [-h | --help] [-n | --requests N]\n";
+            return EXIT_SUCCESS;
+        } else if ((*it == "-n" || *it == "--requests") && it + 1 != end && std::atoi((it + 1)->data()) > 0) {
+            options.requests = std::atoi((++it)->data());
+        } else {
+            std::cerr << "Error: opción desconocida o sin valor: " << *it << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Documento y programa de prueba en un directorio temporal
+    char directory_template[] = "/tmp/docalloc-XXXXXX";
+    if (mkdtemp(directory_template) == nullptr) {
+        std::cerr << "Error: no se pudo crear el directorio temporal\n";
+        return EXIT_FAILURE;
+    }
+    std::string base_dir = directory_template;
+    std::filesystem::create_directory(base_dir + "/bin");
+    std::ofstream{base_dir + "/doc.txt"} << "Documento de prueba\n";
+    std::ofstream{base_dir + "/bin/hola"} << "#!/bin/sh\necho hola\n";
+    chmod((base_dir + "/bin/hola").c_str(), 0755);
+
+    Router router = Router::defaults(base_dir);
+    Watchdog watchdog;
+    bool passed = watchdog.is_valid();
+    passed = check_case("static", "GET /doc.txt\n", options, router, watchdog, base_dir) && passed;
+    passed = check_case("cgi", "GET /bin/hola\n", options, router, watchdog, base_dir) && passed;
+
+    std::filesystem::remove_all(base_dir);
+    std::cout << (passed ? "OK\n" : "FALLO: hay reservas en el camino de una petición\n");
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
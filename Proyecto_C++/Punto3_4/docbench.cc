@@ -0,0 +1,718 @@
+/**
+ * Universidad de La Laguna
+ * Escuela Superior de Ingeniería y Tecnología
+ * Asignatura: Sistemas Operativos (SSOO)
+ * Curso: 2º
+ * Proyecto C++: Servidor de Documentos
+ * @author
+ * @file docbench.cc
+ * @brief docbench [-h | --help] [-l | --list] [-f | --filter TEXTO] [-s | --samples N] [-t | --min-time MS]
+ *
+ * Microbenchmarks de las piezas de Functions.cc: read_all (varios tamaños, caché de páginas
+ * caliente y fría), send_response sobre un socketpair (y bundle: 32 respuestas frente a un
+ * solo send_parts con los 32 documentos), receive_request con la petición
+ * llegada en fragmentos, execute_program (latencia de lanzar un programa) y parse_args.
+ * content_cache compara miles de documentos pequeños mapeados cada uno por su lado con los
+ * mismos documentos en la región de páginas enormes de ContentCache. rate_limit mide los cubos
+ * de fichas por IP de RateLimit.h y compara un rechazo con 429 con responder un 404.
+ * tcp_policy mide una petición completa (conectar, pedir, leer la respuesta hasta el cierre)
+ * contra un servidor mínimo sobre TCP de loopback con cada ajuste de SocketPolicy.h por
+ * separado, y añade "server_syscalls_per_op": las llamadas al sistema del servidor por petición.
+ *
+ * Cada caso imprime una línea JSON en la salida estándar:
+ *   {"bench":"read_all","case":"1M/warm","iterations":...,"samples":...,"ns_per_op":...,
+ *    "p90_ns":...,"min_ns":...,"mb_per_s":...}
+ * ns_per_op es la mediana de las muestras. Si el kernel deja leer los contadores del procesador
+ * (perf_event_paranoid <= 2, fuera de máquinas virtuales sin PMU) se añade "dtlb_misses_per_op":
+ * fallos de la TLB de datos por operación, solo en espacio de usuario.
+ * Para detectar regresiones:
+ *   ./docbench > base.jsonl    (antes del cambio)
+ *   ./docbench > nuevo.jsonl   (después)
+ *   ./docbench_compare.sh base.jsonl nuevo.jsonl [UMBRAL_%]
+ *
+ * Compilar con: g++ -std=c++23 -O2 -pthread docbench.cc Functions.cc ContentCache.cc SocketPolicy.cc -o docbench
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+#include <cstring>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <atomic>
+#include <fstream>
+#include <linux/perf_event.h>
+#include "Functions.h"
+#include "ContentCache.h"
+#include "RateLimit.h"
+#include "SocketPolicy.h"
+
+// Opciones de la ejecución
+struct bench_options {
+    std::string filter;                 // Solo los casos cuyo nombre contiene este texto
+    int samples = 15;                   // Muestras por caso
+    uint64_t min_sample_ns = 20000000;  // Duración mínima de cada muestra
+    bool list = false;                  // Solo listar los casos
+};
+
+/// @brief Impide que el compilador elimine un cálculo cuyo resultado no se usa
+template <typename T>
+static void keep(const T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+/// @brief Termina el programa por un error al preparar los casos
+[[noreturn]] static void fail(const std::string& message) {
+    std::cerr << "Error: " << message << '\n';
+    std::exit(EXIT_FAILURE);
+}
+
+static uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Ejecuta y mide los casos. El trabajo de 'setup' (por ejemplo, sacar un archivo de la caché
+// de páginas) se hace antes de cada iteración y no cuenta en el tiempo.
+class BenchRunner
+{
+  public:
+    explicit BenchRunner(const bench_options& options) : options_{options}
+    {
+        // Fallos de la TLB de datos al leer, del propio proceso y solo en modo usuario
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        tlb_misses_ = SafeFD{static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC))};
+    }
+
+    /// @brief Comprueba si run() medirá de verdad un caso (no se está listando y pasa el filtro)
+    [[nodiscard]] bool will_measure(const std::string& bench, const std::string& variant) const
+    {
+        return !options_.list && matches(bench + "/" + variant);
+    }
+
+    /// @param syscalls Si no es nulo, contador de llamadas al sistema de otro hilo que se
+    /// divide entre las operaciones medidas ("server_syscalls_per_op")
+    void run(const std::string& bench, const std::string& variant, uint64_t bytes_per_op,
+             const std::function<void()>& op, const std::function<void()>& setup = {},
+             const std::atomic<uint64_t>* syscalls = nullptr)
+    {
+        std::string name = bench + "/" + variant;
+        if (!matches(name)) {
+            return;
+        }
+        if (options_.list) {
+            std::cout << name << '\n';
+            return;
+        }
+        std::cerr << name << "...\n";
+
+        // Calibrar (y de paso calentar): iteraciones para que una muestra dure lo mínimo pedido
+        uint64_t iterations = 1;
+        while (true) {
+            uint64_t elapsed = sample(iterations, op, setup);
+            if (elapsed >= options_.min_sample_ns || iterations >= (uint64_t{1} << 30)) {
+                break;
+            }
+            uint64_t factor = elapsed == 0 ? 16 : (options_.min_sample_ns + elapsed - 1) / elapsed;
+            iterations *= std::clamp<uint64_t>(factor, 2, 16);
+        }
+
+        // El contador solo cuenta dentro de las muestras, no al calibrar
+        ioctl(tlb_misses_.get(), PERF_EVENT_IOC_RESET, 0);
+        uint64_t syscalls_before = syscalls != nullptr ? syscalls->load() : 0;
+        counting_ = tlb_misses_.is_valid();
+        std::vector<double> per_op;
+        for (int i = 0; i < options_.samples; ++i) {
+            per_op.push_back(static_cast<double>(sample(iterations, op, setup)) / static_cast<double>(iterations));
+        }
+        std::sort(per_op.begin(), per_op.end());
+        double median = per_op[per_op.size() / 2];
+        double p90 = per_op[std::min(per_op.size() - 1, per_op.size() * 9 / 10)];
+        double mb_per_s = bytes_per_op == 0 ? 0 : static_cast<double>(bytes_per_op) * 1e3 / median;
+        std::printf("{\"bench\":\"%s\",\"case\":\"%s\",\"iterations\":%llu,\"samples\":%d,"
+                    "\"ns_per_op\":%.1f,\"p90_ns\":%.1f,\"min_ns\":%.1f,\"mb_per_s\":%.1f",
+                    bench.c_str(), variant.c_str(), static_cast<unsigned long long>(iterations), options_.samples,
+                    median, p90, per_op.front(), mb_per_s);
+        uint64_t misses = 0;
+        if (counting_ && read(tlb_misses_.get(), &misses, sizeof(misses)) == sizeof(misses)) {
+            std::printf(",\"dtlb_misses_per_op\":%.2f",
+                        static_cast<double>(misses) / static_cast<double>(iterations * static_cast<uint64_t>(options_.samples)));
+        }
+        counting_ = false;
+        if (syscalls != nullptr) {
+            std::printf(",\"server_syscalls_per_op\":%.2f",
+                        static_cast<double>(syscalls->load() - syscalls_before) /
+                            static_cast<double>(iterations * static_cast<uint64_t>(options_.samples)));
+        }
+        std::printf("}\n");
+        std::fflush(stdout);
+    }
+
+  private:
+    [[nodiscard]] bool matches(const std::string& name) const
+    {
+        return options_.filter.empty() || name.find(options_.filter) != std::string::npos;
+    }
+
+    uint64_t sample(uint64_t iterations, const std::function<void()>& op, const std::function<void()>& setup)
+    {
+        if (!setup) {
+            count(true);
+            uint64_t start = now_ns();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                op();
+            }
+            uint64_t elapsed = now_ns() - start;
+            count(false);
+            return elapsed;
+        }
+        uint64_t total = 0;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            setup();
+            count(true);
+            uint64_t start = now_ns();
+            op();
+            total += now_ns() - start;
+            count(false);
+        }
+        return total;
+    }
+
+    void count(bool enabled) const noexcept
+    {
+        if (counting_) {
+            ioctl(tlb_misses_.get(), enabled ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    const bench_options& options_;
+    SafeFD tlb_misses_;
+    bool counting_ = false;
+};
+
+// Directorio temporal con los archivos de los casos; se borra al terminar
+class BenchFixture
+{
+  public:
+    explicit BenchFixture()
+    {
+        char pattern[] = "/tmp/docbench.XXXXXX";
+        if (mkdtemp(pattern) == nullptr) {
+            fail("mkdtemp: " + std::string(strerror(errno)));
+        }
+        dir_ = pattern;
+    }
+    BenchFixture(const BenchFixture&) = delete;
+    BenchFixture& operator=(const BenchFixture&) = delete;
+    ~BenchFixture()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(dir_, error);
+    }
+
+    /// @brief Crea un archivo con el contenido indicado (y permisos de ejecución si se pide)
+    std::string file(const std::string& name, std::string_view content, bool executable = false)
+    {
+        std::string path = dir_ + "/" + name;
+        SafeFD fd{open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, executable ? 0755 : 0644)};
+        if (!fd.is_valid() || write(fd.get(), content.data(), content.size()) != static_cast<ssize_t>(content.size())) {
+            fail("no se pudo crear " + path);
+        }
+        return path;
+    }
+
+    [[nodiscard]] const std::string& dir() const noexcept
+    {
+        return dir_;
+    }
+
+  private:
+    std::string dir_;
+};
+
+/// @brief Saca un archivo de la caché de páginas (sus páginas están limpias: basta con DONTNEED)
+static void drop_page_cache(const std::string& path) {
+    SafeFD fd{open(path.c_str(), O_RDONLY)};
+    if (fd.is_valid()) {
+        posix_fadvise(fd.get(), 0, 0, POSIX_FADV_DONTNEED);
+    }
+}
+
+// Par de sockets conectados: "local" hace de servidor y "remote" de cliente
+struct socket_pair {
+    SafeFD local;
+    SafeFD remote;
+};
+
+static socket_pair make_socket_pair() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+        fail("socketpair: " + std::string(strerror(errno)));
+    }
+    int buffer_size = 4 << 20;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    return {SafeFD{fds[0]}, SafeFD{fds[1]}};
+}
+
+static std::string size_label(size_t size) {
+    if (size >= (1 << 20)) {
+        return std::to_string(size >> 20) + "M";
+    }
+    if (size >= (1 << 10)) {
+        return std::to_string(size >> 10) + "K";
+    }
+    return std::to_string(size) + "B";
+}
+
+// -------------------
+//       CASOS
+// -------------------
+
+static void bench_read_all(BenchRunner& runner, BenchFixture& fixture) {
+    for (size_t size : {size_t{4} << 10, size_t{64} << 10, size_t{1} << 20, size_t{16} << 20}) {
+        std::string path = fixture.file("doc_" + size_label(size), std::string(size, 'x'));
+        // Se toca un byte por página: mapear sin leer no mide nada
+        auto op = [&path] {
+            auto file = read_all(path.c_str());
+            std::string_view data = file->get();
+            unsigned sum = 0;
+            for (size_t offset = 0; offset < data.size(); offset += 4096) {
+                sum += static_cast<unsigned char>(data[offset]);
+            }
+            keep(sum);
+        };
+        runner.run("read_all", size_label(size) + "/warm", size, op);
+        runner.run("read_all", size_label(size) + "/cold", size, op, [&path] { drop_page_cache(path); });
+    }
+}
+
+static void bench_send_response(BenchRunner& runner) {
+    for (size_t size : {size_t{64}, size_t{4} << 10, size_t{64} << 10, size_t{1} << 20}) {
+        socket_pair sockets = make_socket_pair();
+        std::thread drain{[fd = sockets.remote.get()] {
+            std::vector<char> buffer(1 << 20);
+            while (read(fd, buffer.data(), buffer.size()) > 0) {
+            }
+        }};
+        std::string body(size, 'x');
+        std::string header = "Content-Length: " + std::to_string(size) + "\n\n";
+        runner.run("send_response", size_label(size), size + header.size() + 1, [&] {
+            keep(send_response(sockets.local, header, body));
+        });
+        shutdown(sockets.local.get(), SHUT_WR);
+        drain.join();
+    }
+}
+
+// 32 documentos de 1 KiB: una respuesta por documento frente a un lote (BUNDLE) con todos
+// ellos enviado con un solo send_parts
+static void bench_bundle(BenchRunner& runner) {
+    constexpr size_t documents = 32;
+    constexpr size_t size = 1024;
+    socket_pair sockets = make_socket_pair();
+    std::thread drain{[fd = sockets.remote.get()] {
+        std::vector<char> buffer(1 << 20);
+        while (read(fd, buffer.data(), buffer.size()) > 0) {
+        }
+    }};
+    std::vector<std::string> bodies(documents, std::string(size, 'x'));
+    std::string header = "Content-Length: " + std::to_string(size) + "\n\n";
+    std::vector<std::string> part_headers;
+    for (size_t i = 0; i < documents; ++i) {
+        part_headers.push_back("Document: /docs/d" + std::to_string(i) + ".txt\n" + header);
+    }
+    std::vector<std::string_view> parts{""};
+    for (size_t i = 0; i < documents; ++i) {
+        parts.insert(parts.end(), {part_headers[i], bodies[i], "\n"});
+    }
+    parts.push_back("\n");
+    uint64_t total = 0;
+    for (std::string_view part : parts) {
+        total += part.size();
+    }
+    std::string bundle_header = "Content-Length: " + std::to_string(total - 1) + "\n\n";
+    parts.front() = bundle_header;
+
+    runner.run("bundle", "32x1K/separate", documents * (size + header.size() + 1), [&] {
+        for (const std::string& body : bodies) {
+            keep(send_response(sockets.local, header, body));
+        }
+    });
+    runner.run("bundle", "32x1K/send_parts", total + bundle_header.size(), [&] {
+        keep(send_parts(sockets.local, parts));
+    });
+    shutdown(sockets.local.get(), SHUT_WR);
+    drain.join();
+}
+
+static void bench_receive_request(BenchRunner& runner) {
+    std::string request = "GET /docs/manual/capitulo-03/seccion-02/apartado-1.html\n" + std::string(160, ' ') + "\n";
+    for (size_t fragments : {1, 8, 64}) {
+        socket_pair sockets = make_socket_pair();
+        size_t piece = (request.size() + fragments - 1) / fragments;
+        // La petición llega en varios write() antes de que el servidor la lea
+        auto setup = [&] {
+            for (size_t offset = 0; offset < request.size(); offset += piece) {
+                std::string_view part = std::string_view{request}.substr(offset, piece);
+                keep(write(sockets.remote.get(), part.data(), part.size()));
+            }
+        };
+        runner.run("receive_request", std::to_string(fragments) + "_fragments", request.size(), [&] {
+            keep(receive_request(sockets.local, 4096));
+        }, setup);
+    }
+}
+
+static void bench_execute_program(BenchRunner& runner, BenchFixture& fixture) {
+    exec_environment env;
+    env.REQUEST_PATH = "/bin/bench";
+    env.SERVER_BASEDIR = fixture.dir();
+    env.REMOTE_PORT = "40000";
+    env.REMOTE_IP = "127.0.0.1";
+    std::pmr::string script{fixture.file("script.sh", "#!/bin/sh\necho hola\n", true)};
+    std::pmr::string binary{"/bin/true"};
+    runner.run("execute_program", "true", 0, [&] { keep(execute_program(binary, env)); });
+    runner.run("execute_program", "sh_script", 0, [&] { keep(execute_program(script, env)); });
+}
+
+static void bench_parse_args(BenchRunner& runner, BenchFixture& fixture) {
+    std::string routes = fixture.file("routes.txt", "static / /tmp/\n");
+    std::vector<std::string> minimal = {"docserver", "-p", "8080"};
+    std::vector<std::string> full = {"docserver", "-v", "-p", "8080", "-b", fixture.dir(), "--backlog", "512",
+                                     "--max-conn", "256", "--max-cgi", "16", "--read-timeout", "5000",
+                                     "--send-timeout", "10000", "--routes", routes, "--trace", "traza.json"};
+    for (auto* args : {&minimal, &full}) {
+        std::vector<char*> argv;
+        for (std::string& arg : *args) {
+            argv.push_back(arg.data());
+        }
+        argv.push_back(nullptr);
+        runner.run("parse_args", args == &minimal ? "minimal" : "full", 0, [&] {
+            keep(parse_args(static_cast<int>(argv.size() - 1), argv.data()));
+        });
+    }
+}
+
+static void bench_content_cache(BenchRunner& runner, BenchFixture& fixture) {
+    // Miles de documentos pequeños de tamaños variados, leídos enteros en orden aleatorio
+    constexpr size_t count = 4096;
+    std::vector<std::string> paths;
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        size_t size = size_t{512} << (i % 5); // 512 B .. 8 KiB
+        paths.push_back(fixture.file("hot_" + std::to_string(i), std::string(size, static_cast<char>('a' + i % 26))));
+        total += size;
+    }
+    std::vector<SafeMap> mapped;
+    ContentCache cache{total * 2, 64 << 10};
+    if (!cache.is_valid()) {
+        fail("no se pudo reservar la caché de contenidos");
+    }
+    std::vector<std::string_view> cached;
+    for (const std::string& path : paths) {
+        struct stat status;
+        auto file = read_all(path.c_str());
+        if (!file || stat(path.c_str(), &status) < 0) {
+            fail("no se pudo leer " + path);
+        }
+        cached.push_back(cache.insert(path, status, file->get()).value().content);
+        mapped.push_back(std::move(file.value()));
+    }
+    uint64_t bytes_per_op = total / count;
+
+    // Generador congruencial: el mismo recorrido en todos los casos, sin patrón para el prefetcher
+    uint32_t state = 1;
+    auto next = [&state] {
+        state = state * 1664525 + 1013904223;
+        return (state >> 8) % count;
+    };
+    auto touch = [](std::string_view data) {
+        unsigned sum = 0;
+        for (size_t offset = 0; offset < data.size(); offset += 64) {
+            sum += static_cast<unsigned char>(data[offset]);
+        }
+        keep(sum);
+    };
+
+    // Solo la lectura del contenido: un mapeo por archivo frente a la región contigua
+    runner.run("content_cache", "mapped_files", bytes_per_op, [&] { touch(mapped[next()].get()); });
+    runner.run("content_cache", "arena", bytes_per_op, [&] { touch(cached[next()]); });
+    // El camino completo de una petición: read_all (abrir, mapear, desmapear) frente a stat + búsqueda
+    runner.run("content_cache", "read_all_per_request", bytes_per_op, [&] {
+        auto file = read_all(paths[next()].c_str());
+        touch(file->get());
+    });
+    runner.run("content_cache", "lookup", bytes_per_op, [&] {
+        const std::string& path = paths[next()];
+        struct stat status;
+        stat(path.c_str(), &status);
+        touch(cache.find(path, status).value().content);
+    });
+}
+
+static void bench_rate_limit(BenchRunner& runner) {
+    // Muchos clientes distintos con fichas de sobra: sondeo de la tabla y CAS del cubo
+    RateLimiter generous{1000000, 1000000, 60};
+    uint32_t client = 0;
+    runner.run("rate_limit", "take_4096_clients", 0, [&] {
+        client = (client + 1) % RateLimiter::table_size;
+        keep(generous.try_take(htonl(0x0a000000 + client), RateLimiter::lane::statics));
+    });
+
+    // Rechazar a un cliente sin fichas con la respuesta precalculada, frente a un 404 completo
+    socket_pair sockets = make_socket_pair();
+    std::thread drain{[fd = sockets.remote.get()] {
+        std::vector<char> buffer(1 << 20);
+        while (read(fd, buffer.data(), buffer.size()) > 0) {
+        }
+    }};
+    RateLimiter strict{1, 1, 1};
+    in_addr_t noisy = htonl(0x0a000001);
+    keep(strict.try_take(noisy, RateLimiter::lane::cgi));
+    std::string rejection = "Error 429 Too Many Requests\nRetry-After: 1\n\n";
+    runner.run("rate_limit", "reject_429", rejection.size(), [&] {
+        if (!strict.try_take(noisy, RateLimiter::lane::cgi)) {
+            keep(send(sockets.local.get(), rejection.data(), rejection.size(), MSG_DONTWAIT | MSG_NOSIGNAL));
+        }
+    });
+    runner.run("rate_limit", "canned_404", 20, [&] {
+        keep(send_response(sockets.local, "Error", "404 Not Found\n"));
+    });
+    shutdown(sockets.local.get(), SHUT_WR);
+    drain.join();
+}
+
+// Servidor mínimo para tcp_policy, en su propio hilo: acepta con accept4() (no bloqueante),
+// lee la petición esperando con poll() si aún no ha llegado, responde con la cabecera y el
+// cuerpo en dos send() (como la cabecera y el sendfile() de --archive) y cierra. Cada llamada
+// al sistema que hace por petición suma uno en syscalls
+class PolicyServer
+{
+  public:
+    PolicyServer(const socket_policy& policy, size_t body_size)
+      : policy_{policy}, body_(body_size, 'x'), header_{"Content-Length: " + std::to_string(body_size) + "\n\n"}
+    {
+        auto listener = make_socket(0, 1024);
+        if (!listener) {
+            fail("make_socket: " + std::string(strerror(listener.error())));
+        }
+        listener_ = std::move(listener.value());
+        if (int error = configure_listener(listener_, policy_); error != 0) {
+            fail("configure_listener: " + std::string(strerror(error)));
+        }
+        sockaddr_in address{};
+        socklen_t length = sizeof(address);
+        getsockname(listener_.get(), reinterpret_cast<sockaddr*>(&address), &length);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address_ = address;
+        body_.push_back('\n');
+        thread_ = std::thread{[this] { run(); }};
+    }
+    PolicyServer(const PolicyServer&) = delete;
+    PolicyServer& operator=(const PolicyServer&) = delete;
+    ~PolicyServer()
+    {
+        stop_ = true;
+        thread_.join();
+    }
+
+    [[nodiscard]] const sockaddr_in& address() const noexcept
+    {
+        return address_;
+    }
+
+    [[nodiscard]] const std::atomic<uint64_t>& syscalls() const noexcept
+    {
+        return syscalls_;
+    }
+
+  private:
+    void run()
+    {
+        while (!stop_) {
+            pollfd ready{listener_.get(), POLLIN, 0};
+            count(1);
+            if (poll(&ready, 1, 50) <= 0) {
+                continue;
+            }
+            sockaddr_storage client_addr{};
+            count(1);
+            auto client = accept_connection(listener_, client_addr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (!client) {
+                continue;
+            }
+            count(policy_.nodelay ? 1 : 0);
+            configure_connection(client.value(), policy_, client_addr.ss_family);
+            serve(client.value(), client_addr.ss_family);
+            count(1); // close()
+        }
+    }
+
+    void serve(const SafeFD& client, sa_family_t family)
+    {
+        char request[512];
+        while (true) {
+            count(1);
+            ssize_t received = recv(client.get(), request, sizeof(request), 0);
+            if (received > 0) {
+                break;
+            }
+            if (received == 0 || errno != EAGAIN || !wait(client, POLLIN)) {
+                return;
+            }
+        }
+        ResponseCork cork{client, policy_, family};
+        count(policy_.cork ? 2 : 0);
+        for (std::string_view part : {std::string_view{header_}, std::string_view{body_}}) {
+            while (!part.empty()) {
+                count(1);
+                ssize_t sent = send(client.get(), part.data(), part.size(), MSG_NOSIGNAL);
+                if (sent > 0) {
+                    part.remove_prefix(static_cast<size_t>(sent));
+                } else if (sent < 0 && errno == EAGAIN && wait(client, POLLOUT)) {
+                    continue;
+                } else {
+                    return;
+                }
+            }
+        }
+    }
+
+    bool wait(const SafeFD& client, short events)
+    {
+        pollfd ready{client.get(), events, 0};
+        count(1);
+        return poll(&ready, 1, 1000) > 0;
+    }
+
+    void count(uint64_t calls) noexcept
+    {
+        syscalls_.fetch_add(calls, std::memory_order_relaxed);
+    }
+
+    socket_policy policy_;
+    std::string body_;
+    std::string header_;
+    SafeFD listener_;
+    sockaddr_in address_{};
+    std::atomic<uint64_t> syscalls_{0};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+/// @brief Una petición completa contra PolicyServer: conectar (o, con Fast Open, conectar y
+/// enviar en el SYN), pedir y leer hasta el cierre
+static void policy_request(const sockaddr_in& server, bool fastopen) {
+    static constexpr std::string_view request = "GET /docs/a.txt\n";
+    SafeFD socket_fd{socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+    const auto* address = reinterpret_cast<const sockaddr*>(&server);
+    if (fastopen) {
+        keep(sendto(socket_fd.get(), request.data(), request.size(), MSG_FASTOPEN | MSG_NOSIGNAL, address, sizeof(server)));
+    } else if (connect(socket_fd.get(), address, sizeof(server)) == 0) {
+        keep(send(socket_fd.get(), request.data(), request.size(), MSG_NOSIGNAL));
+    }
+    char buffer[65536];
+    while (read(socket_fd.get(), buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+static void bench_tcp_policy(BenchRunner& runner) {
+    struct policy_case {
+        const char* name;
+        socket_policy policy;
+        bool fastopen_client;
+    };
+    const policy_case cases[] = {
+        {"default", {}, false},
+        {"defer_accept", {.defer_accept_s = 5}, false},
+        {"fastopen", {.fastopen_queue = 256}, true},
+        {"nodelay", {.nodelay = true}, false},
+        {"cork", {.cork = true}, false},
+        {"all", {.defer_accept_s = 5, .fastopen_queue = 256, .nodelay = true, .cork = true}, true},
+    };
+    const size_t sizes[] = {size_t{1} << 10, size_t{256} << 10};
+    // El aviso solo importa si se va a medir algún caso con cliente Fast Open
+    bool measures_fastopen = std::ranges::any_of(sizes, [&](size_t size) {
+        return std::ranges::any_of(cases, [&](const policy_case& variant) {
+            return variant.fastopen_client && runner.will_measure("tcp_policy", size_label(size) + "/" + variant.name);
+        });
+    });
+    if (measures_fastopen) {
+        int fastopen_mode = 0;
+        std::ifstream{"/proc/sys/net/ipv4/tcp_fastopen"} >> fastopen_mode;
+        if ((fastopen_mode & 2) == 0) {
+            std::cerr << "Aviso: net.ipv4.tcp_fastopen no tiene el bit 2; tcp_policy/*/fastopen no llevará datos en el SYN\n";
+        }
+    }
+    for (size_t size : sizes) {
+        for (const policy_case& variant : cases) {
+            PolicyServer server{variant.policy, size};
+            runner.run("tcp_policy", size_label(size) + "/" + variant.name, size, [&] {
+                policy_request(server.address(), variant.fastopen_client);
+            }, {}, &server.syscalls());
+        }
+    }
+    // Búfer de envío grande: la respuesta de 256 KiB cabe entera y send() no espera a POLLOUT
+    PolicyServer server{{.send_buffer_kb = 1024}, size_t{256} << 10};
+    runner.run("tcp_policy", "256K/sndbuf_1M", size_t{256} << 10, [&] {
+        policy_request(server.address(), false);
+    }, {}, &server.syscalls());
+}
+
+int main(int argc, char* argv[]) {
+    bench_options options;
+    std::vector<std::string_view> args(argv + 1, argv + argc);
+    for (auto it = args.begin(), end = args.end(); it != end; ++it) {
+        if (*it == "-h" || *it == "--help") {
+            std::cout << "Uso: docbench [-h | --help] [-l | --list] [-f | --filter TEXTO] [-s | --samples N] [-t | --min-time MS]\n";
+            return EXIT_SUCCESS;
+        } else if (*it == "-l" || *it == "--list") {
+            options.list = true;
+        } else if ((*it == "-f" || *it == "--filter") && it + 1 != end) {
+            options.filter = std::string(*++it);
+        } else if ((*it == "-s" || *it == "--samples") && it + 1 != end && std::atoi((it + 1)->data()) > 0) {
+            options.samples = std::atoi((++it)->data());
+        } else if ((*it == "-t" || *it == "--min-time") && it + 1 != end && std::atoi((it + 1)->data()) > 0) {
+            options.min_sample_ns = static_cast<uint64_t>(std::atoi((++it)->data())) * 1000000;
+        } else {
+            std::cerr << "Error: opción desconocida o sin valor: " << *it << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Escribir en un socket cuyo otro extremo se ha cerrado no debe terminar el proceso
+    signal(SIGPIPE, SIG_IGN);
+
+    BenchFixture fixture;
+    BenchRunner runner{options};
+    bench_read_all(runner, fixture);
+    bench_send_response(runner);
+    bench_bundle(runner);
+    bench_receive_request(runner);
+    bench_execute_program(runner, fixture);
+    bench_parse_args(runner, fixture);
+    bench_content_cache(runner, fixture);
+    bench_rate_limit(runner);
+    bench_tcp_policy(runner);
+    return EXIT_SUCCESS;
+}
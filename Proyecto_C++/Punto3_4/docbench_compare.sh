@@ -0,0 +1,93 @@
+#!/bin/bash
+
+#
+# Proyecto C++: Servidor de Documentos
+# Compara dos ejecuciones de docbench (líneas JSON) y marca las regresiones.
+#
+# Uso: ./docbench_compare.sh BASE.jsonl NUEVO.jsonl [UMBRAL_%]
+# Un caso es una regresión si su mediana (ns_per_op) empeora más del umbral (10 % por defecto)
+# y además el mínimo del nuevo supera la mediana de la base, para no confundir ruido con
+# regresiones. Termina con código 1 si hay alguna.
+
+# Función para mostrar la ayuda
+function show_help() {
+    echo "Uso: $0 BASE.jsonl NUEVO.jsonl [UMBRAL_%]"
+    echo "  BASE.jsonl   Salida de docbench guardada como referencia"
+    echo "  NUEVO.jsonl  Salida de docbench con los cambios a evaluar"
+    echo "  UMBRAL_%     Empeoramiento máximo tolerado de la mediana (por defecto 10)"
+    exit 2
+}
+
+if [ "$1" == "-h" ] || [ $# -lt 2 ] || [ $# -gt 3 ]; then
+    show_help
+fi
+
+BASELINE="$1"
+CURRENT="$2"
+THRESHOLD="${3:-10}"
+
+for FILE in "$BASELINE" "$CURRENT"; do
+    if [ ! -r "$FILE" ]; then
+        echo "No se puede leer $FILE" >&2
+        exit 2
+    fi
+done
+
+if ! [[ "$THRESHOLD" =~ ^[0-9]+([.][0-9]+)?$ ]]; then
+    echo "El umbral debe ser un número" >&2
+    exit 2
+fi
+
+# Las líneas JSON de docbench son planas: cada campo se extrae con una expresión regular
+awk -v threshold="$THRESHOLD" '
+    function field(line, name,    pattern, value) {
+        pattern = "\"" name "\":(\"[^\"]*\"|[-0-9.eE+]+)"
+        if (!match(line, pattern)) {
+            return ""
+        }
+        value = substr(line, RSTART + length(name) + 3, RLENGTH - length(name) - 3)
+        gsub(/"/, "", value)
+        return value
+    }
+    FNR == 1 { file++ }
+    /^\{/ {
+        key = field($0, "bench") "/" field($0, "case")
+        if (file == 1) {
+            base_median[key] = field($0, "ns_per_op")
+            order[++count] = key
+        } else {
+            new_median[key] = field($0, "ns_per_op")
+            new_min[key] = field($0, "min_ns")
+            if (!(key in base_median)) {
+                added[++added_count] = key
+            }
+        }
+    }
+    END {
+        printf "%-36s %14s %14s %9s\n", "CASO", "BASE (ns)", "NUEVO (ns)", "CAMBIO"
+        regressions = 0
+        for (i = 1; i <= count; i++) {
+            key = order[i]
+            if (!(key in new_median)) {
+                printf "%-36s %14.1f %14s %9s\n", key, base_median[key], "-", "ausente"
+                continue
+            }
+            change = base_median[key] > 0 ? (new_median[key] - base_median[key]) * 100 / base_median[key] : 0
+            mark = ""
+            if (change > threshold && new_min[key] > base_median[key]) {
+                mark = "  REGRESIÓN"
+                regressions++
+            } else if (change < -threshold) {
+                mark = "  mejora"
+            }
+            printf "%-36s %14.1f %14.1f %+8.1f%%%s\n", key, base_median[key], new_median[key], change, mark
+        }
+        for (i = 1; i <= added_count; i++) {
+            printf "%-36s %14s %14.1f %9s\n", added[i], "-", new_median[added[i]], "nuevo"
+        }
+        if (regressions > 0) {
+            printf "\n%d regresiones por encima del %s%%\n", regressions, threshold
+            exit 1
+        }
+    }
+' "$BASELINE" "$CURRENT"
@@ -0,0 +1,39 @@
+/**
+ * Universidad de La Laguna
+ * Escuela Superior de Ingeniería y Tecnología
+ * Asignatura: Sistemas Operativos (SSOO)
+ * Curso: 2º
+ * Proyecto C++: Servidor de Documentos
+ * @author 
+ * @file docpack.cc
+ * @brief docpack [-h | --help] DIRECTORIO ARCHIVO
+ *
+ * Empaqueta el directorio base de docserver en un único archivo con los contenidos alineados
+ * a página, la cabecera de respuesta de cada documento ya calculada y un índice de hash
+ * perfecto mínimo. docserver lo sirve con la opción --archive ARCHIVO.
+ *
+ * Compilar con: g++ -std=c++23 docpack.cc Archive.cc Functions.cc -o docpack
+*/
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include "Archive.h"
+
+int main(int argc, char* argv[]) {
+    if (argc == 2 && (std::string_view(argv[1]) == "-h" || std::string_view(argv[1]) == "--help")) {
+        std::cout << "Uso: docpack [-h | --help] DIRECTORIO ARCHIVO\n";
+        return EXIT_SUCCESS;
+    }
+    if (argc != 3) {
+        std::cerr << "Error: se esperaba un directorio y un archivo de salida\n";
+        return EXIT_FAILURE;
+    }
+    auto packed = build_archive(argv[1], argv[2]);
+    if (!packed) {
+        std::cerr << "Error al empaquetar " << argv[1] << ": " << strerror(packed.error()) << '\n';
+        return EXIT_FAILURE;
+    }
+    std::cout << "Empaquetados " << packed.value() << " documentos en " << argv[2] << '\n';
+    return EXIT_SUCCESS;
+}
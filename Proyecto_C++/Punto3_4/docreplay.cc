@@ -0,0 +1,262 @@
+/**
+ * Universidad de La Laguna
+ * Escuela Superior de Ingeniería y Tecnología
+ * Asignatura: Sistemas Operativos (SSOO)
+ * Curso: 2º
+ * Proyecto C++: Servidor de Documentos
+ * @author
+ * @file docreplay.cc
+ * @brief docreplay [-h | --help] [-c | --connections N] [-x | --speed FACTOR] [--fast]
+ *        (HOST PUERTO | --unix RUTA) CAPTURA
+ *
+ * Reproduce una captura de docserver (--capture) contra un servidor de pruebas: cada petición
+ * se envía en su propia conexión, con sus bytes originales, desde N conexiones a la vez.
+ *   - Por defecto respeta el horario de la captura (--speed 2 lo comprime a la mitad).
+ *   - Con --fast envía las peticiones en orden tan rápido como lo permitan las N conexiones.
+ * Las peticiones capturadas sin todo su cuerpo (capture_truncated) no se pueden reenviar y se
+ * omiten. Al terminar resume la latencia (desde connect() hasta el cierre de la respuesta), el
+ * retraso sobre el horario original y las respuestas cuyo tamaño difiere del capturado.
+ *
+ *   ./a.out --capture trafico.cap ...          (servidor en producción)
+ *   ./docreplay -c 32 127.0.0.1 8081 trafico.cap
+ *   ./docreplay -c 32 --unix /run/docserver.sock trafico.cap     (servidor con --unix)
+ *
+ * Compilar con: g++ -std=c++23 -O2 -pthread docreplay.cc Capture.cc Functions.cc -o docreplay
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <cstdio>
+#include <csignal>
+#include <ctime>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "Functions.h"
+#include "Capture.h"
+
+// Opciones de la reproducción
+struct replay_options {
+    int connections = 16;   // Conexiones simultáneas
+    double speed = 1.0;     // Factor de velocidad sobre el horario original
+    bool fast = false;      // Ignorar el horario y enviar sin pausas
+    sockaddr_in server{};
+    std::string unix_path;  // Si no está vacía, se conecta a este socket Unix en lugar de server
+    std::string capture_path;
+};
+
+// Resultado de reproducir una petición
+struct replay_result {
+    uint64_t latency_ns = 0;
+    uint64_t lateness_ns = 0;     // Retraso del envío sobre su hora prevista
+    uint64_t response_bytes = 0;
+    int error = 0;                // errno de connect/send/recv o 0
+};
+
+static uint64_t monotonic_ns() noexcept {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000 + static_cast<uint64_t>(now.tv_nsec);
+}
+
+/// @brief Abre una conexión nueva con el servidor
+/// @param options Dirección TCP o socket Unix del servidor
+/// @return Socket conectado o errno
+static std::expected<SafeFD, int> connect_server(const replay_options& options) {
+    if (!options.unix_path.empty()) {
+        return connect_unix_socket(options.unix_path);
+    }
+    SafeFD socket_fd{socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+    if (!socket_fd.is_valid() ||
+        connect(socket_fd.get(), reinterpret_cast<const sockaddr*>(&options.server), sizeof(options.server)) < 0) {
+        return std::unexpected(errno);
+    }
+    return socket_fd;
+}
+
+/// @brief Envía una petición en una conexión nueva y lee la respuesta hasta el cierre
+/// @param options Dirección del servidor
+/// @param request Bytes de la petición
+/// @param result Tamaño de la respuesta o error
+static void replay_request(const replay_options& options, std::string_view request, replay_result& result) {
+    auto connected = connect_server(options);
+    if (!connected) {
+        result.error = connected.error();
+        return;
+    }
+    const SafeFD& socket_fd = connected.value();
+    while (!request.empty()) {
+        ssize_t sent = send(socket_fd.get(), request.data(), request.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result.error = errno;
+            return;
+        }
+        request.remove_prefix(static_cast<size_t>(sent));
+    }
+    char buffer[65536];
+    while (true) {
+        ssize_t received = recv(socket_fd.get(), buffer, sizeof(buffer), 0);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result.error = errno;
+            return;
+        }
+        if (received == 0) {
+            return;
+        }
+        result.response_bytes += static_cast<uint64_t>(received);
+    }
+}
+
+/// @brief Percentil de unas muestras ya ordenadas, en microsegundos
+static double percentile_us(const std::vector<uint64_t>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1, static_cast<size_t>(fraction * static_cast<double>(sorted.size())));
+    return static_cast<double>(sorted[index]) / 1000.0;
+}
+
+int main(int argc, char* argv[]) {
+    replay_options options;
+    std::vector<std::string_view> positional;
+    std::vector<std::string_view> args(argv + 1, argv + argc);
+    for (auto it = args.begin(), end = args.end(); it != end; ++it) {
+        if (*it == "-h" || *it == "--help") {
+            std::cout << "Uso: docreplay [-h | --help] [-c | --connections N] [-x | --speed FACTOR] [--fast]\n"
+                      << "       (HOST PUERTO | --unix RUTA) CAPTURA\n";
+            return EXIT_SUCCESS;
+        } else if ((*it == "-c" || *it == "--connections") && it + 1 != end && std::atoi((it + 1)->data()) > 0) {
+            options.connections = std::atoi((++it)->data());
+        } else if ((*it == "-x" || *it == "--speed") && it + 1 != end && std::atof((it + 1)->data()) > 0) {
+            options.speed = std::atof((++it)->data());
+        } else if (*it == "--fast") {
+            options.fast = true;
+        } else if (*it == "--unix" && it + 1 != end && (it + 1)->size() < sizeof(sockaddr_un::sun_path)) {
+            options.unix_path = *++it;
+        } else if (!it->starts_with("-")) {
+            positional.push_back(*it);
+        } else {
+            std::cerr << "Error: opción desconocida o sin valor: " << *it << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    if (positional.size() != (options.unix_path.empty() ? 3 : 1)) {
+        std::cerr << "Error: se esperaba HOST PUERTO CAPTURA o --unix RUTA CAPTURA\n";
+        return EXIT_FAILURE;
+    }
+    if (options.unix_path.empty()) {
+        options.server.sin_family = AF_INET;
+        int port = std::atoi(positional[1].data());
+        if (inet_pton(AF_INET, positional[0].data(), &options.server.sin_addr) != 1 || port <= 0 || port > 65535) {
+            std::cerr << "Error: dirección IPv4 o puerto no válidos\n";
+            return EXIT_FAILURE;
+        }
+        options.server.sin_port = htons(static_cast<uint16_t>(port));
+    }
+    options.capture_path = positional.back();
+
+    auto data = read_all(options.capture_path.c_str());
+    if (!data) {
+        std::cerr << "Error al leer " << options.capture_path << ": " << strerror(data.error()) << '\n';
+        return EXIT_FAILURE;
+    }
+    auto capture = parse_capture(data->get());
+    if (!capture) {
+        std::cerr << "Error: " << options.capture_path << " no es una captura de docserver\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<captured_request> requests;
+    requests.reserve(capture->requests.size());
+    std::ranges::copy_if(capture->requests, std::back_inserter(requests),
+                         [](const captured_request& entry) { return (entry.record.flags & capture_truncated) == 0; });
+    if (size_t skipped = capture->requests.size() - requests.size()) {
+        std::cout << "Omitidas " << skipped << " peticiones capturadas sin su cuerpo completo\n";
+    }
+    if (requests.empty()) {
+        std::cout << "La captura no contiene peticiones\n";
+        return EXIT_SUCCESS;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    // Cada conexión toma la siguiente petición pendiente; en modo temporizado espera a su
+    // hora (relativa a la primera petición) antes de enviarla. Cada resultado solo lo
+    // escribe el hilo que atendió su petición.
+    std::vector<replay_result> results(requests.size());
+    std::atomic<size_t> next{0};
+    uint64_t first_arrival = requests.front().record.arrival_ns;
+    uint64_t start = monotonic_ns();
+    auto worker = [&] {
+        for (size_t i = next.fetch_add(1); i < requests.size(); i = next.fetch_add(1)) {
+            replay_result& result = results[i];
+            uint64_t due = start;
+            if (!options.fast) {
+                due += static_cast<uint64_t>(static_cast<double>(requests[i].record.arrival_ns - first_arrival) / options.speed);
+                timespec wakeup{static_cast<time_t>(due / 1000000000), static_cast<long>(due % 1000000000)};
+                while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, nullptr) == EINTR) {
+                }
+            }
+            uint64_t sent_at = monotonic_ns();
+            result.lateness_ns = sent_at - due;
+            replay_request(options, requests[i].request, result);
+            result.latency_ns = monotonic_ns() - sent_at;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.connections; ++i) {
+        workers.emplace_back(worker);
+    }
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+    uint64_t elapsed = monotonic_ns() - start;
+
+    // Resumen
+    size_t errors = 0;
+    size_t mismatched = 0;
+    std::vector<uint64_t> latencies;
+    std::vector<uint64_t> lateness;
+    latencies.reserve(results.size());
+    lateness.reserve(results.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i].error != 0) {
+            ++errors;
+            continue;
+        }
+        // Sin respuesta capturada (status 0) no hay tamaño con el que comparar
+        if (requests[i].record.status != 0 && results[i].response_bytes != requests[i].record.response_bytes) {
+            ++mismatched;
+        }
+        latencies.push_back(results[i].latency_ns);
+        lateness.push_back(results[i].lateness_ns);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(lateness.begin(), lateness.end());
+    double seconds = static_cast<double>(elapsed) / 1e9;
+    double captured_seconds = static_cast<double>(requests.back().record.arrival_ns - first_arrival) / 1e9;
+
+    std::printf("Peticiones: %zu (%zu errores, %zu respuestas de tamaño distinto al capturado)\n",
+                requests.size(), errors, mismatched);
+    std::printf("Duración: %.3f s (captura: %.3f s), %.1f peticiones/s con %d conexiones\n",
+                seconds, captured_seconds, static_cast<double>(requests.size()) / seconds, options.connections);
+    std::printf("Latencia (µs): p50 %.1f  p90 %.1f  p99 %.1f  máx %.1f\n",
+                percentile_us(latencies, 0.5), percentile_us(latencies, 0.9), percentile_us(latencies, 0.99),
+                percentile_us(latencies, 1.0));
+    if (!options.fast) {
+        std::printf("Retraso sobre el horario (µs): p50 %.1f  p99 %.1f  máx %.1f\n",
+                    percentile_us(lateness, 0.5), percentile_us(lateness, 0.99), percentile_us(lateness, 1.0));
+    }
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
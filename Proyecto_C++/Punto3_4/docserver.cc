@@ -7,11 +7,131 @@
  * @author 
  * @file docserver.cc
  * @brief docserver [-v | --verbose] [-h | --help] [-p | --port] [-b | --base]
+ *        [--backlog N] [--max-conn N] [--max-cgi N] [--max-static N] [--retry-after S]
+ *        [--read-timeout MS] [--send-timeout MS] [--cgi-timeout MS]
+ *        [--upgrade-socket RUTA] [--inherit RUTA] [--drain-timeout MS] [--archive ARCHIVO]
+ *        [--routes ARCHIVO] [--trace ARCHIVO] [--capture ARCHIVO]
+ *        [--workers N] [--cpus LISTA] [--incoming-cpu] [--cache MB] [--cache-max-file KB] [--async]
+ *        [--processes N] [--shared-cache MB] [--rate-static N] [--rate-cgi N] [--rate-burst S]
+ *        [--max-body KB] [--listings] [--hot-set ARCHIVO] [--hot-set-interval S]
+ *        [--file-threads N] [--process-threads N] [--unix RUTA]
+ *        [--defer-accept S] [--fastopen N] [--nodelay] [--cork] [--sndbuf KB] [--rcvbuf KB]
  * @bug No hay bugs conocidos
- *     
- * Compilar con: g++ -std=c++23 docserver.cc Functions.cc
+ *
+ * Compilar con: g++ -std=c++23 -pthread docserver.cc Functions.cc Archive.cc Router.cc Trace.cc Capture.cc ContentCache.cc Async.cc SharedCache.cc Listing.cc HotSet.cc WorkPool.cc SocketPolicy.cc
  * Ejecutar: ./a.out -b /home/usuario/Proyecto_C++/Punto3_4
  * socat STDIO TCP:127.0.0.1:8080
+ *
+ * Detrás de un proxy en la misma máquina: ./a.out --unix /run/docserver.sock (o --unix @docserver)
+ * Escucha en un socket Unix en lugar de TCP (con '@', en el espacio abstracto: sin archivo ni
+ * permisos que gestionar). El salto proxy-servidor se ahorra la pila TCP de loopback. Los
+ * programas CGI reciben REMOTE_IP=unix y REMOTE_PORT vacío, y --rate-static/--rate-cgi no se
+ * aplican: sin IP de cliente, limitar es cosa del proxy.
+ *   socat STDIO UNIX-CONNECT:/run/docserver.sock       socat STDIO ABSTRACT-CONNECT:docserver
+ *
+ * Ajustes TCP (SocketPolicy.h): ./a.out --defer-accept 5 --fastopen 256 --nodelay --cork
+ *                                 [--sndbuf 256] [--rcvbuf 64]
+ * accept() solo despierta cuando ya ha llegado la petición, la petición puede viajar en el SYN,
+ * y cada respuesta sale tapada con TCP_CORK y sin Nagle. Los sockets se aceptan siempre con
+ * accept4() y CLOEXEC. Efecto de cada ajuste: ./docbench -f tcp_policy
+ *
+ * Reinicio sin cortes:
+ *   ./a.out -b ... --upgrade-socket /tmp/docserver.sock               (servidor en marcha)
+ *   ./nuevo -b ... --inherit /tmp/docserver.sock --upgrade-socket /tmp/docserver.sock
+ * El nuevo binario recibe el socket de escucha del anterior y, cuando ha terminado de arrancar,
+ * lo confirma; solo entonces el anterior deja de aceptar, espera a que terminen las conexiones
+ * en curso y sale. Si el nuevo falla al arrancar, el anterior sigue atendiendo. Nunca hay un
+ * instante sin nadie escuchando.
+ *
+ * Modo archivo: ./docpack DIRECTORIO docs.pack && ./a.out --archive docs.pack [-b DIRECTORIO]
+ * Los documentos se sirven desde el archivo mapeado (los programas de /bin/ siguen en -b).
+ *
+ * Tabla de rutas (--routes), una por línea, gana el prefijo más largo:
+ *   static   /docs/   /srv/docs/   archivos de un directorio
+ *   cgi      /bin/    /srv/bin/    programas (entorno como en Punto 4)
+ *   plugin   /hola    ./hola.so    extern "C" int docserver_plugin(...) (ver Router.h)
+ *   internal /status  status       ocupación del servidor (o "routes": la propia tabla)
+ * Sin --routes: cgi /bin/ -> BASE/bin/ y static / -> BASE/.
+ *
+ * Trazas por fase (accept, receive_request, route, read_all, execute_program, send_response):
+ *   ./a.out --trace traza.json        activas desde el arranque
+ *   kill -USR2 PID                    activa/desactiva; al desactivar se vuelcan (por defecto
+ *                                     en docserver-trace.json) para abrir en chrome://tracing
+ * Con <sys/sdt.h> las fases son además sondas USDT docserver:phase__start/phase__end.
+ *
+ * Captura de tráfico real para reproducirlo después contra otro servidor:
+ *   ./a.out --capture trafico.cap     graba llegada, petición, cliente y respuesta de cada una
+ *   ./docreplay -c 32 127.0.0.1 8081 trafico.cap      (ver docreplay.cc)
+ *
+ * Hilos de aceptación y afinidad (máquinas con varios sockets):
+ *   ./a.out --cpus 0-7 --workers 8    un hilo de aceptación por CPU, fijado a ella; sus
+ *                                     conexiones heredan la CPU y piden memoria a su nodo NUMA
+ *   ./a.out --cpus 0-7 --incoming-cpu además, un socket de escucha por hilo (SO_REUSEPORT) y
+ *                                     SO_INCOMING_CPU: cada conexión la acepta el hilo de la
+ *                                     CPU que atiende su cola de la tarjeta de red (hay que
+ *                                     dirigir las IRQ de la tarjeta a esas mismas CPU)
+ * Sin --workers hay un hilo de aceptación por CPU de --cpus, o uno solo.
+ *
+ * Caché de contenidos: ./a.out --cache 256 [--cache-max-file 64]
+ * Los documentos de hasta 64 KiB se copian al pedirlos en una región de 256 MiB de páginas
+ * enormes, agrupados por tamaño; se siguen comprobando con stat() en cada petición.
+ *
+ * Modo asíncrono: ./a.out --async [--workers N] [--file-threads 4] [--process-threads 2]
+ * Cada hilo de aceptación atiende todas sus conexiones con corrutinas sobre epoll (Async.h)
+ * en lugar de lanzar un hilo por conexión. Lo que puede bloquear en el disco (stat(), leer un
+ * documento, índices) o al lanzar procesos (fork() del CGI, plugins) lo hacen dos grupos de
+ * hilos con robo de tareas (WorkPool.h), cada uno con sus colas, y la corrutina sigue en su
+ * bucle al terminar. Las trazas por fase no se apuntan en este modo:
+ * las fases de corrutinas distintas se entrelazan en el mismo hilo.
+ *
+ * Procesos de trabajo: ./a.out --processes 4 --shared-cache 256 [--cache-max-file 64]
+ * Cuatro procesos aceptan en el mismo socket. La caché compartida (memfd) guarda los documentos
+ * pequeños con su cabecera ya formateada: lo que lee un proceso lo encuentra ya cualquier otro.
+ * Los límites de admisión y los hilos de --workers son por proceso.
+ *
+ * Límite por cliente: ./a.out --rate-static 50 --rate-cgi 2 [--rate-burst 5]
+ * Cada IP puede hacer 50 peticiones por segundo a rutas no CGI y lanzar 2 programas por
+ * segundo, con ráfagas de hasta 5 segundos de ritmo; por encima recibe un 429 precalculado.
+ *
+ * Peticiones con cuerpo (solo hacia CGI), con cabeceras hasta una línea vacía:
+ *   POST /bin/subir                     PUT /bin/subir
+ *   Content-Length: 5                   Transfer-Encoding: chunked
+ *
+ *   hola                                5\r\nhola\n\r\n0\r\n\r\n
+ * El cuerpo llega a la entrada estándar del programa con splice(), sin guardarlo entero, y el
+ * programa recibe REQUEST_METHOD y CONTENT_LENGTH. --max-body (1024 KiB por defecto) limita su
+ * tamaño: por encima se responde 413. Si queda cuerpo sin leer (413, 405 o un programa que no lo
+ * lee entero), se descarta hasta 256 KiB durante 1 s antes de cerrar, para que el cierre no
+ * envíe un RST que haga perder la respuesta al cliente. Estas peticiones se capturan sin la
+ * parte del cuerpo que no llegó con las cabeceras y docreplay no las reproduce.
+ *
+ * Índices de directorio: ./a.out --listings
+ * Pedir un directorio de una ruta estática devuelve sus entradas, una por línea (los
+ * subdirectorios con '/'). Cada índice se construye con getdents64() la primera vez, se
+ * guarda formateado en un memfd y se envía con sendfile(); inotify lo descarta cuando el
+ * directorio cambia. Sin --listings, pedir un directorio responde 403.
+ *
+ * Lotes de documentos: varios documentos estáticos en una sola petición y una sola respuesta
+ *   BUNDLE /docs/                       Content-Length: 84
+ *   Document: a.txt                     (línea vacía)
+ *   Document: guia/b.txt                Document: /docs/a.txt
+ *   (línea vacía)                       Content-Length: 3
+ *                                       (línea vacía)
+ *                                       hol
+ *                                       Document: /docs/guia/b.txt
+ *                                       Error: 404
+ *                                       (línea vacía)
+ *
+ * Hasta 64 documentos (si no, 413), cada uno con su ruta de la tabla; el lote cuenta como
+ * una petición por documento para --rate-static. El cuerpo se envía con sendmsg() desde los
+ * mapeos (o las cachés) de todos los documentos, sin copiarlos.
+ *
+ * Conjunto caliente: ./a.out --hot-set caliente.txt [--hot-set-interval 60] [--cache 256]
+ * Se cuentan los aciertos y bytes de cada documento y cada 60 segundos (y al terminar) se
+ * guardan los 1024 más pedidos en caliente.txt. Al arrancar, un hilo lee de antemano los
+ * documentos del manifiesto anterior (readahead(), y la caché si la hay) mientras se empieza
+ * a aceptar: tras un reinicio el tráfico no se encuentra la caché de páginas fría. Con
+ * --processes solo cuenta el primer proceso.
 */
 
 #include <iostream>
@@ -27,7 +147,1731 @@
 #include <sstream>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <csignal>
+#include <thread>
+#include <chrono>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <functional>
+#include <cstring>
+#include <charconv>
+#include <algorithm>
+#include <memory_resource>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <sys/timerfd.h>
+#include <netinet/tcp.h>
 #include "Functions.h"
+#include "Admission.h"
+#include "Watchdog.h"
+#include "Archive.h"
+#include "Router.h"
+#include "Arena.h"
+#include "Trace.h"
+#include "Capture.h"
+#include "ContentCache.h"
+#include "Async.h"
+#include "SharedCache.h"
+#include "RateLimit.h"
+#include "Listing.h"
+#include "HotSet.h"
+#include "WorkPool.h"
+#include "SocketPolicy.h"
+
+// Estado compartido por todas las conexiones
+struct server_context {
+    const program_options& options;
+    admission_control& admission;
+    Watchdog& watchdog;
+    const ContentArchive* archive; // nullptr si no se usa --archive
+    const Router& router;
+    std::string base_dir;          // Directorio base (-b o el directorio actual)
+    CaptureWriter* capture;        // nullptr si no se usa --capture
+    ContentCache* cache;           // nullptr si no se usa --cache
+    SharedCache* shared_cache;     // nullptr si no se usa --shared-cache
+    RateLimiter* rate_limiter;     // nullptr si no se usa --rate-static ni --rate-cgi
+    ListingCache* listings;        // nullptr si no se usa --listings
+    HotSet* hot_set;               // nullptr sin --hot-set (y en los procesos de trabajo)
+    WorkPool* work_pool;           // Hilos para lo que bloquea; nullptr sin --async
+};
+
+/// @brief Rechaza una conexión con una respuesta precalculada (503 o 429), sin bloquear
+/// @param socket
+/// @param response
+/// @return Bytes enviados o -1
+static ssize_t reject_connection(const SafeFD& socket, std::string_view response) {
+    return send(socket.get(), response.data(), response.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+// Lo que espera el servidor anterior a que el nuevo confirme que ha arrancado
+constexpr int hand_off_confirm_timeout_ms = 30000;
+
+/// @brief Obtiene el socket de escucha de un servidor anterior (reinicio sin cortes)
+/// @param path Socket Unix de relevo del servidor anterior
+/// @param channel Conexión de relevo, abierta hasta confirmar el arranque con confirm_hand_off
+/// @return SafeFD con el socket de escucha
+static std::expected<SafeFD, int> inherit_listener(const std::string& path, SafeFD& channel) {
+    auto connected = connect_unix_socket(path);
+    if (!connected) {
+        return std::unexpected(connected.error());
+    }
+    channel = std::move(connected.value());
+    return receive_descriptor(channel);
+}
+
+/// @brief Confirma al servidor anterior que este ya ha arrancado y puede dejar de aceptar
+/// @param channel Conexión de relevo de inherit_listener
+/// @return 0 o errno (EPIPE si el anterior ya no esperaba y sigue aceptando él)
+static int confirm_hand_off(const SafeFD& channel) {
+    return send(channel.get(), "1", 1, MSG_NOSIGNAL) == 1 ? 0 : errno;
+}
+
+/// @brief Entrega el socket de escucha al proceso que se conecta al socket de relevo y espera a
+/// que confirme su arranque. Si el nuevo proceso termina antes o no confirma a tiempo, este
+/// sigue aceptando: nadie más tiene el socket de escucha
+/// @param control Socket Unix de relevo
+/// @param listener Socket de escucha
+/// @return true si el relevo se completó y este proceso debe dejar de aceptar
+static bool hand_off_listener(const SafeFD& control, const SafeFD& listener) {
+    // CLOEXEC: los programas CGI no deben heredar la conexión de relevo
+    SafeFD channel{accept4(control.get(), nullptr, nullptr, SOCK_CLOEXEC)};
+    if (!channel.is_valid() || send_descriptor(channel, listener) != 0) {
+        return false;
+    }
+    pollfd ready{channel.get(), POLLIN, 0};
+    char confirmation;
+    return poll(&ready, 1, hand_off_confirm_timeout_ms) == 1 && recv(channel.get(), &confirmation, 1, 0) == 1;
+}
+
+// Lo más que se lee de una petición antes de su cuerpo (primera línea y cabeceras)
+constexpr size_t max_request_head = 4096;
+
+/// @brief Métodos cuya primera línea va seguida de cabeceras hasta una línea vacía
+static bool has_headers(std::string_view method) {
+    return method == "POST" || method == "PUT" || method == "BUNDLE";
+}
+
+// Respuesta dada a una petición (la graba --capture)
+struct request_outcome {
+    uint16_t status = 0;             // 0 si no se llegó a responder
+    uint64_t bytes = 0;              // Bytes enviados al cliente
+    bool streamed_body = false;      // Parte del cuerpo no llegó con las cabeceras (no se captura)
+    bool unread_body = false;        // Puede quedar cuerpo sin leer: hay que vaciarlo antes de cerrar
+};
+
+// Cabecera y cuerpo de una respuesta (el '\n' final lo añade quien la envía)
+struct response_parts {
+    std::string_view header;
+    std::string_view body;
+};
+
+/// @brief Respuesta de error con el formato de siempre
+/// @param status 400, 403, 404, 405, 413, 504 (cualquier otro pasa a ser 500)
+/// @param length Búfer para la cabecera del 500
+/// @return response_parts
+static response_parts error_response(uint16_t& status, char (&length)[content_length_capacity]) {
+    std::string_view header = "Error";
+    std::string_view body;
+    switch (status) {
+        case 400:
+            header = "Error ";
+            body = "400 Bad Request\n";
+            break;
+        case 403:
+            body = "403 Forbidden\n";
+            break;
+        case 404:
+            body = "404 Not Found\n";
+            break;
+        case 405:
+            body = "405 Method Not Allowed\n";
+            break;
+        case 413:
+            body = "413 Payload Too Large\n";
+            break;
+        case 504:
+            body = "504 Gateway Timeout\n";
+            break;
+        default:
+            status = 500;
+            body = "500 Internal Server Error\n";
+            header = format_content_length(length, body.size());
+            break;
+    }
+    return {header, body};
+}
+
+/// @brief Envía una respuesta de error y la apunta en el resultado de la petición
+/// @param client
+/// @param outcome
+/// @param status 400, 403, 404, 405, 413, 504 (cualquier otro se responde como 500)
+static void send_error(const SafeFD& client, request_outcome& outcome, uint16_t status) {
+    char length[content_length_capacity];
+    auto [header, body] = error_response(status, length);
+    int sent = send_response(client, header, body);
+    outcome.status = status;
+    outcome.bytes = sent > 0 ? static_cast<uint64_t>(sent) : 0;
+}
+
+// Petición ya leída y enrutada
+struct request_context {
+    const SafeFD& client;
+    const sockaddr_storage& client_addr;
+    server_context& server;
+    Deadline& deadline;
+    std::function<void()> abort_io;  // Corta la E/S bloqueada del socket al vencer un plazo
+    std::string_view file_path;      // Ruta pedida
+    const route& matched;
+    std::string_view remainder;      // Ruta pedida sin el prefijo de la ruta
+    std::pmr::memory_resource* arena; // Memoria de la petición (se libera entera al terminar)
+    request_outcome& outcome;
+    std::string_view method;         // GET, o POST/PUT hacia un CGI
+    const request_body& body;        // Cuerpo pendiente de enviar al programa
+    std::string_view buffered_body;  // Parte del cuerpo que llegó junto a las cabeceras
+    std::string_view raw_request;    // Petición tal y como se recibió (la lista de un lote)
+};
+
+/// @brief Ruta en disco: destino de la ruta seguido del resto de la ruta pedida, en la arena
+/// @param request
+/// @return std::pmr::string
+static std::pmr::string target_path(const request_context& request) {
+    std::pmr::string complete_path{request.arena};
+    complete_path.reserve(request.matched.target.size() + request.remainder.size());
+    complete_path.append(request.matched.target).append(request.remainder);
+    return complete_path;
+}
+
+/// @brief Envía una respuesta completa con su Content-Length
+/// @param request
+/// @param body Cuerpo de la respuesta
+/// @param header Cabecera ya calculada (si está vacía se calcula aquí)
+static void send_body(const request_context& request, std::string_view body, std::string_view header = {}) {
+    char length[content_length_capacity];
+    if (header.empty()) {
+        header = format_content_length(length, body.size());
+    }
+    // Enviar la respuesta al cliente
+    int send_result = [&] {
+        TraceSpan span{"send_response"};
+        return send_response(request.client, header, body);
+    }();
+    request.outcome.status = 200;
+    request.outcome.bytes = send_result > 0 ? static_cast<uint64_t>(send_result) : 0;
+    if (request.deadline.expired()) {
+        std::cerr << "Error: tiempo de espera agotado al enviar la respuesta\n";
+        return;
+    }
+    if (send_result < 0 && errno == ECONNRESET) {
+        std::cerr << "Error: la conexión fue restablecida por el cliente\n";
+    } else if (send_result < 0) {
+        std::cerr << "Error fatal al enviar la respuesta\n";
+        return;
+    }
+    if (request.server.options.verbose) {
+        std::cout << "Respuesta enviada con " << body.size() << " bytes\n";
+    }
+}
+
+// Contenido de un documento estático: en una de las cachés o en su propio mapeo
+struct static_content {
+    SafeMap mapping;                 // Vacío si el contenido está en una caché
+    std::string_view body;
+    std::string_view header = {};    // Cabecera precalculada en la caché compartida
+    std::optional<SharedCache::Reader> reader = {}; // Retiene la entrada compartida mientras se envía
+    std::shared_ptr<const void> lease = {};         // Retiene el hueco de --cache mientras se envía
+};
+
+/// @brief Comprueba con stat() si un documento cabe en la caché de contenidos (toca el disco)
+/// @param server
+/// @param path Ruta en disco
+/// @return Su stat si es un archivo regular pequeño y hay caché; si no, nada
+static std::optional<struct stat> cacheable_status(const server_context& server, const std::pmr::string& path) {
+    SharedCache* shared = server.shared_cache;
+    size_t max_file = shared != nullptr ? shared->max_file() : server.cache != nullptr ? server.cache->max_file() : 0;
+    struct stat status;
+    if (max_file != 0 && stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0 &&
+        static_cast<size_t>(status.st_size) <= max_file) {
+        return status;
+    }
+    return std::nullopt;
+}
+
+/// @brief Busca en la caché un documento ya comprobado con cacheable_status (sin tocar el disco)
+/// @param server
+/// @param path Ruta en disco
+/// @param status Su stat
+/// @return Contenido si está en la caché y sigue al día
+static std::optional<static_content> find_cached(const server_context& server, const std::pmr::string& path,
+                                                 const struct stat& status) {
+    if (SharedCache* shared = server.shared_cache; shared != nullptr) {
+        std::optional<SharedCache::Reader> reader{std::in_place, *shared};
+        if (auto cached = shared->find(*reader, path, status)) {
+            return static_content{SafeMap{}, cached->content, cached->header, std::move(reader)};
+        }
+    } else if (auto cached = server.cache->find(path, status)) {
+        return static_content{SafeMap{}, cached->content, {}, std::nullopt, std::move(cached->lease)};
+    }
+    return std::nullopt;
+}
+
+/// @brief Termina de cargar un documento recién leído: lo copia en la caché si cabe en ella
+/// @param server
+/// @param path Ruta en disco
+/// @param status Resultado de cacheable_status
+/// @param file Mapeo del documento
+/// @return Contenido (en la caché o en su mapeo)
+static static_content cache_static(const server_context& server, const std::pmr::string& path,
+                                   const std::optional<struct stat>& status, SafeMap file) {
+    if (status && server.shared_cache != nullptr) {
+        SharedCache& shared = *server.shared_cache;
+        std::optional<SharedCache::Reader> reader{std::in_place, shared};
+        char header[content_length_capacity];
+        std::string_view content = file.get();
+        if (auto cached = shared.insert(*reader, path, *status, format_content_length(header, content.size()), content)) {
+            return static_content{SafeMap{}, cached->content, cached->header, std::move(reader)};
+        }
+    } else if (status) {
+        if (auto cached = server.cache->insert(path, *status, file.get())) {
+            return static_content{SafeMap{}, cached->content, {}, std::nullopt, std::move(cached->lease)};
+        }
+    }
+    std::string_view body = file.get();
+    return static_content{std::move(file), body};
+}
+
+/// @brief Obtiene el contenido de un documento estático
+/// @param server
+/// @param path Ruta en disco
+/// @return Contenido o errno de read_all
+static std::expected<static_content, int> load_static(const server_context& server, const std::pmr::string& path) {
+    // Caché de contenidos: los documentos pequeños se sirven desde la región de páginas enormes
+    // (la de este proceso o la compartida por todos). Lo que no sea un archivo regular pequeño y
+    // legible sigue el camino normal (y sus errores)
+    auto status = cacheable_status(server, path);
+    if (status) {
+        if (auto cached = find_cached(server, path, *status)) {
+            return std::move(*cached);
+        }
+    }
+    auto file = [&] {
+        TraceSpan span{"read_all"};
+        return read_all(path.c_str());
+    }();
+    if (!file) {
+        return std::unexpected(file.error());
+    }
+    return cache_static(server, path, status, std::move(file.value()));
+}
+
+/// @brief Apunta un documento servido en el conjunto caliente (--hot-set)
+/// @param server
+/// @param path Ruta en disco
+/// @param bytes Tamaño del documento
+static void record_hit(const server_context& server, std::string_view path, uint64_t bytes) {
+    if (server.hot_set != nullptr) {
+        server.hot_set->record(path, bytes);
+    }
+}
+
+/// @brief Índice de un directorio pedido en una ruta estática
+/// @param request
+/// @param path Ruta del directorio en disco
+/// @return Índice o errno (EACCES si no se usa --listings)
+static std::expected<std::shared_ptr<const ListingCache::listing>, int> find_listing(const request_context& request,
+                                                                                   const std::pmr::string& path) {
+    ListingCache* listings = request.server.listings;
+    if (listings == nullptr) {
+        return std::unexpected(EACCES);
+    }
+    TraceSpan span{"list_directory"};
+    return listings->find(path);
+}
+
+/// @brief Responde a la petición de un directorio con su índice (o 403 sin --listings)
+/// @param request
+/// @param path Ruta del directorio en disco
+static void serve_listing(const request_context& request, const std::pmr::string& path) {
+    auto found = find_listing(request, path);
+    if (!found) {
+        send_error(request.client, request.outcome, found.error() == ENOENT ? 404 : 403);
+        return;
+    }
+    auto sent = [&] {
+        TraceSpan span{"send_listing"};
+        return send_listing(request.client, *found.value());
+    }();
+    request.outcome.status = 200;
+    request.outcome.bytes = sent ? found.value()->header.size() + sent.value() + 1 : 0;
+    if (request.deadline.expired()) {
+        std::cerr << "Error: tiempo de espera agotado al enviar la respuesta\n";
+    } else if (!sent) {
+        std::cerr << "Error al enviar la respuesta\n";
+    } else if (request.server.options.verbose) {
+        std::cout << "Índice enviado con " << found.value()->entries << " entradas\n";
+    }
+}
+
+/// @brief Sirve un documento de una ruta estática (o del archivo empaquetado con --archive)
+/// @param request
+static void serve_static(const request_context& request) {
+    const SafeFD& client = request.client;
+    // Modo archivo: un sondeo del índice y sendfile() desde el archivo ya abierto, sin
+    // llamadas al sistema de archivos por petición
+    if (const ContentArchive* archive = request.server.archive; archive != nullptr) {
+        const archive_entry* entry = archive->find(request.file_path);
+        if (entry == nullptr) {
+            send_error(client, request.outcome, 404);
+            return;
+        }
+        auto sent = [&] {
+            TraceSpan span{"send_archive_entry"};
+            return send_archive_entry(client, *archive, *entry);
+        }();
+        request.outcome.status = 200;
+        request.outcome.bytes = sent ? archive->header(*entry).size() + sent.value() + 1 : 0;
+        if (request.deadline.expired()) {
+            std::cerr << "Error: tiempo de espera agotado al enviar la respuesta\n";
+        } else if (!sent) {
+            std::cerr << "Error al enviar la respuesta\n";
+        } else if (request.server.options.verbose) {
+            std::cout << "Respuesta enviada con " << sent.value() << " bytes desde el archivo\n";
+        }
+        return;
+    }
+
+    std::pmr::string complete_path = target_path(request);
+    if (request.server.options.verbose) {
+        std::cout << "Solicitud de archivo: " << complete_path << '\n';
+    }
+    auto file = load_static(request.server, complete_path);
+    if (!file && file.error() == EISDIR) {
+        serve_listing(request, complete_path);
+        return;
+    }
+    if (!file) {
+        if (file.error() == ENOENT) {
+            send_error(client, request.outcome, 404);
+        } else if (file.error() == EACCES) {
+            send_error(client, request.outcome, 403);
+        } else {
+            std::cerr << "Error fatal al leer el archivo\n";
+        }
+        return;
+    }
+
+    // ------------------------------------------------------------------------------------------------------------------------------------------------------
+    // MODIFICACIÓN, cabe añadir que esto ya lo habia hecho para que saliese con la opción -v | --verbose, simplemente lo he adaptado para que
+    // salga por el socat (cliente) en lugar de la terminal donde se ejecuta (servidor).
+    // std::ostringstream response_stream;
+    // response_stream << "IP: " << inet_ntoa(client_addr.sin_addr) << "\nPUERTO " << ntohs(client_addr.sin_port) << "\n";
+    // std::string body_mod = response_stream.str();
+    // std::ostringstream header_stream;
+    // header_stream << "\n" << "Content-Length: " << body_mod.size() << "\n\n";
+    // std::string header_mod = header_stream.str();
+    // send_response(client, header_mod, body_mod);
+    // ------------------------------------------------------------------------------------------------------------------------------------------------------
+
+    // Responder con el contenido del archivo
+    record_hit(request.server, complete_path, file->body.size());
+    send_body(request, file->body, file->header);
+}
+
+// Documento de un lote: resuelto al leer la petición (--archive, error de ruta) o pendiente de
+// leer del disco
+struct bundle_document {
+    std::pmr::string path;           // Ruta pedida (base y nombre)
+    std::pmr::string disk_path;      // Vacío si ya está resuelto
+    std::optional<static_content> content = {};
+    int error = ENOENT;              // Si no hay contenido
+};
+
+// Respuesta a un lote ya montada: las partes apuntan a los contenidos de documents y a headers.
+// Cada documento es "Document: ruta\nContent-Length: N\n\n" seguido de su contenido y '\n', o
+// "Document: ruta\nError: código\n\n" si no se pudo leer; todo ello es el cuerpo de la respuesta
+struct bundle_response {
+    explicit bundle_response(std::pmr::memory_resource* arena) : documents{arena}, headers{arena}, parts{arena} {}
+
+    std::pmr::vector<bundle_document> documents;
+    std::pmr::string headers;
+    std::pmr::vector<std::string_view> parts;
+    char length[content_length_capacity];
+    size_t loaded = 0;               // Documentos leídos
+    uint64_t body_size = 0;          // Bytes de contenido de los documentos leídos
+};
+
+/// @brief Resuelve las rutas de los documentos de un lote, sin leerlos del disco (los de
+/// --archive quedan ya resueltos)
+/// @param request
+/// @param response Respuesta a rellenar; los documentos con disk_path quedan por leer
+static void resolve_bundle(const request_context& request, bundle_response& response) {
+    std::string_view names[max_bundle];
+    size_t count = parse_bundle(request.raw_request, names).value_or(0); // Ya validado al admitir
+    std::string_view base = request.file_path;
+    response.documents.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        bundle_document& document = response.documents.emplace_back(
+            bundle_document{std::pmr::string{request.arena}, std::pmr::string{request.arena}});
+        std::string_view name = names[i];
+        name.remove_prefix(std::min(name.find_first_not_of('/'), name.size()));
+        document.path.assign(base);
+        if (!document.path.ends_with('/')) {
+            document.path.push_back('/');
+        }
+        document.path.append(name);
+        // Cada documento queda dentro de la ruta del lote, también con --archive
+        if (!stays_below(name)) {
+            document.error = EACCES;
+            continue;
+        }
+
+        if (const ContentArchive* archive = request.server.archive; archive != nullptr) {
+            if (const archive_entry* entry = archive->find(document.path); entry != nullptr) {
+                document.content.emplace(SafeMap{}, archive->body(*entry), archive->header(*entry));
+            }
+            continue;
+        }
+        auto match = request.server.router.find(document.path);
+        if (!match) {
+            continue;
+        }
+        if (match->matched->kind != route_kind::static_files) {
+            document.error = EPERM;
+            continue;
+        }
+        document.disk_path.append(match->matched->target).append(match->remainder);
+    }
+}
+
+/// @brief Monta la respuesta completa de un lote ya leído, sin copiar los documentos
+/// @param response Respuesta con todos sus documentos resueltos
+static void assemble_bundle(bundle_response& response) {
+    // Las cabeceras de todas las partes van seguidas en un único búfer, reservado de una vez
+    // para que las vistas sobre él no se invaliden
+    size_t headers_size = 0;
+    for (const bundle_document& document : response.documents) {
+        headers_size += document.path.size() + content_length_capacity + 16;
+    }
+    response.headers.reserve(headers_size);
+    response.parts.reserve(3 * response.documents.size() + 2);
+    response.parts.push_back({}); // Cabecera de la respuesta, cuando se sepa el total
+
+    for (const bundle_document& document : response.documents) {
+        size_t start = response.headers.size();
+        response.headers.append("Document: ").append(document.path).push_back('\n');
+        if (!document.content) {
+            int error = document.error;
+            response.headers.append(error == ENOENT ? "Error: 404\n\n" : error == EACCES || error == EPERM || error == EISDIR
+                                                                               ? "Error: 403\n\n"
+                                                                               : "Error: 500\n\n");
+            response.parts.push_back(std::string_view{response.headers}.substr(start));
+            continue;
+        }
+        std::string_view body = document.content->body;
+        char length[content_length_capacity];
+        response.headers.append(document.content->header.empty() ? format_content_length(length, body.size())
+                                                                  : document.content->header);
+        response.parts.push_back(std::string_view{response.headers}.substr(start));
+        response.parts.push_back(body);
+        response.parts.push_back("\n");
+        ++response.loaded;
+        response.body_size += body.size();
+    }
+    response.parts.push_back("\n");
+
+    uint64_t total = 0;
+    for (size_t i = 1; i + 1 < response.parts.size(); ++i) {
+        total += response.parts[i].size();
+    }
+    response.parts.front() = format_content_length(response.length, total);
+}
+
+/// @brief Responde a un lote con todos sus documentos en un solo cuerpo, enviado con sendmsg()
+/// directamente desde los mapeos
+/// @param request
+static void serve_bundle(const request_context& request) {
+    bundle_response response{request.arena};
+    {
+        TraceSpan span{"read_bundle"};
+        resolve_bundle(request, response);
+        for (bundle_document& document : response.documents) {
+            if (!document.disk_path.empty()) {
+                auto loaded = load_static(request.server, document.disk_path);
+                if (loaded) {
+                    record_hit(request.server, document.disk_path, loaded->body.size());
+                    document.content.emplace(std::move(loaded.value()));
+                } else {
+                    document.error = loaded.error();
+                }
+            }
+        }
+        assemble_bundle(response);
+    }
+    auto sent = [&] {
+        TraceSpan span{"send_response"};
+        return send_parts(request.client, response.parts);
+    }();
+    request.outcome.status = 200;
+    request.outcome.bytes = sent ? sent.value() : 0;
+    if (request.deadline.expired()) {
+        std::cerr << "Error: tiempo de espera agotado al enviar la respuesta\n";
+    } else if (!sent && sent.error() == ECONNRESET) {
+        std::cerr << "Error: la conexión fue restablecida por el cliente\n";
+    } else if (!sent) {
+        std::cerr << "Error fatal al enviar la respuesta\n";
+    } else if (request.server.options.verbose) {
+        std::cout << "Lote enviado con " << response.loaded << " documentos y " << response.body_size << " bytes\n";
+    }
+}
+
+// -------------------
+//       PUNTO 4
+// -------------------
+
+/// @brief Entorno de un programa CGI, en la arena de la petición
+/// @param request
+/// @param complete_path Ruta del programa
+/// @return exec_environment
+static exec_environment cgi_environment(const request_context& request, const std::pmr::string& complete_path) {
+    peer_text remote = describe_peer(request.client_addr);
+    exec_environment env{request.arena};
+    env.REQUEST_PATH = complete_path;
+    env.SERVER_BASEDIR = request.server.base_dir;
+    env.REMOTE_PORT = remote.port;
+    env.REMOTE_IP = remote.ip;
+    env.REQUEST_METHOD = request.method;
+    if (request.body.type == request_body::encoding::length) {
+        char length[24];
+        env.CONTENT_LENGTH.assign(length, std::to_chars(length, length + sizeof(length), request.body.length).ptr);
+    } else if (request.body.type == request_body::encoding::none && request.method != "GET") {
+        env.CONTENT_LENGTH = "0";
+    }
+    return env;
+}
+
+// Envía el cuerpo de la petición a la entrada del programa desde un hilo propio, mientras el
+// de la conexión (o su bucle) lee la salida: un programa que escribe antes de terminar de leer
+// no se queda así bloqueado con la tubería de salida llena
+class BodyFeeder
+{
+  public:
+    BodyFeeder(const request_context& request, SafeFD input)
+      : client_{request.client}, done_{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)},
+        thread_{[this, &request, input = std::move(input)]() mutable {
+            result_ = stream_request_body(client_, request.buffered_body, request.body,
+                                          uint64_t{request.server.options.max_body_kb} << 10, input);
+            input = SafeFD{}; // Final de la entrada para el programa
+            uint64_t one = 1;
+            [[maybe_unused]] ssize_t written = write(done_.get(), &one, sizeof(one));
+        }} {}
+    BodyFeeder(const BodyFeeder&) = delete;
+    BodyFeeder& operator=(const BodyFeeder&) = delete;
+    ~BodyFeeder()
+    {
+        if (thread_.joinable()) {
+            finish();
+        }
+    }
+
+    /// @brief eventfd que se vuelve legible cuando el hilo ha terminado
+    [[nodiscard]] int done_fd() const noexcept
+    {
+        return done_.get();
+    }
+
+    /// @brief Corta la lectura del cuerpo si sigue pendiente: el programa ya terminó y no lo leerá
+    void interrupt() const noexcept
+    {
+        shutdown(client_.get(), SHUT_RD);
+    }
+
+    /// @brief Interrumpe el hilo y lo espera
+    /// @return Bytes del cuerpo entregados o errno de stream_request_body
+    std::expected<uint64_t, int> finish()
+    {
+        interrupt();
+        thread_.join();
+        return result_;
+    }
+
+  private:
+    const SafeFD& client_;
+    SafeFD done_;
+    std::expected<uint64_t, int> result_{0};
+    std::thread thread_;
+};
+
+/// @brief Comprueba cómo llegó el cuerpo que se dio al programa
+/// @param fed Resultado de BodyFeeder::finish()
+/// @return 0, o 413/400 si hay que responder con error en lugar de con la salida del programa
+static uint16_t body_status(const std::expected<uint64_t, int>& fed) {
+    // Un programa que termina sin leer toda su entrada (EPIPE, o el corte de interrupt()) no es
+    // un error de la petición
+    if (fed || fed.error() == EPIPE || fed.error() == ECONNABORTED) {
+        return 0;
+    }
+    if (fed.error() == EFBIG) {
+        std::cerr << "Error: el cuerpo de la petición supera el máximo permitido\n";
+        return 413;
+    }
+    std::cerr << "Error al recibir el cuerpo de la petición: " << strerror(fed.error()) << '\n';
+    return 400;
+}
+
+/// @brief Ejecuta un programa de una ruta CGI y responde con su salida
+/// @param request
+static void serve_cgi(const request_context& request) {
+    const SafeFD& client = request.client;
+    const program_options& options = request.server.options;
+    std::pmr::string complete_path = target_path(request);
+    if (options.verbose) {
+        std::cout << "Solicitud de programa: " << complete_path << '\n';
+    }
+
+    // Ajustamos las variables de entorno 
+    exec_environment env = cgi_environment(request, complete_path);
+
+    // Ejecutar el programa. El plazo de CGI mata al hijo a través de un pidfd, que sigue
+    // refiriéndose al mismo proceso aunque su PID se reutilice tras esperarlo
+    // pidfd y plazo juntos: el callback solo captura una referencia y un entero, de modo que
+    // su std::function no reserva memoria
+    struct {
+        SafeFD pidfd;
+        Deadline deadline;
+    } child{SafeFD{}, Deadline{request.server.watchdog}};
+    Deadline& cgi_deadline = child.deadline;
+    request.deadline.cancel();
+    // El cuerpo, si lo hay, se envía al programa mientras aquí se lee su salida
+    std::optional<BodyFeeder> feeder;
+    std::function<void(SafeFD)> on_input;
+    if (request.body.type != request_body::encoding::none) {
+        on_input = [&feeder, &request](SafeFD input) { feeder.emplace(request, std::move(input)); };
+    }
+    auto result = [&] {
+        TraceSpan span{"execute_program"};
+        return execute_program(complete_path, env, [&child, timeout = options.cgi_timeout_ms](pid_t pid) {
+            child.pidfd = SafeFD{static_cast<int>(syscall(SYS_pidfd_open, pid, 0))};
+            if (child.pidfd.is_valid()) {
+                child.deadline.arm(timeout, [fd = child.pidfd.get(), pid] {
+                    // Si el hijo aún no se ha esperado su PID (y su grupo) no se han reutilizado
+                    if (syscall(SYS_pidfd_send_signal, fd, SIGKILL, nullptr, 0) == 0) {
+                        kill(-pid, SIGKILL);
+                    }
+                });
+            }
+        }, on_input);
+    }();
+    cgi_deadline.cancel();
+    uint16_t body_error = 0;
+    if (feeder) {
+        auto fed = feeder->finish();
+        request.outcome.unread_body = !fed;
+        body_error = body_status(fed);
+    }
+    request.deadline.arm(options.send_timeout_ms, request.abort_io);
+    // Comprobación de errores
+    if (body_error != 0) {
+        send_error(client, request.outcome, body_error);
+        return;
+    }
+    if (!result) { 
+        const auto& error = result.error();
+        if (cgi_deadline.expired()) {
+            std::cerr << "Error: el programa superó el tiempo máximo de ejecución\n";
+            send_error(client, request.outcome, 504);
+        } else if (error.error_code == ENOENT) {
+            std::cerr << "Error: el programa no existe (ENOENT)\n";
+            send_error(client, request.outcome, 404);
+        } else if (error.error_code == EACCES) {
+            std::cerr << "Error: no se tienen permisos para ejecutar el programa (EACCES)\n";
+            send_error(client, request.outcome, 403);
+        } else {
+            std::cerr << "El programa terminó con un código de error: " << error.exit_code << "\n";
+            send_error(client, request.outcome, 500);
+        }
+        return;
+    }
+    // Responder con la salida del programa
+    send_body(request, result.value());
+}
+
+/// @brief Llama a la función de un plugin
+/// @param request
+/// @param body Respuesta que genera el plugin
+/// @return 0 o el errno que devuelve el plugin
+static int run_plugin(const request_context& request, std::pmr::string& body) {
+    std::pmr::string path{request.file_path, request.arena};
+    std::pmr::string remainder{request.remainder, request.arena};
+    auto append = [](void* context, const char* data, size_t size) {
+        static_cast<std::pmr::string*>(context)->append(data, size);
+    };
+    return request.matched.plugin(path.c_str(), remainder.c_str(), append, &body);
+}
+
+/// @brief Responde con lo que genere la función de un plugin
+/// @param request
+static void serve_plugin(const request_context& request) {
+    std::pmr::string body{request.arena};
+    int error = run_plugin(request, body);
+    if (error == ENOENT) {
+        send_error(request.client, request.outcome, 404);
+    } else if (error == EACCES) {
+        send_error(request.client, request.outcome, 403);
+    } else if (error != 0) {
+        std::cerr << "Error: el plugin de " << request.matched.prefix << " falló: " << strerror(error) << '\n';
+        send_error(request.client, request.outcome, 500);
+    } else {
+        send_body(request, body);
+    }
+}
+
+/// @brief Información del propio servidor (status: ocupación; routes: tabla de rutas)
+/// @param server
+/// @param matched Ruta interna
+/// @return std::string
+static std::string internal_body(const server_context& server, const route& matched) {
+    std::ostringstream oss;
+    if (matched.target == "status") {
+        auto lane = [&oss](std::string_view name, const AdmissionLimiter& limiter) {
+            oss << name << ": " << limiter.active() << '/' << limiter.limit() << " activas, "
+                << limiter.rejected() << " rechazadas\n";
+        };
+        lane("conexiones", server.admission.connections);
+        lane("cgi", server.admission.cgi);
+        lane("estáticas", server.admission.statics);
+        if (server.archive != nullptr) {
+            oss << "archivo: " << server.archive->size() << " documentos\n";
+        }
+        if (server.cache != nullptr) {
+            oss << "caché: " << server.cache->entries() << " documentos, " << (server.cache->used() >> 20)
+                << " MiB en bloques\n";
+        }
+        if (server.rate_limiter != nullptr) {
+            oss << "límite por cliente: " << server.rate_limiter->clients() << " clientes, "
+                << server.rate_limiter->rejected() << " rechazadas, " << server.rate_limiter->overflowed()
+                << " sin hueco en la tabla\n";
+        }
+        if (server.listings != nullptr) {
+            oss << "índices: " << server.listings->entries() << " de " << server.listings->capacity() << " directorios, "
+                << server.listings->invalidations() << " descartados por cambios\n";
+        }
+        if (server.hot_set != nullptr) {
+            oss << "conjunto caliente: " << server.hot_set->size() << " rutas contadas\n";
+        }
+        if (server.work_pool != nullptr) {
+            auto files = server.work_pool->stats(WorkPool::work_class::file);
+            auto processes = server.work_pool->stats(WorkPool::work_class::process);
+            oss << "hilos de trabajo: archivos " << files.threads << " (" << files.completed << " tareas, "
+                << files.stolen << " robadas), procesos " << processes.threads << " (" << processes.completed
+                << " tareas, " << processes.stolen << " robadas)\n";
+        }
+        if (server.shared_cache != nullptr) {
+            oss << "caché compartida: " << server.shared_cache->entries() << " documentos, "
+                << (server.shared_cache->used() >> 20) << " MiB en bloques, " << server.shared_cache->pending()
+                << " bloques retirados pendientes en este proceso\n";
+        }
+    } else {
+        static constexpr std::string_view kinds[] = {"static", "cgi", "plugin", "internal"};
+        for (const route& entry : server.router.routes()) {
+            oss << kinds[static_cast<size_t>(entry.kind)] << ' ' << entry.prefix << ' ' << entry.target << '\n';
+        }
+    }
+    return oss.str();
+}
+
+/// @brief Responde con información del propio servidor
+/// @param request
+static void serve_internal(const request_context& request) {
+    send_body(request, internal_body(request.server, request.matched));
+}
+
+// Petición enrutada y con plaza en su carril, lista para su manejador
+struct routed_request {
+    std::string_view file_path;
+    route_match match;
+    AdmissionTicket lane_ticket;
+    std::string_view method;
+    request_body body;
+};
+
+/// @brief Valida y enruta una petición ya recibida y le reserva plaza en su carril
+/// @param client Socket del cliente
+/// @param server Estado compartido del servidor
+/// @param deadline Plazo de la conexión
+/// @param abort_io Acción del plazo de la conexión
+/// @param raw_request Petición tal y como se recibió
+/// @param outcome Respuesta dada, para la captura
+/// @return Petición lista o nada si ya se respondió con un error
+static std::optional<routed_request> admit_request(const SafeFD& client, const sockaddr_storage& client_addr,
+                                                   server_context& server, Deadline& deadline,
+                                                   const std::function<void()>& abort_io, std::string_view raw_request,
+                                                   request_outcome& outcome) {
+    const program_options& options = server.options;
+    admission_control& admission = server.admission;
+
+    // Procesar la solicitud para extraer la ruta del archivo
+    auto [method, file_path] = parse_request(raw_request);
+
+    // Comprobar que la solicitud es válida
+    bool has_body = method == "POST" || method == "PUT";
+    bool is_bundle = method == "BUNDLE";
+    if ((method != "GET" && !has_body && !is_bundle) || file_path.empty() || file_path[0] != '/') {
+        send_error(client, outcome, 400);
+        return std::nullopt;
+    }
+    // Un lote cuenta como tantas peticiones como documentos pide
+    size_t cost = 1;
+    if (is_bundle) {
+        std::string_view documents[max_bundle];
+        auto count = parse_bundle(raw_request, documents);
+        if (!count) {
+            send_error(client, outcome, count.error() == E2BIG ? 413 : 400);
+            return std::nullopt;
+        }
+        cost = count.value();
+    }
+
+    // Elegir el manejador: la ruta de prefijo más largo de la tabla
+    auto match = [&] {
+        TraceSpan span{"route"};
+        return server.router.find(file_path);
+    }();
+    if (!match) {
+        send_error(client, outcome, 404);
+        return std::nullopt;
+    }
+
+    bool is_cgi = match->matched->kind == route_kind::cgi;
+    // Límite por cliente: quien ha agotado sus fichas recibe el 429 precalculado, sin tocar el
+    // disco ni lanzar nada. Por un socket Unix no hay IP de cliente (todo llega del proxy local,
+    // que es quien debe limitar): no se aplica
+    auto within_rate = [&] {
+        RateLimiter* limiter = client_addr.ss_family == AF_INET ? server.rate_limiter : nullptr;
+        in_addr_t address = reinterpret_cast<const sockaddr_in&>(client_addr).sin_addr.s_addr;
+        RateLimiter::lane lane = is_cgi ? RateLimiter::lane::cgi : RateLimiter::lane::statics;
+        return limiter == nullptr || limiter->try_take(address, lane, cost);
+    };
+    if (!within_rate()) {
+        if (options.verbose) {
+            std::cout << "Cliente " << describe_peer(client_addr).ip << " por encima de su límite, respondiendo 429\n";
+        }
+        ssize_t sent = reject_connection(client, admission.rate_limited_response);
+        outcome.status = 429;
+        outcome.bytes = sent > 0 ? static_cast<uint64_t>(sent) : 0;
+        return std::nullopt;
+    }
+
+    // Los lotes son de documentos estáticos; solo los programas reciben un cuerpo. Si el cliente
+    // cerró antes de la línea vacía, la petición no trae cabeceras ni cuerpo
+    if (is_bundle && match->matched->kind != route_kind::static_files) {
+        send_error(client, outcome, 405);
+        return std::nullopt;
+    }
+    request_body body;
+    if (has_body) {
+        outcome.unread_body = true;
+        if (!is_cgi) {
+            send_error(client, outcome, 405);
+            return std::nullopt;
+        }
+        auto parsed = parse_request_body(raw_request);
+        if (!parsed && (parsed.error() != EAGAIN || raw_request.size() >= max_request_head)) {
+            send_error(client, outcome, 400);
+            return std::nullopt;
+        }
+        body = parsed.value_or(request_body{request_body::encoding::none, 0, raw_request.size()});
+        outcome.streamed_body = body.type == request_body::encoding::chunked ||
+                                (body.type == request_body::encoding::length && raw_request.size() - body.offset < body.length);
+        outcome.unread_body = outcome.streamed_body;
+        if (body.type == request_body::encoding::length && body.length > uint64_t{options.max_body_kb} << 10) {
+            send_error(client, outcome, 413);
+            return std::nullopt;
+        }
+    }
+
+    // A partir de aquí el plazo que cuenta es el de envío (el CGI tiene el suyo propio)
+    deadline.arm(options.send_timeout_ms, abort_io);
+    // Cada tipo de petición tiene su propio carril: los CGI lentos no bloquean los estáticos
+    AdmissionTicket lane_ticket{is_cgi ? admission.cgi : admission.statics};
+    if (!lane_ticket.is_valid()) {
+        if (options.verbose) {
+            std::cout << "Carril " << (is_cgi ? "CGI" : "estático") << " lleno, respondiendo 503\n";
+        }
+        ssize_t sent = reject_connection(client, admission.overload_response);
+        outcome.status = 503;
+        outcome.bytes = sent > 0 ? static_cast<uint64_t>(sent) : 0;
+        return std::nullopt;
+    }
+    return routed_request{file_path, match.value(), std::move(lane_ticket), method, body};
+}
+
+/// @brief Enruta una petición ya recibida y la atiende con el manejador de su ruta
+/// @param client Socket del cliente
+/// @param client_addr Dirección del cliente
+/// @param server Estado compartido del servidor
+/// @param deadline Plazo de la conexión
+/// @param abort_io Acción del plazo de la conexión
+/// @param raw_request Petición tal y como se recibió
+/// @param arena Memoria de la petición
+/// @param outcome Respuesta dada, para la captura
+static void route_request(const SafeFD& client, const sockaddr_storage& client_addr, server_context& server,
+                          Deadline& deadline, const std::function<void()>& abort_io, std::string_view raw_request,
+                          std::pmr::memory_resource* arena, request_outcome& outcome) {
+    auto routed = admit_request(client, client_addr, server, deadline, abort_io, raw_request, outcome);
+    if (!routed) {
+        return;
+    }
+    const route& matched = *routed->match.matched;
+    request_context context{client, client_addr, server, deadline, abort_io, routed->file_path, matched,
+                            routed->match.remainder, arena, outcome, routed->method, routed->body,
+                            raw_request.substr(routed->body.offset), raw_request};
+    ResponseCork cork{client, server.options.sockets, client_addr.ss_family};
+    if (routed->method == "BUNDLE") {
+        serve_bundle(context);
+        return;
+    }
+    switch (matched.kind) {
+        case route_kind::static_files:
+            serve_static(context);
+            break;
+        case route_kind::cgi:
+            serve_cgi(context);
+            break;
+        case route_kind::plugin:
+            serve_plugin(context);
+            break;
+        case route_kind::internal:
+            serve_internal(context);
+            break;
+    }
+}
+
+// Cuerpo sin leer que se descarta antes de cerrar: cuánto como mucho y durante cuánto tiempo
+constexpr size_t drain_limit = size_t{256} << 10;
+constexpr int drain_timeout_ms = 1000;
+
+/// @brief Comprueba si ya llegó el FIN del cliente (o la conexión se cortó)
+/// @param client Socket TCP del cliente, ya cerrado en escritura
+static bool peer_finished(const SafeFD& client) {
+    tcp_info info{};
+    socklen_t size = sizeof(info);
+    if (getsockopt(client.get(), IPPROTO_TCP, TCP_INFO, &info, &size) < 0) {
+        return true;
+    }
+    return info.tcpi_state != TCP_ESTABLISHED && info.tcpi_state != TCP_FIN_WAIT1 && info.tcpi_state != TCP_FIN_WAIT2;
+}
+
+/// @brief Cierre ordenado de una conexión a la que puede quedarle cuerpo sin leer. Cerrar un
+/// socket TCP con datos recibidos sin leer envía un RST, y el cliente puede perder la respuesta
+/// que aún no había leído. Se envía el FIN y se descarta lo que llegue hasta el FIN del cliente,
+/// con un límite de bytes y de tiempo para que un cliente que no para no retenga la conexión.
+/// @param client Socket del cliente (bloqueante o no)
+/// @param family Familia de la dirección del cliente (un socket Unix no responde con RST)
+static void drain_unread_body(const SafeFD& client, sa_family_t family) {
+    if (family == AF_UNIX) {
+        return;
+    }
+    shutdown(client.get(), SHUT_WR);
+    auto give_up = std::chrono::steady_clock::now() + std::chrono::milliseconds(drain_timeout_ms);
+    size_t drained = 0;
+    char buffer[4096];
+    while (drained < drain_limit) {
+        ssize_t received = recv(client.get(), buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (received > 0) {
+            drained += static_cast<size_t>(received);
+            continue;
+        }
+        if (received < 0 && errno != EAGAIN && errno != EINTR) {
+            return;
+        }
+        // Tras shutdown(SHUT_RD) (BodyFeeder::interrupt) recv() devuelve 0 y poll() da el socket
+        // por legible aunque el cliente siga enviando: el final de verdad es su FIN
+        if (peer_finished(client)) {
+            return;
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(give_up - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            return;
+        }
+        pollfd ready{client.get(), POLLIN, 0};
+        poll(received == 0 ? nullptr : &ready, received == 0 ? 0 : 1, received == 0 ? std::min<int>(remaining, 10) : static_cast<int>(remaining));
+    }
+}
+
+/// @brief Atiende una conexión ya aceptada (se ejecuta en su propio hilo)
+/// @param client Socket del cliente
+/// @param client_addr Dirección del cliente
+/// @param server Estado compartido del servidor
+/// @param connection_ticket Plaza reservada para esta conexión
+static void handle_connection(SafeFD client, sockaddr_storage client_addr, server_context& server,
+                              [[maybe_unused]] AdmissionTicket connection_ticket) {
+    const program_options& options = server.options;
+    uint64_t arrival = trace_now();
+
+    // Toda la memoria de la petición sale de esta arena, en la pila del hilo: en el caso
+    // normal no se llama a malloc entre accept() y el cierre
+    RequestArena<16384> arena;
+
+    // Al vencer un plazo de red se cierra el socket en ambos sentidos: el recv()/send()
+    // bloqueado en este hilo vuelve inmediatamente
+    Deadline deadline{server.watchdog};
+    std::function<void()> abort_io = [fd = client.get()] { shutdown(fd, SHUT_RDWR); };
+    deadline.arm(options.read_timeout_ms, abort_io);
+
+    TraceSpan request_span{"request"};
+
+    // Leer la solicitud del cliente
+    auto request = [&] {
+        TraceSpan span{"receive_request"};
+        return receive_request(client, max_request_head, arena.resource());
+    }();
+    if (deadline.expired()) {
+        std::cerr << "Error: tiempo de espera agotado al leer la solicitud\n";
+        return;
+    }
+    if (!request) {
+        if (request.error() == ECONNRESET) {
+            std::cerr << "Error: la conexión fue restablecida por el cliente\n";
+        } else {
+            std::cerr << "Error fatal al leer la solicitud\n";
+        }
+        return;
+    }
+
+    // Las peticiones con cabeceras (con cuerpo o lotes) pueden llegar en varios fragmentos
+    if (has_headers(parse_request(request.value()).method)) {
+        if (int error = receive_headers(client, request.value(), max_request_head); error != 0 || deadline.expired()) {
+            std::cerr << "Error al leer las cabeceras de la solicitud\n";
+            return;
+        }
+    }
+
+    request_outcome outcome;
+    route_request(client, client_addr, server, deadline, abort_io, request.value(), arena.resource(), outcome);
+
+    // Captura: la petición tal y como llegó junto con la respuesta que obtuvo
+    if (server.capture != nullptr) {
+        server.capture->record(arrival, request.value(), outcome.streamed_body, client_addr, outcome.status, outcome.bytes);
+    }
+    if (outcome.unread_body) {
+        drain_unread_body(client, client_addr.ss_family);
+    }
+    // La conexión con el cliente se cierra al destruirse el SafeFD
+    if (options.verbose) {
+        std::cout << "Conexión cerrada\n";
+    }
+}
+
+// -------------------
+//   MODO ASÍNCRONO
+// -------------------
+// Con --async cada hilo de aceptación es un bucle de eventos: cada conexión es una corrutina
+// con los mismos pasos que handle_connection, pero las esperas de red, de la tubería del CGI
+// y del final del hijo suspenden la corrutina en lugar del hilo. Lo que puede bloquear sin
+// ser una espera de red (stat() y lectura de documentos, índices de directorio, fork() del
+// CGI, el plugin, traer a memoria un documento de --archive que no está en la caché de páginas)
+// se pasa al WorkPool y la corrutina espera su resultado igual que espera un descriptor: el
+// bucle no se detiene nunca en el disco. Solo las respuestas de error, de pocos bytes, se
+// envían sin esperar: caben siempre en el búfer del socket.
+
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22 // Linux 5.14
+#endif
+
+/// @brief Trae a memoria todas las páginas de un mapeo, para que enviarlo desde el bucle (con
+/// send() o con sendfile() del mismo archivo) no espere al disco
+/// @param content Parte de un mapeo de read_all o del archivo de --archive
+static void prefault(std::string_view content) {
+    uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t first = reinterpret_cast<uintptr_t>(content.data()) & ~(page - 1);
+    void* start = reinterpret_cast<void*>(first);
+    size_t length = reinterpret_cast<uintptr_t>(content.data()) + content.size() - first;
+    if (madvise(start, length, MADV_POPULATE_READ) != 0) {
+        // Núcleos anteriores: al menos que empiece la lectura anticipada
+        madvise(start, length, MADV_WILLNEED);
+    }
+}
+
+/// @brief Comprueba con mincore() si todas las páginas de una parte de un mapeo están ya en la
+/// caché de páginas (no espera al disco: solo consulta las tablas del núcleo)
+/// @param content Parte de un mapeo
+/// @return false si falta alguna o no se pudo saber
+static bool is_resident(std::string_view content) {
+    uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t next = reinterpret_cast<uintptr_t>(content.data()) & ~(page - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(content.data()) + content.size();
+    unsigned char pages[256];
+    while (next < end) {
+        size_t count = std::min<size_t>(sizeof(pages), (end - next + page - 1) / page);
+        if (mincore(reinterpret_cast<void*>(next), count * page, pages) != 0) {
+            return false;
+        }
+        if (std::any_of(pages, pages + count, [](unsigned char state) { return (state & 1) == 0; })) {
+            return false;
+        }
+        next += count * page;
+    }
+    return true;
+}
+
+/// @brief Versión asíncrona de load_static: stat() y la lectura se hacen en los hilos de
+/// archivos del WorkPool; el bucle solo consulta y rellena las cachés, que están en memoria (y
+/// el Reader de la caché compartida tiene que crearse y destruirse en el mismo hilo)
+/// @param loop
+/// @param server
+/// @param path Ruta en disco
+/// @return Contenido o errno de read_all
+static Task<std::expected<static_content, int>> async_load_static(EventLoop& loop, const server_context& server,
+                                                                   const std::pmr::string& path) {
+    WorkPool& pool = *server.work_pool;
+    std::optional<struct stat> status;
+    if (server.cache != nullptr || server.shared_cache != nullptr) {
+        status = co_await loop.offload(pool, WorkPool::work_class::file, [&server, &path] {
+            return cacheable_status(server, path);
+        });
+        if (status) {
+            if (auto cached = find_cached(server, path, *status)) {
+                co_return std::move(*cached);
+            }
+        }
+    }
+    auto file = co_await loop.offload(pool, WorkPool::work_class::file, [&path] {
+        TraceSpan span{"read_all"};
+        auto mapped = read_all(path.c_str());
+        if (mapped) {
+            prefault(mapped->get());
+        }
+        return mapped;
+    });
+    if (!file) {
+        co_return std::unexpected(file.error());
+    }
+    co_return cache_static(server, path, status, std::move(file.value()));
+}
+
+/// @brief Envía una respuesta completa sin bloquear y la apunta en el resultado
+/// @param loop
+/// @param request
+/// @param status Código que se apunta en la captura
+/// @param header
+/// @param body
+static Task<> async_send_response(EventLoop& loop, const request_context& request, uint16_t status,
+                                  std::string_view header, std::string_view body) {
+    std::string_view parts[] = {header, body, "\n"};
+    auto sent = co_await async_send(loop, request.client, parts);
+    request.outcome.status = status;
+    request.outcome.bytes = sent ? sent.value() : 0;
+    if (request.deadline.expired()) {
+        std::cerr << "Error: tiempo de espera agotado al enviar la respuesta\n";
+    } else if (!sent && sent.error() == ECONNRESET) {
+        std::cerr << "Error: la conexión fue restablecida por el cliente\n";
+    } else if (!sent) {
+        std::cerr << "Error fatal al enviar la respuesta\n";
+    } else if (request.server.options.verbose) {
+        std::cout << "Respuesta enviada con " << body.size() << " bytes\n";
+    }
+}
+
+/// @brief Envía una respuesta completa con su Content-Length (ya calculado o no)
+static Task<> async_send_body(EventLoop& loop, const request_context& request, std::string_view body,
+                              std::string_view header = {}) {
+    char length[content_length_capacity];
+    if (header.empty()) {
+        header = format_content_length(length, body.size());
+    }
+    co_await async_send_response(loop, request, 200, header, body);
+}
+
+/// @brief Envía una respuesta de error
+static Task<> async_send_error(EventLoop& loop, const request_context& request, uint16_t status) {
+    char length[content_length_capacity];
+    auto [header, body] = error_response(status, length);
+    co_await async_send_response(loop, request, status, header, body);
+}
+
+/// @brief Versión asíncrona de serve_listing
+static Task<> async_serve_listing(EventLoop& loop, const request_context& request, const std::pmr::string& path) {
+    auto found = co_await loop.offload(*request.server.work_pool, WorkPool::work_class::file,
+                                       [&request, &path] { return find_listing(request, path); });
+    if (!found) {
+        co_await async_send_error(loop, request, found.error() == ENOENT ? 404 : 403);
+        co_return;
+    }
+    const ListingCache::listing& listing = *found.value();
+    std::string_view header[] = {listing.header};
+    auto sent = co_await async_send(loop, request.client, header);
+    if (sent) {
+        auto body = co_await async_sendfile(loop, request.client, listing.content, 0, listing.size + 1);
+        sent = body ? std::expected<uint64_t, int>{sent.value() + body.value()} : body;
+    }
+    request.outcome.status = 200;
+    request.outcome.bytes = sent ? sent.value() : 0;
+    if (request.deadline.expired()) {
+        std::cerr << "Error: tiempo de espera agotado al enviar la respuesta\n";
+    } else if (!sent) {
+        std::cerr << "Error al enviar la respuesta\n";
+    } else if (request.server.options.verbose) {
+        std::cout << "Índice enviado con " << listing.entries << " entradas\n";
+    }
+}
+
+/// @brief Versión asíncrona de serve_static
+static Task<> async_serve_static(EventLoop& loop, const request_context& request) {
+    if (const ContentArchive* archive = request.server.archive; archive != nullptr) {
+        const archive_entry* entry = archive->find(request.file_path);
+        if (entry == nullptr) {
+            co_await async_send_error(loop, request, 404);
+            co_return;
+        }
+        // sendfile() desde el archivo esperaría al disco si el documento no está en la caché de
+        // páginas: en ese caso se trae antes a memoria en los hilos de archivos
+        std::string_view body_range{archive->body(*entry).data(), entry->body_size + 1};
+        if (!is_resident(body_range)) {
+            co_await loop.offload(*request.server.work_pool, WorkPool::work_class::file, [body_range] {
+                TraceSpan span{"prefault"};
+                prefault(body_range);
+                return 0;
+            });
+        }
+        std::string_view header[] = {archive->header(*entry)};
+        auto sent = co_await async_send(loop, request.client, header);
+        if (sent) {
+            // Contenido y '\n' final, que el archivo guarda justo detrás de cada documento
+            auto body = co_await async_sendfile(loop, request.client, archive->descriptor(),
+                                                static_cast<off_t>(entry->body_offset), entry->body_size + 1);
+            sent = body ? std::expected<uint64_t, int>{sent.value() + body.value()} : body;
+        }
+        request.outcome.status = 200;
+        request.outcome.bytes = sent ? sent.value() : 0;
+        if (request.deadline.expired()) {
+            std::cerr << "Error: tiempo de espera agotado al enviar la respuesta\n";
+        } else if (!sent) {
+            std::cerr << "Error al enviar la respuesta\n";
+        } else if (request.server.options.verbose) {
+            std::cout << "Respuesta enviada con " << entry->body_size << " bytes desde el archivo\n";
+        }
+        co_return;
+    }
+
+    std::pmr::string complete_path = target_path(request);
+    if (request.server.options.verbose) {
+        std::cout << "Solicitud de archivo: " << complete_path << '\n';
+    }
+    auto file = co_await async_load_static(loop, request.server, complete_path);
+    if (!file && file.error() == EISDIR) {
+        co_await async_serve_listing(loop, request, complete_path);
+        co_return;
+    }
+    if (!file) {
+        if (file.error() == ENOENT) {
+            co_await async_send_error(loop, request, 404);
+        } else if (file.error() == EACCES) {
+            co_await async_send_error(loop, request, 403);
+        } else {
+            std::cerr << "Error fatal al leer el archivo\n";
+        }
+        co_return;
+    }
+    record_hit(request.server, complete_path, file->body.size());
+    co_await async_send_body(loop, request, file->body, file->header);
+}
+
+/// @brief Versión asíncrona de serve_bundle
+static Task<> async_serve_bundle(EventLoop& loop, const request_context& request) {
+    bundle_response response{request.arena};
+    resolve_bundle(request, response);
+    for (bundle_document& document : response.documents) {
+        if (!document.disk_path.empty()) {
+            auto loaded = co_await async_load_static(loop, request.server, document.disk_path);
+            if (loaded) {
+                record_hit(request.server, document.disk_path, loaded->body.size());
+                document.content.emplace(std::move(loaded.value()));
+            } else {
+                document.error = loaded.error();
+            }
+        }
+    }
+    assemble_bundle(response);
+    auto sent = co_await async_send(loop, request.client, response.parts);
+    request.outcome.status = 200;
+    request.outcome.bytes = sent ? sent.value() : 0;
+    if (request.deadline.expired()) {
+        std::cerr << "Error: tiempo de espera agotado al enviar la respuesta\n";
+    } else if (!sent && sent.error() == ECONNRESET) {
+        std::cerr << "Error: la conexión fue restablecida por el cliente\n";
+    } else if (!sent) {
+        std::cerr << "Error fatal al enviar la respuesta\n";
+    } else if (request.server.options.verbose) {
+        std::cout << "Lote enviado con " << response.loaded << " documentos y " << response.body_size << " bytes\n";
+    }
+}
+
+/// @brief Versión asíncrona de serve_cgi: la salida del programa y su final se esperan sin
+/// bloquear el hilo
+static Task<> async_serve_cgi(EventLoop& loop, const request_context& request) {
+    const program_options& options = request.server.options;
+    std::pmr::string complete_path = target_path(request);
+    if (options.verbose) {
+        std::cout << "Solicitud de programa: " << complete_path << '\n';
+    }
+    exec_environment env = cgi_environment(request, complete_path);
+
+    request.deadline.cancel();
+    bool has_body = request.body.type != request_body::encoding::none;
+    // fork() copia las tablas de páginas del servidor: en un proceso grande no es instantáneo
+    auto child = co_await loop.offload(*request.server.work_pool, WorkPool::work_class::process,
+                                       [&complete_path, &env, has_body] { return spawn_program(complete_path, env, has_body); });
+    if (!child) {
+        if (child.error() == ENOENT) {
+            std::cerr << "Error: el programa no existe (ENOENT)\n";
+            co_await async_send_error(loop, request, 404);
+        } else if (child.error() == EACCES) {
+            std::cerr << "Error: no se tienen permisos para ejecutar el programa (EACCES)\n";
+            co_await async_send_error(loop, request, 403);
+        } else {
+            std::cerr << "Error al lanzar el programa: " << strerror(child.error()) << '\n';
+            co_await async_send_error(loop, request, 500);
+        }
+        co_return;
+    }
+    Deadline cgi_deadline{request.server.watchdog};
+    cgi_deadline.arm(options.cgi_timeout_ms, [fd = child->pidfd.get(), pid = child->pid] {
+        if (syscall(SYS_pidfd_send_signal, fd, SIGKILL, nullptr, 0) == 0) {
+            kill(-pid, SIGKILL);
+        }
+    });
+
+    // El hilo del cuerpo usa el socket en modo bloqueante: el bucle no lo toca hasta responder
+    std::optional<BodyFeeder> feeder;
+    int client_flags = fcntl(request.client.get(), F_GETFL);
+    if (has_body) {
+        fcntl(request.client.get(), F_SETFL, client_flags & ~O_NONBLOCK);
+        feeder.emplace(request, std::move(child->input));
+    }
+
+    // La tubería llega al final cuando el programa (y lo que haya lanzado) la cierra
+    std::pmr::string output{request.arena};
+    char buffer[4096];
+    while (true) {
+        auto bytes_read = co_await async_read(loop, child->output, buffer, sizeof(buffer));
+        if (!bytes_read || bytes_read.value() == 0) {
+            break;
+        }
+        output.append(buffer, bytes_read.value());
+    }
+    auto status = co_await async_wait_child(loop, child.value());
+    cgi_deadline.cancel();
+    uint16_t body_error = 0;
+    if (feeder) {
+        feeder->interrupt();
+        co_await loop.wait(feeder->done_fd(), EPOLLIN);
+        auto fed = feeder->finish();
+        request.outcome.unread_body = !fed;
+        body_error = body_status(fed);
+        fcntl(request.client.get(), F_SETFL, client_flags);
+    }
+    request.deadline.arm(options.send_timeout_ms, request.abort_io);
+
+    if (body_error != 0) {
+        co_await async_send_error(loop, request, body_error);
+    } else if (cgi_deadline.expired()) {
+        std::cerr << "Error: el programa superó el tiempo máximo de ejecución\n";
+        co_await async_send_error(loop, request, 504);
+    } else if (!status || !WIFEXITED(status.value()) || WEXITSTATUS(status.value()) != 0) {
+        std::cerr << "El programa terminó con un código de error: "
+                  << (status && WIFEXITED(status.value()) ? WEXITSTATUS(status.value()) : -1) << "\n";
+        co_await async_send_error(loop, request, 500);
+    } else {
+        co_await async_send_body(loop, request, output);
+    }
+}
+
+/// @brief Versión asíncrona de serve_plugin (el plugin se ejecuta en un hilo de procesos del
+/// WorkPool: es código ajeno y puede bloquear)
+static Task<> async_serve_plugin(EventLoop& loop, const request_context& request) {
+    std::pmr::string body{request.arena};
+    int error = co_await loop.offload(*request.server.work_pool, WorkPool::work_class::process,
+                                      [&request, &body] { return run_plugin(request, body); });
+    if (error == ENOENT) {
+        co_await async_send_error(loop, request, 404);
+    } else if (error == EACCES) {
+        co_await async_send_error(loop, request, 403);
+    } else if (error != 0) {
+        std::cerr << "Error: el plugin de " << request.matched.prefix << " falló: " << strerror(error) << '\n';
+        co_await async_send_error(loop, request, 500);
+    } else {
+        co_await async_send_body(loop, request, body);
+    }
+}
+
+/// @brief Versión asíncrona de handle_connection: una corrutina por conexión
+/// @param loop Bucle del hilo que aceptó la conexión
+/// @param client Socket del cliente (no bloqueante)
+/// @param client_addr Dirección del cliente
+/// @param server Estado compartido del servidor
+/// @param connection_ticket Plaza reservada para esta conexión
+static Task<> async_handle_connection(EventLoop& loop, SafeFD client, sockaddr_storage client_addr, server_context& server,
+                                      [[maybe_unused]] AdmissionTicket connection_ticket) {
+    const program_options& options = server.options;
+    uint64_t arrival = trace_now();
+
+    // La arena vive en el marco de la corrutina: una sola reserva por conexión
+    RequestArena<16384> arena;
+    Deadline deadline{server.watchdog};
+    std::function<void()> abort_io = [fd = client.get()] { shutdown(fd, SHUT_RDWR); };
+    deadline.arm(options.read_timeout_ms, abort_io);
+
+    std::pmr::string request(max_request_head, '\0', arena.resource());
+    auto received = co_await async_recv(loop, client, request.data(), request.size());
+    if (deadline.expired()) {
+        std::cerr << "Error: tiempo de espera agotado al leer la solicitud\n";
+        co_return;
+    }
+    if (!received) {
+        if (received.error() == ECONNRESET) {
+            std::cerr << "Error: la conexión fue restablecida por el cliente\n";
+        } else {
+            std::cerr << "Error fatal al leer la solicitud\n";
+        }
+        co_return;
+    }
+    request.resize(received.value());
+    if (has_headers(parse_request(request).method)) {
+        auto incomplete = [&request] {
+            auto body = parse_request_body(request);
+            return !body && body.error() == EAGAIN;
+        };
+        while (request.size() < max_request_head && incomplete()) {
+            size_t size = request.size();
+            request.resize(max_request_head);
+            received = co_await async_recv(loop, client, request.data() + size, max_request_head - size);
+            request.resize(size + (received ? received.value() : 0));
+            if (!received || received.value() == 0) {
+                break;
+            }
+        }
+        if (!received || deadline.expired()) {
+            std::cerr << "Error al leer las cabeceras de la solicitud\n";
+            co_return;
+        }
+    }
+
+    request_outcome outcome;
+    auto routed = admit_request(client, client_addr, server, deadline, abort_io, request, outcome);
+    if (routed) {
+        const route& matched = *routed->match.matched;
+        request_context context{client, client_addr, server, deadline, abort_io, routed->file_path, matched,
+                                routed->match.remainder, arena.resource(), outcome, routed->method, routed->body,
+                                std::string_view{request}.substr(routed->body.offset), request};
+        ResponseCork cork{client, options.sockets, client_addr.ss_family};
+        if (routed->method == "BUNDLE") {
+            co_await async_serve_bundle(loop, context);
+        } else {
+            switch (matched.kind) {
+                case route_kind::static_files:
+                    co_await async_serve_static(loop, context);
+                    break;
+                case route_kind::cgi:
+                    co_await async_serve_cgi(loop, context);
+                    break;
+                case route_kind::plugin:
+                    co_await async_serve_plugin(loop, context);
+                    break;
+                case route_kind::internal:
+                    co_await async_send_body(loop, context, internal_body(server, matched));
+                    break;
+            }
+        }
+    }
+
+    if (server.capture != nullptr) {
+        server.capture->record(arrival, request, outcome.streamed_body, client_addr, outcome.status, outcome.bytes);
+    }
+    if (outcome.unread_body) {
+        co_await loop.offload(*server.work_pool, WorkPool::work_class::process, [&client, family = client_addr.ss_family] {
+            drain_unread_body(client, family);
+            return 0;
+        });
+    }
+    if (options.verbose) {
+        std::cout << "Conexión cerrada\n";
+    }
+}
+
+/// @brief Acepta conexiones en un bucle de eventos hasta que este se detenga
+static Task<> async_accept_loop(EventLoop& loop, const SafeFD& listener, server_context& server) {
+    admission_control& admission = server.admission;
+    while (true) {
+        if (int error = co_await loop.wait(listener.get(), EPOLLIN); error != 0 || loop.stopping()) {
+            co_return;
+        }
+        sockaddr_storage client_addr{};
+        auto new_fd = co_await async_accept(loop, listener, client_addr);
+        if (!new_fd) {
+            std::cerr << "Error al aceptar la conexión\n";
+            continue;
+        }
+        configure_connection(new_fd.value(), server.options.sockets, client_addr.ss_family);
+        AdmissionTicket ticket{admission.connections};
+        if (!ticket.is_valid()) {
+            reject_connection(new_fd.value(), admission.overload_response);
+            if (server.options.verbose) {
+                std::cout << "Conexión rechazada por sobrecarga (" << admission.connections.rejected() << " en total)\n";
+            }
+            continue;
+        }
+        loop.spawn(async_handle_connection(loop, std::move(new_fd.value()), client_addr, server, std::move(ticket)));
+    }
+}
+
+/// @brief Detiene el bucle cuando stop_fd se vuelve legible
+static Task<> async_wait_stop(EventLoop& loop, int stop_fd) {
+    co_await loop.wait(stop_fd, EPOLLIN);
+    loop.stop();
+}
+
+/// @brief Hilo de aceptación en modo --async: un bucle de eventos con todas sus conexiones.
+/// Tras la parada deja de aceptar y vuelve cuando terminan las conexiones que atendía.
+/// @param listener Socket de escucha (no bloqueante)
+/// @param stop_fd eventfd que detiene el bucle al volverse legible
+/// @param server Estado compartido del servidor
+static void event_loop(const SafeFD& listener, int stop_fd, server_context& server) {
+    EventLoop loop;
+    if (!loop.is_valid()) {
+        std::cerr << "Error al crear el bucle de eventos: " << strerror(errno) << '\n';
+        return;
+    }
+    loop.spawn_service(async_accept_loop(loop, listener, server));
+    loop.spawn_service(async_wait_stop(loop, stop_fd));
+    loop.run();
+}
+
+// Conexión admitida a la espera de que se cree el hilo que la atiende
+struct accepted_connection {
+  SafeFD socket;
+  sockaddr_storage address;
+  AdmissionTicket ticket;
+};
+
+/// @brief Bucle de un hilo de aceptación: acepta y lanza un hilo por cada conexión admitida.
+/// Cada conexión se atiende en su propio hilo, de modo que un execute_program lento no deja de
+/// vaciar la cola de listen.
+/// @param listener Socket de escucha (no bloqueante)
+/// @param stop_fd eventfd que detiene el bucle al volverse legible
+/// @param server Estado compartido del servidor
+static void accept_loop(const SafeFD& listener, int stop_fd, server_context& server) {
+    const program_options& options = server.options;
+    admission_control& admission = server.admission;
+    while (true) {
+        pollfd fds[2] = {{listener.get(), POLLIN, 0}, {stop_fd, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            continue; // EINTR
+        }
+        if (fds[1].revents & POLLIN) {
+            return;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        sockaddr_storage client_addr{};
+        auto new_fd = [&] {
+            TraceSpan span{"accept_connection"};
+            return accept_connection(listener, client_addr);
+        }();
+
+        if (!new_fd) {
+            if (new_fd.error() != EAGAIN) { // EAGAIN: otro hilo se llevó la conexión
+                std::cerr << "Error al aceptar la conexión\n";
+            }
+            continue; // Continuar aceptando nuevas conexiones
+        }
+        configure_connection(new_fd.value(), options.sockets, client_addr.ss_family);
+
+        AdmissionTicket ticket{admission.connections};
+        if (!ticket.is_valid()) {
+            // Sobrecarga: respuesta inmediata en vez de dejar al cliente esperando
+            reject_connection(new_fd.value(), admission.overload_response);
+            if (options.verbose) {
+                std::cout << "Conexión rechazada por sobrecarga (" << admission.connections.rejected() << " en total)\n";
+            }
+            continue;
+        }
+
+        // La conexión no pasa al hilo hasta que este existe: si no se puede crear (límite de hilos
+        // o de memoria), el cliente todavía recibe la respuesta de sobrecarga
+        auto connection = std::make_unique<accepted_connection>(std::move(new_fd.value()), client_addr, std::move(ticket));
+        try {
+            std::thread{[&server, pending = connection.get()] {
+                std::unique_ptr<accepted_connection> owned{pending};
+                handle_connection(std::move(owned->socket), owned->address, server, std::move(owned->ticket));
+            }}.detach();
+            connection.release();
+        } catch (const std::system_error&) {
+            reject_connection(connection->socket, admission.overload_response);
+            if (options.verbose) {
+                std::cout << "Conexión rechazada: no se pudo crear su hilo\n";
+            }
+        }
+    }
+}
+
+// Lo más que se lee de antemano al arrancar: el resto del manifiesto se deja para el tráfico
+constexpr uint64_t warm_up_budget = uint64_t{512} << 20;
+
+/// @brief Lee de antemano los documentos de un manifiesto: readahead() los lleva a la caché de
+/// páginas y, con --cache o --shared-cache, load_static() los copia además en la caché (la
+/// compartida, con su cabecera ya formateada)
+/// @param server
+/// @param entries Documentos del manifiesto, de más a menos pedido
+/// @param stop Se detiene si el servidor termina antes
+static void warm_up(const server_context& server, const std::vector<HotSet::entry>& entries, std::stop_token stop) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t budget = warm_up_budget;
+    size_t warmed = 0;
+    for (const HotSet::entry& hot : entries) {
+        if (stop.stop_requested() || budget == 0) {
+            break;
+        }
+        SafeFD file{open(hot.path.c_str(), O_RDONLY | O_CLOEXEC)};
+        struct stat status;
+        if (!file.is_valid() || fstat(file.get(), &status) != 0 || !S_ISREG(status.st_mode)) {
+            continue; // Borrado o cambiado desde que se guardó el manifiesto
+        }
+        uint64_t size = std::min(static_cast<uint64_t>(status.st_size), budget);
+        readahead(file.get(), 0, size);
+        budget -= size;
+        if (server.cache != nullptr || server.shared_cache != nullptr) {
+            [[maybe_unused]] auto cached = load_static(server, std::pmr::string{hot.path});
+        }
+        ++warmed;
+    }
+    if (server.options.verbose) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "Conjunto caliente: " << warmed << " documentos leídos de antemano ("
+                  << ((warm_up_budget - budget) >> 10) << " KiB) en " << elapsed.count() << " ms\n";
+    }
+}
+
+/// @brief Guarda el manifiesto del conjunto caliente
+static void save_hot_set(HotSet& hot_set, const std::string& path, bool verbose) {
+    if (int error = hot_set.save(path); error != 0) {
+        std::cerr << "Error al guardar el conjunto caliente en " << path << ": " << strerror(error) << '\n';
+    } else if (verbose) {
+        std::cout << "Conjunto caliente guardado en " << path << '\n';
+    }
+}
+
+/// @brief Vuelca las trazas apuntadas e informa del resultado
+/// @param path Archivo de salida
+/// @param verbose
+static void dump_trace(const std::string& path, bool verbose) {
+    int error = trace_dump(path);
+    if (error != 0) {
+        std::cerr << "Error al volcar las trazas en " << path << ": " << strerror(error) << '\n';
+    } else if (verbose) {
+        std::cout << "Trazas volcadas en " << path << '\n';
+    }
+}
 
 int main(int argc, char* argv[]) {
     // Procesar los argumentos de la línea de comandos
@@ -39,19 +1883,57 @@ int main(int argc, char* argv[]) {
             std::cerr << "Error: opción desconocida\n";
         } else if (options.error() == parse_args_errors::invalid_route) {
             std::cerr << "Error: la ruta base no existe\n";
+        } else if (options.error() == parse_args_errors::invalid_value) {
+            std::cerr << "Error: los límites deben ser números positivos\n";
         }
         return EXIT_FAILURE;
     }
 
     // Mostrar ayuda si es necesario
     if (options->show_help) {
-        std::cout << "Uso: docserver [-v | --verbose] [-h | --help] [-p | --port] [-b | --base]\n";
+        std::cout << "Uso: docserver [-v | --verbose] [-h | --help] [-p | --port] [-b | --base]\n"
+                  << "       [--backlog N] [--max-conn N] [--max-cgi N] [--max-static N] [--retry-after S]\n"
+                  << "       [--read-timeout MS] [--send-timeout MS] [--cgi-timeout MS]\n"
+                  << "       [--upgrade-socket RUTA] [--inherit RUTA] [--drain-timeout MS] [--archive ARCHIVO]\n"
+                  << "       [--routes ARCHIVO] [--trace ARCHIVO] [--capture ARCHIVO]\n"
+                  << "       [--workers N] [--cpus LISTA] [--incoming-cpu] [--cache MB] [--cache-max-file KB] [--async]\n"
+                  << "       [--processes N] [--shared-cache MB] [--rate-static N] [--rate-cgi N] [--rate-burst S]\n"
+                  << "       [--max-body KB] [--listings] [--hot-set ARCHIVO] [--hot-set-interval S]\n"
+                  << "       [--file-threads N] [--process-threads N] [--unix RUTA]\n"
+                  << "       [--defer-accept S] [--fastopen N] [--nodelay] [--cork] [--sndbuf KB] [--rcvbuf KB]\n";
         return EXIT_SUCCESS;
     }
 
-    // Crear un socket y asignarle el puerto indicado
+    // Un cliente que cierra a mitad de envío no debe terminar el servidor
+    signal(SIGPIPE, SIG_IGN);
+
+    // Crear un socket y asignarle el puerto indicado, o heredarlo del servidor anterior
     uint16_t port = options->port ? options->port_value : 8080; // Puerto por defecto: 8080
-    auto sock_fd = make_socket(port);
+    if (options->incoming_cpu && (options->cpus.empty() || !options->inherit_socket.empty() || !options->upgrade_socket.empty())) {
+        // El relevo entrega un único socket: los de cada CPU se perderían con sus colas
+        std::cerr << "Error: --incoming-cpu necesita --cpus y no admite --inherit ni --upgrade-socket\n";
+        return EXIT_FAILURE;
+    }
+    if (options->processes > 1 && (!options->inherit_socket.empty() || !options->upgrade_socket.empty() ||
+                                   !options->capture_path.empty() || options->incoming_cpu)) {
+        // El relevo y la captura son de un único proceso
+        std::cerr << "Error: --processes no admite --inherit, --upgrade-socket, --capture ni --incoming-cpu\n";
+        return EXIT_FAILURE;
+    }
+    if (options->cache_mb != 0 && options->shared_cache_mb != 0) {
+        std::cerr << "Error: --cache y --shared-cache no se pueden usar a la vez\n";
+        return EXIT_FAILURE;
+    }
+    if (!options->unix_path.empty() && (options->port || options->incoming_cpu)) {
+        // SO_INCOMING_CPU reparte por la cola de la tarjeta de red: un socket Unix no tiene
+        std::cerr << "Error: --unix sustituye a -p y no admite --incoming-cpu\n";
+        return EXIT_FAILURE;
+    }
+    SafeFD hand_off_channel;           // Con --inherit, abierta hasta confirmar el arranque
+    auto sock_fd = !options->inherit_socket.empty() ? inherit_listener(options->inherit_socket, hand_off_channel)
+                   : !options->unix_path.empty()    ? make_unix_socket(options->unix_path, options->backlog)
+                   : options->incoming_cpu          ? make_socket(port, options->backlog, options->cpus.front())
+                                                    : make_socket(port, options->backlog);
 
     if (!sock_fd) {
         std::cerr << "Error al crear el socket\n";
@@ -59,180 +1941,361 @@ int main(int argc, char* argv[]) {
     }
 
     if (options->verbose) {
-        std::cout << "Socket creado en el puerto " << port << '\n';
+        if (!options->inherit_socket.empty()) {
+            std::cout << "Socket de escucha heredado a través de " << options->inherit_socket << '\n';
+        } else if (!options->unix_path.empty()) {
+            std::cout << "Socket Unix creado en " << options->unix_path << '\n';
+        } else {
+            std::cout << "Socket creado en el puerto " << port << '\n';
+        }
     }
 
-    // Poner el socket a la escucha
-    int result = listen_connection(sock_fd.value());
-    if (result < 0) {
+    // make_socket y make_unix_socket ya lo dejan a la escucha; uno heredado ya escucha con el
+    // backlog del proceso anterior y listen() de nuevo solo le aplica el de este
+    if (!options->inherit_socket.empty() && listen_connection(sock_fd.value(), options->backlog) < 0) {
         std::cerr << "Error al poner el socket a la escucha\n";
         return EXIT_FAILURE;
     }
 
     if (options->verbose) {
-        std::cout << "Escuchando en el puerto " << port << '\n';
+        std::cout << "Escuchando en "
+                  << (options->unix_path.empty() ? "el puerto " + std::to_string(port) : options->unix_path) << " (backlog " << options->backlog << ", máximo "
+                  << options->max_connections << " conexiones, " << options->max_cgi << " CGI, "
+                  << options->max_static << " estáticas)\n";
     }
 
-    // Bucle principal para manejar conexiones
-    while (true) {
-        sockaddr_in client_addr{};
-        auto new_fd = accept_connection(sock_fd.value(), client_addr);
-
-        if (!new_fd) {
-            std::cerr << "Error al aceptar la conexión\n";
-            continue; // Continuar aceptando nuevas conexiones
+    // Caché compartida: se crea antes que los procesos de trabajo para que todos mapeen la misma
+    std::optional<SharedCache> shared_cache;
+    if (options->shared_cache_mb != 0) {
+        shared_cache.emplace(options->shared_cache_mb << 20, options->cache_max_file_kb << 10);
+        if (!shared_cache->is_valid()) {
+            std::cerr << "Error al crear la caché compartida: " << strerror(errno) << '\n';
+            return EXIT_FAILURE;
+        }
+        if (options->verbose) {
+            static constexpr std::string_view pages[] = {"páginas normales", "MFD_HUGETLB", "páginas enormes transparentes"};
+            std::cout << "Caché compartida de " << options->shared_cache_mb << " MiB con "
+                      << pages[static_cast<size_t>(shared_cache->pages())] << '\n';
         }
+    }
 
-        // Leer la solicitud del cliente
-        auto request = receive_request(new_fd.value(), 4096);
-        if (!request) {
-            if (request.error() == ECONNRESET) {
-                std::cerr << "Error: la conexión fue restablecida por el cliente\n";
-            } else {
-                std::cerr << "Error fatal al leer la solicitud\n";
+    // Procesos de trabajo (--processes): se crean antes que cualquier hilo, porque fork() solo
+    // copia el hilo que lo llama. Todos aceptan en el mismo socket de escucha y comparten la caché
+    // compartida; cada uno tiene sus propios hilos, plazos y límites de admisión
+    size_t process_index = 0;
+    pid_t main_process = getpid();
+    std::cout << std::flush; // Lo pendiente no debe salir una vez por proceso
+    for (size_t i = 1; i < options->processes; ++i) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "Error al crear el proceso de trabajo " << i << ": " << strerror(errno) << '\n';
+            return EXIT_FAILURE;
+        }
+        if (pid == 0) {
+            // Si el proceso principal termina, sus trabajadores también
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            if (getppid() != main_process) {
+                _exit(EXIT_FAILURE);
             }
-            close(new_fd.value().get());
-            continue;
+            process_index = i;
+            break;
         }
+    }
+    if (options->verbose && options->processes > 1) {
+        std::cout << "Proceso de trabajo " << process_index << " (PID " << getpid() << ")\n";
+    }
 
-        // Procesar la solicitud para extraer la ruta del archivo
-        std::istringstream iss(request.value());
-        std::string get, file_path;
-        iss >> get >> file_path;
+    // Bucle de plazos compartido por todas las conexiones
+    Watchdog watchdog;
+    if (!watchdog.is_valid()) {
+        std::cerr << "Error al crear el temporizador de plazos\n";
+        return EXIT_FAILURE;
+    }
 
-        // Comprobar que la solicitud es válida
-        if (get != "GET" || file_path.empty() || file_path[0] != '/') {
-            std::string error_response = "400 Bad Request\n";
-            send_response(new_fd.value(), "Error ", error_response);
-            close(new_fd.value().get());
-            continue;
+    // Archivo empaquetado: se mapea una sola vez al arrancar
+    std::optional<ContentArchive> archive;
+    if (!options->archive_path.empty()) {
+        auto opened = ContentArchive::open(options->archive_path);
+        if (!opened) {
+            std::cerr << "Error al abrir el archivo " << options->archive_path << ": " << strerror(opened.error()) << '\n';
+            return EXIT_FAILURE;
         }
+        archive.emplace(std::move(opened.value()));
+        if (options->verbose) {
+            std::cout << "Sirviendo " << archive->size() << " documentos desde " << options->archive_path << '\n';
+        }
+    }
 
-        // Ajustar la ruta del archivo como relativa al directorio base
-        std::string path_option;
-        if (!options->base) {
-            path_option = getcwd(nullptr, 0); // En caso de no haber ruta especificada se toma la del directorio actual del archivo
-        } else {
-            path_option = options->ruta_base; // En caso de haber ruta especificada se toma la ruta base
+    // Límites de concurrencia y respuesta de sobrecarga precalculada
+    admission_control admission{
+        AdmissionLimiter{options->max_connections},
+        AdmissionLimiter{options->max_cgi},
+        AdmissionLimiter{options->max_static},
+        "Error 503 Service Unavailable\nRetry-After: " + std::to_string(options->retry_after) + "\n\n",
+        "Error 429 Too Many Requests\nRetry-After: " + std::to_string(options->rate_burst) + "\n\n"
+    };
+    // Límite de peticiones por cliente (por proceso con --processes)
+    std::optional<RateLimiter> rate_limiter;
+    if (options->rate_static != 0 || options->rate_cgi != 0) {
+        rate_limiter.emplace(options->rate_static, options->rate_cgi, options->rate_burst);
+    }
+    // Directorio base: se resuelve una sola vez en lugar de en cada petición
+    std::string base_dir;
+    if (!options->base) {
+        char* cwd = getcwd(nullptr, 0); // En caso de no haber ruta especificada se toma la del directorio actual del archivo
+        base_dir = cwd;
+        free(cwd);
+    } else {
+        base_dir = options->ruta_base; // En caso de haber ruta especificada se toma la ruta base
+    }
+
+    // Tabla de rutas compilada al arrancar
+    auto router = options->routes_path.empty() ? Router::defaults(base_dir) : Router::load(options->routes_path);
+    if (!router) {
+        std::cerr << "Error en " << options->routes_path << ", línea " << router.error().line << ": "
+                  << router.error().message << '\n';
+        return EXIT_FAILURE;
+    }
+    if (options->verbose) {
+        std::cout << router->routes().size() << " rutas cargadas\n";
+    }
+
+    // Captura de tráfico: un hilo propio la escribe en segundo plano
+    std::optional<CaptureWriter> capture;
+    if (!options->capture_path.empty()) {
+        capture.emplace(options->capture_path);
+        if (!capture->is_valid()) {
+            std::cerr << "Error al crear la captura " << options->capture_path << ": " << strerror(errno) << '\n';
+            return EXIT_FAILURE;
         }
-        // Comprobar que la ruta base exista mediante access()
-        if (access(path_option.c_str(), F_OK) == -1) {
-            std::cerr << "Error: la ruta base no existe\n";
-            send_response(new_fd.value(), "Error", "404 Not Found\n");
-            close(new_fd.value().get());
-            continue;
+        if (options->verbose) {
+            std::cout << "Capturando las peticiones en " << options->capture_path << '\n';
+        }
+    }
+
+    // Caché de contenidos: la región se reserva al arrancar y se llena con lo que se pida
+    std::optional<ContentCache> cache;
+    if (options->cache_mb != 0) {
+        cache.emplace(options->cache_mb << 20, options->cache_max_file_kb << 10);
+        if (!cache->is_valid()) {
+            std::cerr << "Error al reservar la caché de contenidos: " << strerror(errno) << '\n';
+            return EXIT_FAILURE;
         }
-        std::string complete_path = path_option + file_path; // Se concatena la ruta base con la ruta del archivo solicitado
         if (options->verbose) {
-            std::cout << "Solicitud de archivo: " << complete_path << '\n';
-        }
-
-        // -------------------
-        //       PUNTO 4
-        // -------------------
-
-        // Verificar si la ruta empieza con /bin/ para ejecutar un programa
-        if (file_path.rfind("/bin/", 0) == 0) {
-            // Ajustamos las variables de entorno 
-            exec_environment env;
-            env.REQUEST_PATH = complete_path;
-            env.SERVER_BASEDIR = path_option;
-            env.REMOTE_PORT = std::to_string(ntohs(client_addr.sin_port));
-            env.REMOTE_IP = inet_ntoa(client_addr.sin_addr);
-
-            // Ejecutar el programa
-            auto result = execute_program(complete_path, env);
-            // Comprobación de errores
-            if (!result) { 
-                const auto& error = result.error();
-                if (error.error_code == ENOENT) {
-                    std::cerr << "Error: el programa no existe (ENOENT)\n";
-                    send_response(new_fd.value(), "Error", "404 Not Found\n");
-                } else if (error.error_code == EACCES) {
-                    std::cerr << "Error: no se tienen permisos para ejecutar el programa (EACCES)\n";
-                    send_response(new_fd.value(), "Error", "403 Forbidden\n");
-                } else {
-                    std::cerr << "El programa terminó con un código de error: " << error.exit_code << "\n";
-                    std::string response = "500 Internal Server Error\n";
-                    send_response(new_fd.value(), "Content-Length: " + std::to_string(response.size()) + "\n\n", response);
-                }
-                close(new_fd.value().get());
-                continue;
-            }
-            // Responder con el contenido del archivo
-            std::string_view body = result.value();
-            std::ostringstream oss;
-            oss << "Content-Length: " << body.size() << "\n\n";
-            std::string header = oss.str();
-            // Enviar la respuesta al cliente
-            int send_result = send_response(new_fd.value(), header, body);
-            if (send_result < 0 && errno == ECONNRESET) {
-                std::cerr << "Error: la conexión fue restablecida por el cliente\n";
-            } else if (send_result < 0) {
-                std::cerr << "Error fatal al enviar la respuesta\n";
-                close(new_fd.value().get());
-                return EXIT_FAILURE;
-            }
+            static constexpr std::string_view pages[] = {"páginas normales", "MAP_HUGETLB", "páginas enormes transparentes"};
+            std::cout << "Caché de contenidos de " << options->cache_mb << " MiB con "
+                      << pages[static_cast<size_t>(cache->pages())] << '\n';
+        }
+    }
 
-            if (options->verbose) {
-                std::cout << "Respuesta enviada con " << body.size() << " bytes\n";
+    // Índices de directorio: se construyen al pedirlos y los descarta inotify
+    std::optional<ListingCache> listings;
+    if (options->listings) {
+        listings.emplace();
+        if (!listings->is_valid()) {
+            std::cerr << "Error al crear el vigilante de directorios: " << strerror(errno) << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Conjunto caliente: lo lleva solo el primer proceso (la caché de páginas y la compartida son
+    // de todos). Se parte de los contadores del manifiesto anterior
+    std::optional<HotSet> hot_set;
+    std::vector<HotSet::entry> manifest;
+    if (!options->hot_set_path.empty() && process_index == 0) {
+        hot_set.emplace();
+        auto loaded = HotSet::load(options->hot_set_path);
+        if (loaded) {
+            manifest = std::move(loaded.value());
+            hot_set->seed(manifest);
+        } else if (loaded.error() != ENOENT) {
+            std::cerr << "Error al leer el conjunto caliente " << options->hot_set_path << ": "
+                      << strerror(loaded.error()) << '\n';
+        }
+    }
+
+    // Hilos de trabajo del modo asíncrono (por proceso: se crean después del fork())
+    std::optional<WorkPool> work_pool;
+    if (options->async) {
+        work_pool.emplace(options->file_threads, options->process_threads);
+    }
+
+    server_context server{options.value(), admission, watchdog, archive ? &archive.value() : nullptr,
+                          router.value(), base_dir, capture ? &capture.value() : nullptr,
+                          cache ? &cache.value() : nullptr, shared_cache ? &shared_cache.value() : nullptr,
+                          rate_limiter ? &rate_limiter.value() : nullptr, listings ? &listings.value() : nullptr,
+                          hot_set ? &hot_set.value() : nullptr, work_pool ? &work_pool.value() : nullptr};
+
+    // El manifiesto se lee de antemano en un hilo aparte, que empieza antes que los hilos de
+    // aceptación: los primeros documentos ya están en memoria cuando llegan las peticiones. El
+    // manifiesto se vuelve a guardar cada --hot-set-interval segundos y al terminar
+    std::jthread warm_up_thread;
+    SafeFD hot_set_timer;
+    if (hot_set) {
+        if (!manifest.empty() && archive == std::nullopt) {
+            warm_up_thread = std::jthread{[&server, manifest = std::move(manifest)](std::stop_token stop) {
+                warm_up(server, manifest, stop);
+            }};
+        }
+        hot_set_timer = SafeFD{timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)};
+        itimerspec period{};
+        period.it_interval.tv_sec = static_cast<time_t>(options->hot_set_interval_s);
+        period.it_value = period.it_interval;
+        timerfd_settime(hot_set_timer.get(), 0, &period, nullptr);
+    }
+
+    // Trazas por fase: --trace las activa desde el arranque y SIGUSR2 las alterna; al
+    // desactivarlas se vuelcan en formato de Chrome
+    std::string trace_path = options->trace_path.empty() ? "docserver-trace.json" : options->trace_path;
+    if (process_index != 0) {
+        trace_path += '.' + std::to_string(process_index);
+    }
+    int trace_fd = trace_install_signal();
+    if (!options->trace_path.empty()) {
+        trace_set_enabled(true);
+    }
+
+    // Hilos de aceptación: cada uno espera en su socket de escucha (el común o, con
+    // --incoming-cpu, uno propio en el mismo puerto) y lanza un hilo por conexión admitida, que
+    // hereda su CPU y su política de memoria: la pila de la conexión, con su arena, y todo lo
+    // que toque la petición salen del nodo NUMA de esa CPU
+    size_t worker_count = options->workers != 0 ? options->workers : std::max<size_t>(1, options->cpus.size());
+    std::vector<SafeFD> own_listeners;
+    own_listeners.reserve(worker_count);
+    for (size_t i = 1; options->incoming_cpu && i < worker_count; ++i) {
+        auto own = make_socket(port, options->backlog, options->cpus[i % options->cpus.size()]);
+        if (!own) {
+            std::cerr << "Error al crear el socket de escucha del hilo " << i << ": " << strerror(own.error()) << '\n';
+            return EXIT_FAILURE;
+        }
+        own_listeners.push_back(std::move(own.value()));
+    }
+    // Socket de relevo para un futuro reinicio sin cortes. Se crea lo más tarde posible: con la
+    // misma ruta sustituye al del servidor anterior, que ya no podría recibir otro relevo
+    SafeFD control;
+    if (!options->upgrade_socket.empty()) {
+        auto control_fd = make_unix_socket(options->upgrade_socket);
+        if (!control_fd) {
+            std::cerr << "Error al crear el socket de relevo " << options->upgrade_socket << '\n';
+            return EXIT_FAILURE;
+        }
+        control = std::move(control_fd.value());
+    }
+
+    // Arranque terminado: el servidor anterior ya puede dejar de aceptar. Hasta aquí, cualquier
+    // error deja la escucha en sus manos
+    if (hand_off_channel.is_valid()) {
+        if (int error = confirm_hand_off(hand_off_channel); error != 0) {
+            std::cerr << "Error al confirmar el relevo (el servidor anterior sigue atendiendo): " << strerror(error) << '\n';
+            return EXIT_FAILURE;
+        }
+        hand_off_channel = SafeFD{};
+    }
+
+    SafeFD stop_accepting{eventfd(0, EFD_CLOEXEC)};
+    std::vector<std::thread> acceptors;
+    for (size_t i = 0; i < worker_count; ++i) {
+        const SafeFD& listener = i > 0 && options->incoming_cpu ? own_listeners[i - 1] : sock_fd.value();
+        // No bloqueante: varios hilos pueden despertar por la misma conexión
+        fcntl(listener.get(), F_SETFL, fcntl(listener.get(), F_GETFL) | O_NONBLOCK);
+        if (i == 0 || options->incoming_cpu) {
+            if (int error = configure_listener(listener, options->sockets); error != 0) {
+                std::cerr << "Aviso: no se pudieron aplicar los ajustes TCP al socket de escucha: " << strerror(error)
+                          << '\n';
             }
         }
-        else {
-            // Ruta no comienza con /bin/, leer archivo
-            auto file = read_all(complete_path);
-            if (!file) {
-                if (file.error() == ENOENT) {
-                    send_response(new_fd.value(), "Error", "404 Not Found\n");
-                } else if (file.error() == EACCES) {
-                    send_response(new_fd.value(), "Error", "403 Forbidden\n");
-                } else {
-                    std::cerr << "Error fatal al leer el archivo\n";
+        // Con --processes cada proceso sigue repartiendo las CPU donde lo dejó el anterior
+        int cpu = options->cpus.empty() ? -1 : options->cpus[(process_index * worker_count + i) % options->cpus.size()];
+        acceptors.emplace_back([&listener, &server, &stop_accepting, cpu, i] {
+            if (cpu >= 0) {
+                int error = pin_thread(cpu);
+                auto node = prefer_local_node();
+                if (error != 0) {
+                    std::cerr << "Error al fijar el hilo de aceptación " << i << " a la CPU " << cpu << ": " << strerror(error) << '\n';
+                } else if (server.options.verbose) {
+                    std::cout << "Hilo de aceptación " << i << " en la CPU " << cpu << " (nodo "
+                              << (node ? std::to_string(node.value()) : "desconocido") << ")\n";
                 }
-                close(new_fd.value().get());
-                continue;
-            }
-
-            // ------------------------------------------------------------------------------------------------------------------------------------------------------
-            // MODIFICACIÓN, cabe añadir que esto ya lo habia hecho para que saliese con la opción -v | --verbose, simplemente lo he adaptado para que
-            // salga por el socat (cliente) en lugar de la terminal donde se ejecuta (servidor).
-            // std::ostringstream response_stream;
-            // response_stream << "IP: " << inet_ntoa(client_addr.sin_addr) << "\nPUERTO " << ntohs(client_addr.sin_port) << "\n";
-            // std::string body_mod = response_stream.str();
-            // std::ostringstream header_stream;
-            // header_stream << "\n" << "Content-Length: " << body_mod.size() << "\n\n";
-            // std::string header_mod = header_stream.str();
-            // send_response(new_fd.value(), header_mod, body_mod);
-            // ------------------------------------------------------------------------------------------------------------------------------------------------------
-
-            // Responder con el contenido del archivo
-            std::string_view body = file->get();
-            std::ostringstream oss;
-            oss << "Content-Length: " << body.size() << "\n\n";
-            std::string header = oss.str();
-            // Enviar la respuesta al cliente
-            int send_result = send_response(new_fd.value(), header, body);
-            if (send_result < 0 && errno == ECONNRESET) {
-                std::cerr << "Error: la conexión fue restablecida por el cliente\n";
-            } else if (send_result < 0) {
-                std::cerr << "Error fatal al enviar la respuesta\n";
-                close(new_fd.value().get());
-                return EXIT_FAILURE;
             }
+            if (server.options.async) {
+                event_loop(listener, stop_accepting.get(), server);
+            } else {
+                accept_loop(listener, stop_accepting.get(), server);
+            }
+        });
+    }
+
+    // Bucle principal: el hilo principal solo atiende el relevo y los volcados de trazas
+    while (true) {
+        // Esperar a una petición de relevo, a un volcado de trazas o a guardar el conjunto
+        // caliente (poll ignora los fd -1)
+        pollfd fds[3] = {{control.get(), POLLIN, 0}, {trace_fd, POLLIN, 0}, {hot_set_timer.get(), POLLIN, 0}};
+        if (poll(fds, 3, -1) < 0) {
+            continue; // EINTR
+        }
+        if ((fds[1].revents & POLLIN) && trace_take_dump_request()) {
+            dump_trace(trace_path, options->verbose);
+        }
+        if (fds[2].revents & POLLIN) {
+            uint64_t expirations;
+            [[maybe_unused]] ssize_t bytes = read(hot_set_timer.get(), &expirations, sizeof(expirations));
+            save_hot_set(hot_set.value(), options->hot_set_path, options->verbose);
+        }
+        if ((fds[0].revents & POLLIN) && hand_off_listener(control, sock_fd.value())) {
             if (options->verbose) {
-                std::cout << "Respuesta enviada con " << body.size() << " bytes\n";
+                std::cout << "Socket de escucha entregado al nuevo servidor; dejando de aceptar\n";
             }
+            break;
         }
-        // Cerrar la conexión con el cliente
-        close(new_fd.value().get());
-        if (options->verbose) {
-            std::cout << "Conexión cerrada\n";
+    }
+
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = write(stop_accepting.get(), &one, sizeof(one));
+    if (options->async) {
+        // Los bucles de eventos vuelven cuando acaban sus conexiones: se esperan abajo, con el
+        // resto del drenaje, sin soltar los sockets que sus corrutinas aún referencian
+        for (std::thread& acceptor : acceptors) {
+            acceptor.detach();
+        }
+    } else {
+        for (std::thread& acceptor : acceptors) {
+            acceptor.join();
         }
     }
-    // Cerrar el socket del servidor
-    close(sock_fd.value().get());
+    // Relevo completado: el nuevo proceso ya acepta en el mismo socket. Se suelta la copia local
+    // y se espera a que terminen las conexiones en curso antes de salir.
+    if (!options->async) {
+        sock_fd.value() = SafeFD{};
+        own_listeners.clear();
+    }
+    control = SafeFD{};
+    auto drain_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options->drain_timeout_ms);
+    while (admission.connections.active() > 0 && std::chrono::steady_clock::now() < drain_deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
     if (options->verbose) {
-        std::cout << "Socket cerrado\n";
+        std::cout << "Drenaje terminado con " << admission.connections.active() << " conexiones pendientes\n";
+    }
+    if (trace_enabled.load()) {
+        trace_set_enabled(false);
+        dump_trace(trace_path, options->verbose);
+    }
+    if (hot_set) {
+        warm_up_thread.request_stop();
+        if (warm_up_thread.joinable()) {
+            warm_up_thread.join();
+        }
+        save_hot_set(hot_set.value(), options->hot_set_path, options->verbose);
+    }
+    if (capture) {
+        int error = capture->close();
+        if (error != 0) {
+            std::cerr << "Error al escribir la captura: " << strerror(error) << '\n';
+        } else if (options->verbose) {
+            std::cout << capture->recorded() << " peticiones capturadas (" << capture->dropped() << " descartadas)\n";
+        }
     }
-    return EXIT_SUCCESS;
+    // Salir sin destruir el watchdog ni la admisión: algún hilo podría seguir usándolos
+    std::cout << std::flush;
+    _exit(EXIT_SUCCESS);
 }